@@ -1,5 +1,6 @@
 #include "Acceptor.h"
 #include "InetAddress.h"
+#include "UnixAddress.h"
 #include "Logger.h"
 
 #include <unistd.h>
@@ -14,12 +15,24 @@ static int createNonblocking()
     return sockfd;
 }
 
+static int createUnixNonblocking()
+{
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd < 0)
+    {
+            LOG_FATAL("%s:%s:%d unix listen sockfd create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
 // socket.bind()，并绑定对应channel的ReadCallback，在accept时回调
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop)
     , acceptSocket_(createNonblocking()) // socket
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
+    , unixDomain_(false)
+    , acceptErrors_(0)
 {
     acceptSocket_.setReuseAddr(true);
     acceptSocket_.setReusePort(true);
@@ -28,10 +41,37 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     // baseLoop => acceptChannel_(listenfd) =>
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
+
+Acceptor::Acceptor(EventLoop *loop, const UnixAddress &listenAddr)
+    : loop_(loop)
+    , acceptSocket_(createUnixNonblocking())
+    , acceptChannel_(loop, acceptSocket_.fd())
+    , listenning_(false)
+    , unixDomain_(true)
+    , acceptErrors_(0)
+{
+    if (!listenAddr.valid())
+    {
+        LOG_FATAL("%s:%s:%d empty unix socket path \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    if (!listenAddr.isAbstract())
+    {
+        // 上次进程退出时留下的socket文件会导致bind失败(EADDRINUSE)
+        unixPath_ = listenAddr.toPath();
+        ::unlink(unixPath_.c_str());
+    }
+    acceptSocket_.bindAddress(listenAddr);
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if (!unixPath_.empty())
+    {
+        ::unlink(unixPath_.c_str());
+    }
 }
 
 // 开启socket.listen，并开启对应channel的read状态
@@ -46,7 +86,8 @@ void Acceptor::listen()
 void Acceptor::handleRead()
 {
     InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);   // accept
+    // Unix域socket的对端通常没有绑定地址，peerAddr保持默认值
+    int connfd = acceptSocket_.accept(unixDomain_ ? nullptr : &peerAddr);   // accept
     if (connfd >= 0)
     {
         if (newConnectionCallback_)
@@ -61,11 +102,12 @@ void Acceptor::handleRead()
     }
     else
     {
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+        ++acceptErrors_;
+        LOG_ERROR_RATELIMIT(1, "%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
         // fd reached max，can't open new fd
         if (errno == EMFILE)
         {
-            LOG_ERROR("%s:%s:%d sockfd readched limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            LOG_ERROR_RATELIMIT(1, "%s:%s:%d sockfd readched limit! \n", __FILE__, __FUNCTION__, __LINE__);
         }
     }
 }
\ No newline at end of file
@@ -5,15 +5,19 @@
 #include "Socket.h"
 
 #include <functional>
+#include <string>
 
 class EventLoop;
 class InetAddress;
+class UnixAddress;
 
 class Acceptor : noncopyable
 {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &)>;
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    // 监听Unix域socket，文件系统路径上残留的旧socket文件会先被删除，析构时再删除
+    Acceptor(EventLoop *loop, const UnixAddress &listenAddr);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback &cb)
@@ -23,6 +27,8 @@ public:
 
     bool listenning() const { return listenning_; }
     void listen();
+    // accept失败的次数(例如fd耗尽)，只在loop线程中读取
+    uint64_t acceptErrors() const { return acceptErrors_; }
 
 private:
     void handleRead();
@@ -32,4 +38,7 @@ private:
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
+    bool unixDomain_;
+    uint64_t acceptErrors_;
+    std::string unixPath_; // 需要在析构时删除的socket文件
 };
\ No newline at end of file
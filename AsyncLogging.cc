@@ -0,0 +1,181 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <chrono>
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                           off_t rollSize,
+                           int flushInterval,
+                           int rollInterval)
+    : flushInterval_(flushInterval)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , rollInterval_(rollInterval)
+    , running_(false)
+    , droppedBytes_(0)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , flushRequested_(0)
+    , flushCompleted_(0)
+{
+    buffers_.reserve(16);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+// 前端写日志，只在拷贝到前台缓冲区时持有锁
+void AsyncLogging::append(const char *logline, int len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(logline, len);
+    }
+    else
+    {
+        // 前台缓冲区写满，交给后台线程，换上预备缓冲区
+        buffers_.push_back(std::move(currentBuffer_));
+        if (nextBuffer_)
+        {
+            currentBuffer_ = std::move(nextBuffer_);
+        }
+        else
+        {
+            currentBuffer_.reset(new LogBuffer); // 写得太快，两块缓冲区都用完了，很少发生
+        }
+        currentBuffer_->append(logline, len);
+        cond_.notify_one();
+    }
+}
+
+// 等待后台线程把已经写入的日志全部落盘
+void AsyncLogging::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    uint64_t target = ++flushRequested_;
+    cond_.notify_one();
+    flushCond_.wait(lock, [this, target]() { return flushCompleted_ >= target || !running_; });
+}
+
+/*
+ * 后台线程，预先准备两块空闲缓冲区用来和前台交换
+ * 每轮在锁内把前台缓冲区和已写满的缓冲区一起换出来，在锁外写文件，
+ * 写完之后留下两块缓冲区重置后复用，其余的释放
+ */
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, flushInterval_, rollInterval_);
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(16);
+
+    bool exiting = false;
+    while (!exiting)
+    {
+        uint64_t flushTarget = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && flushRequested_ == flushCompleted_ && running_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_)
+            {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+            flushTarget = flushRequested_;
+            exiting = !running_;
+        }
+
+        // 后台写盘跟不上，丢掉多余的日志，只保留最早的两块
+        if (buffersToWrite.size() > kMaxPendingBuffers)
+        {
+            uint64_t dropped = 0;
+            for (size_t i = 2; i < buffersToWrite.size(); ++i)
+            {
+                dropped += buffersToWrite[i]->length();
+            }
+            droppedBytes_ += dropped;
+
+            char buf[256];
+            snprintf(buf, sizeof buf, "Dropped log messages at %s, %zd larger buffers, %lu bytes\n",
+                     Timestamp::now().toString().c_str(), buffersToWrite.size() - 2,
+                     static_cast<unsigned long>(dropped));
+            fputs(buf, stderr);
+            output.append(buf, static_cast<int>(strlen(buf)));
+            buffersToWrite.resize(2);
+        }
+
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        // 留下两块缓冲区复用
+        if (buffersToWrite.size() > 2)
+        {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1)
+        {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2)
+        {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+        output.flush();
+
+        if (flushTarget > 0)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (flushTarget > flushCompleted_)
+            {
+                flushCompleted_ = flushTarget;
+                flushCond_.notify_all();
+            }
+        }
+    }
+    output.flush();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    flushCond_.notify_all();
+}
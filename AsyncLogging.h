@@ -0,0 +1,103 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <sys/types.h>
+
+// 定长的日志缓冲区，写满之后整块交给后台线程
+template <int SIZE>
+class FixedBuffer : noncopyable
+{
+public:
+    FixedBuffer() : cur_(data_) {}
+
+    void append(const char *buf, size_t len)
+    {
+        if (static_cast<size_t>(avail()) > len)
+        {
+            memcpy(cur_, buf, len);
+            cur_ += len;
+        }
+    }
+
+    const char *data() const { return data_; }
+    int length() const { return static_cast<int>(cur_ - data_); }
+    int avail() const { return static_cast<int>(end() - cur_); }
+    void reset() { cur_ = data_; }
+
+private:
+    const char *end() const { return data_ + sizeof data_; }
+
+    char data_[SIZE];
+    char *cur_;
+};
+
+/*
+ * 异步日志，双缓冲
+ * 各线程把日志追加到前台缓冲区(currentBuffer_)，只在拷贝时持有锁；
+ * 前台缓冲区写满或者每隔flushInterval秒，后台线程把写满的缓冲区整体换出，
+ * 在锁外一次性写入滚动的日志文件，调用日志的线程不会阻塞在磁盘IO上
+ *
+ * AsyncLogging log("server", 500 * 1000 * 1000);
+ * log.start();
+ * Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log, _1, _2));
+ * Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+ */
+class AsyncLogging : noncopyable
+{
+public:
+    AsyncLogging(const std::string &basename,
+                 off_t rollSize,
+                 int flushInterval = 3,
+                 int rollInterval = 60 * 60 * 24);
+    ~AsyncLogging();
+
+    // 前端写日志，可以在任意线程调用
+    void append(const char *logline, int len);
+    // 等待后台线程把已经写入的日志全部落盘，FATAL日志退出进程前调用
+    void flush();
+
+    void start();
+    void stop();
+
+    // 后台线程来不及写盘时被丢弃的日志字节数
+    uint64_t droppedBytes() const { return droppedBytes_; }
+
+private:
+    static const int kLargeBuffer = 4000 * 1000;
+    // 积压的缓冲区超过该数量时丢弃多余的日志，保证内存不会无限增长
+    static const size_t kMaxPendingBuffers = 25;
+
+    using LogBuffer = FixedBuffer<kLargeBuffer>;
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc();
+
+    const int flushInterval_;
+    const std::string basename_;
+    const off_t rollSize_;
+    const int rollInterval_;
+    std::atomic_bool running_;
+    std::atomic<uint64_t> droppedBytes_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferPtr currentBuffer_;   // 前台正在写入的缓冲区
+    BufferPtr nextBuffer_;      // 预备缓冲区，前台缓冲区写满后直接替换，避免在前端分配内存
+    BufferVector buffers_;      // 已写满等待后台线程写盘的缓冲区
+
+    // flush()的同步：前端递增请求号，后台写完后把完成号追上
+    uint64_t flushRequested_;
+    uint64_t flushCompleted_;
+    std::condition_variable flushCond_;
+};
@@ -0,0 +1,597 @@
+#include "BinaryLog.h"
+#include "CurrentThread.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+/*
+ * 文件布局
+ * +-------------+----------------+-----------------+-----------------+-----
+ * | FileHeader  |  格式串表       | RingHeader 0    | ring 0 数据      | ...
+ * | (4KB)       |  (256KB)       | (64B)           | (ringSize)      |
+ * +-------------+----------------+-----------------+-----------------+-----
+ * 格式串表项：uint32 id | uint32 line | uint16 fileLen | uint16 formatLen | file | format
+ * 记录：uint32 size(8字节对齐) | uint32 formatId | int64 纳秒时间戳 | 参数...
+ * 记录不会跨越环形缓冲区的末尾，放不下时在末尾写一条填充记录，从头开始写
+ */
+namespace
+{
+const char kMagic[8] = {'M', 'U', 'B', 'L', 'O', 'G', '0', '1'};
+const uint32_t kVersion = 1;
+const size_t kFileHeaderSize = 4096;
+const size_t kFormatTableSize = 256 * 1024;
+const size_t kRingHeaderSize = 64;
+const size_t kMinRingSize = 64 * 1024;
+const uint32_t kPaddingId = 0xffffffff;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t maxThreads;
+    uint64_t ringSize;
+    uint64_t formatTableOffset;
+    uint64_t formatTableSize;
+    uint64_t ringsOffset;
+    std::atomic<uint64_t> formatTableUsed;
+    std::atomic<uint32_t> threadsUsed;
+};
+
+// head和tail都是单调递增的字节偏移，[tail, head)之间是有效的记录
+struct RingHeader
+{
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    int32_t tid;
+};
+
+struct FormatEntry
+{
+    const char *format;
+    const char *file;
+    int line;
+};
+
+std::mutex g_mutex;                   // 保护格式串的注册以及open/close
+std::vector<FormatEntry> g_formats;   // 已注册的格式串，编号从1开始
+size_t g_mapSize = 0;
+std::atomic<uint64_t> g_generation(0); // 每次open递增，线程据此判断自己的环形缓冲区是否失效
+
+// 线程独占的环形缓冲区，放在一个结构体里，每次写日志只需取一次线程局部变量的地址
+struct ThreadRing
+{
+    uint64_t generation;
+    RingHeader *ring;
+    char *data;
+    uint64_t size;
+    uint64_t reservedHead; // reserve和commit之间记录的起始位置
+};
+__thread ThreadRing t_ring = {0, nullptr, nullptr, 0, 0};
+
+FileHeader *fileHeader(char *base) { return reinterpret_cast<FileHeader *>(base); }
+
+// 把格式串写入文件中的格式串表，调用时持有g_mutex
+void writeFormat(char *base, uint32_t id, const FormatEntry &entry)
+{
+    FileHeader *header = fileHeader(base);
+    uint16_t fileLen = static_cast<uint16_t>(strnlen(entry.file, 1024));
+    uint16_t formatLen = static_cast<uint16_t>(strnlen(entry.format, 16384));
+    uint32_t line = static_cast<uint32_t>(entry.line);
+    uint64_t used = header->formatTableUsed.load(std::memory_order_relaxed);
+    size_t need = 12 + fileLen + formatLen;
+    if (used + need > header->formatTableSize)
+    {
+        return;
+    }
+
+    char *p = base + header->formatTableOffset + used;
+    memcpy(p, &id, 4);
+    memcpy(p + 4, &line, 4);
+    memcpy(p + 8, &fileLen, 2);
+    memcpy(p + 10, &formatLen, 2);
+    memcpy(p + 12, entry.file, fileLen);
+    memcpy(p + 12 + fileLen, entry.format, formatLen);
+    header->formatTableUsed.store(used + need, std::memory_order_release);
+}
+
+// 当前线程第一次写日志时，在文件中领取一段环形缓冲区
+void acquireRing(ThreadRing &tr, char *base)
+{
+    FileHeader *header = fileHeader(base);
+    tr.generation = g_generation.load(std::memory_order_acquire);
+    tr.ring = nullptr;
+
+    uint32_t index = header->threadsUsed.fetch_add(1);
+    if (index >= header->maxThreads)
+    {
+        return; // 线程数超过上限，该线程的记录被丢弃
+    }
+    char *p = base + header->ringsOffset + index * (kRingHeaderSize + header->ringSize);
+    tr.ring = reinterpret_cast<RingHeader *>(p);
+    tr.data = p + kRingHeaderSize;
+    tr.size = header->ringSize;
+    tr.ring->tid = CurrentThread::tid();
+    tr.ring->tail.store(0, std::memory_order_relaxed);
+    tr.ring->head.store(0, std::memory_order_release);
+}
+
+// 腾出空间，使写入位置end之前的数据不超过一个环形缓冲区，被覆盖的旧记录从tail处丢弃
+void makeRoom(ThreadRing &tr, uint64_t end)
+{
+    uint64_t tail = tr.ring->tail.load(std::memory_order_relaxed);
+    if (end - tail <= tr.size)
+    {
+        return;
+    }
+    while (end - tail > tr.size)
+    {
+        uint32_t size;
+        memcpy(&size, tr.data + tail % tr.size, sizeof size);
+        tail += size;
+    }
+    tr.ring->tail.store(tail, std::memory_order_release);
+}
+} // namespace
+
+std::atomic<char *> BinaryLog::base_(nullptr);
+
+// 创建(覆盖)日志文件
+bool BinaryLog::open(const std::string &path, size_t ringSize, int maxThreads)
+{
+    close();
+
+    std::unique_lock<std::mutex> lock(g_mutex);
+    ringSize = std::max(kMinRingSize, (ringSize + 7) & ~static_cast<size_t>(7));
+    size_t ringsOffset = kFileHeaderSize + kFormatTableSize;
+    size_t mapSize = ringsOffset + maxThreads * (kRingHeaderSize + ringSize);
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "BinaryLog::open %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    if (::ftruncate(fd, mapSize) < 0)
+    {
+        fprintf(stderr, "BinaryLog::open ftruncate %s failed: %s\n", path.c_str(), strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    void *addr = ::mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        fprintf(stderr, "BinaryLog::open mmap %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    char *base = static_cast<char *>(addr);
+    FileHeader *header = fileHeader(base);
+    memcpy(header->magic, kMagic, sizeof kMagic);
+    header->version = kVersion;
+    header->maxThreads = static_cast<uint32_t>(maxThreads);
+    header->ringSize = ringSize;
+    header->formatTableOffset = kFileHeaderSize;
+    header->formatTableSize = kFormatTableSize;
+    header->ringsOffset = ringsOffset;
+    header->formatTableUsed.store(0);
+    header->threadsUsed.store(0);
+
+    // open之前已经注册的格式串
+    for (size_t i = 0; i < g_formats.size(); ++i)
+    {
+        writeFormat(base, static_cast<uint32_t>(i + 1), g_formats[i]);
+    }
+
+    g_mapSize = mapSize;
+    ++g_generation;
+    base_.store(base, std::memory_order_release);
+    return true;
+}
+
+// 解除映射，需在各线程停止写日志之后调用
+void BinaryLog::close()
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+    char *base = base_.exchange(nullptr);
+    if (base != nullptr)
+    {
+        ::msync(base, g_mapSize, MS_ASYNC);
+        ::munmap(base, g_mapSize);
+    }
+}
+
+// 注册格式串，返回格式串编号
+uint32_t BinaryLog::registerFormat(const char *format, const char *file, int line)
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+    FormatEntry entry = {format, file, line};
+    g_formats.push_back(entry);
+    uint32_t id = static_cast<uint32_t>(g_formats.size());
+    char *base = base_.load(std::memory_order_acquire);
+    if (base != nullptr)
+    {
+        writeFormat(base, id, entry);
+    }
+    return id;
+}
+
+// 在当前线程的环形缓冲区中预留size字节，放不下时在末尾写填充记录后从头开始
+char *BinaryLog::reserve(size_t size)
+{
+    ThreadRing &tr = t_ring;
+    if (tr.generation != g_generation.load(std::memory_order_acquire))
+    {
+        acquireRing(tr, base_.load(std::memory_order_acquire));
+    }
+    if (tr.ring == nullptr || size > tr.size / 4)
+    {
+        return nullptr;
+    }
+
+    uint64_t head = tr.ring->head.load(std::memory_order_relaxed);
+    size_t pos = head % tr.size;
+    if (pos + size > tr.size)
+    {
+        uint32_t pad = static_cast<uint32_t>(tr.size - pos);
+        makeRoom(tr, head + pad + size);
+        memcpy(tr.data + pos, &pad, sizeof pad);
+        memcpy(tr.data + pos + 4, &kPaddingId, sizeof kPaddingId);
+        head += pad;
+        tr.ring->head.store(head, std::memory_order_release);
+        pos = 0;
+    }
+    else
+    {
+        makeRoom(tr, head + size);
+    }
+    tr.reservedHead = head;
+    return tr.data + pos;
+}
+
+char *BinaryLog::writeRecordHeader(char *p, size_t size, uint32_t formatId)
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t nanos = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    uint32_t size32 = static_cast<uint32_t>(size);
+    memcpy(p, &size32, 4);
+    memcpy(p + 4, &formatId, 4);
+    memcpy(p + 8, &nanos, 8);
+    return p + kRecordHeaderSize;
+}
+
+// 记录写完之后才推进head，崩溃时最多丢失正在写的一条
+void BinaryLog::commit(size_t size)
+{
+    ThreadRing &tr = t_ring;
+    tr.ring->head.store(tr.reservedHead + size, std::memory_order_release);
+}
+
+namespace
+{
+struct DecodedFormat
+{
+    std::string format;
+    std::string file;
+    uint32_t line;
+};
+
+struct DecodedRecord
+{
+    int64_t nanos;
+    int32_t tid;
+    uint32_t formatId;
+    const char *args;
+    const char *end;
+};
+
+// 从记录中取出下一个参数，字符串放在str中，数值放在raw中；记录被截断时返回false，不会越过end
+bool nextArg(const char *&p, const char *end, char *type, uint64_t *raw, std::string *str)
+{
+    if (end - p < 1)
+    {
+        return false;
+    }
+    *type = *p++;
+    if (*type == 's')
+    {
+        uint32_t len;
+        if (end - p < 4)
+        {
+            return false;
+        }
+        memcpy(&len, p, 4);
+        p += 4;
+        if (static_cast<size_t>(end - p) < len)
+        {
+            return false;
+        }
+        str->assign(p, len);
+        p += len;
+        return true;
+    }
+    if (end - p < 8)
+    {
+        return false;
+    }
+    memcpy(raw, p, 8);
+    p += 8;
+    return true;
+}
+
+// 按格式串依次取出参数，去掉长度修饰符后统一按64位的类型格式化
+// 宽度和精度中的*和printf一样各消耗一个参数，在这里替换成具体的数值
+std::string formatRecord(const std::string &format, const char *p, const char *end)
+{
+    std::string out;
+    char buf[4096];
+    size_t i = 0;
+    bool truncated = false;
+    while (i < format.size())
+    {
+        char c = format[i];
+        if (c != '%')
+        {
+            out += c;
+            ++i;
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%')
+        {
+            out += '%';
+            i += 2;
+            continue;
+        }
+
+        // 解析 %[flags][width][.precision][length]conversion
+        std::string spec("%");
+        size_t j = i + 1;
+        while (j < format.size() && strchr("-+ #0123456789.*", format[j]))
+        {
+            if (format[j] == '*')
+            {
+                char type;
+                uint64_t raw = 0;
+                std::string ignored;
+                truncated = truncated || !nextArg(p, end, &type, &raw, &ignored);
+                long long v = (truncated || type == 's' || type == 'f') ? 0 : static_cast<long long>(static_cast<int64_t>(raw));
+                // 限制宽度和精度，避免格式化结果超出buf
+                v = std::max(-1024LL, std::min(1024LL, v));
+                spec += std::to_string(v);
+                ++j;
+                continue;
+            }
+            spec += format[j++];
+        }
+        while (j < format.size() && strchr("hljztLq", format[j]))
+        {
+            ++j;
+        }
+        if (j >= format.size())
+        {
+            out += format.substr(i);
+            break;
+        }
+        char conv = format[j];
+        i = j + 1;
+
+        char type;
+        uint64_t raw = 0;
+        std::string s;
+        if (truncated || !nextArg(p, end, &type, &raw, &s))
+        {
+            truncated = true;
+            out += "<missing>";
+            continue;
+        }
+        if (type == 's')
+        {
+            if (conv == 's')
+            {
+                snprintf(buf, sizeof buf, (spec + "s").c_str(), s.c_str());
+                out += buf;
+            }
+            else
+            {
+                out += s;
+            }
+            continue;
+        }
+
+        switch (conv)
+        {
+        case 'd':
+        case 'i':
+        case 'c':
+        {
+            int64_t v = (type == 'f') ? 0 : static_cast<int64_t>(raw);
+            if (conv == 'c')
+            {
+                snprintf(buf, sizeof buf, (spec + "c").c_str(), static_cast<int>(v));
+            }
+            else
+            {
+                snprintf(buf, sizeof buf, (spec + "lld").c_str(), static_cast<long long>(v));
+            }
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            snprintf(buf, sizeof buf, (spec + "ll" + conv).c_str(), static_cast<unsigned long long>(raw));
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        {
+            double v;
+            if (type == 'f')
+            {
+                memcpy(&v, &raw, sizeof v);
+            }
+            else
+            {
+                v = (type == 'i') ? static_cast<double>(static_cast<int64_t>(raw)) : static_cast<double>(raw);
+            }
+            snprintf(buf, sizeof buf, (spec + conv).c_str(), v);
+            break;
+        }
+        case 'p':
+            snprintf(buf, sizeof buf, (spec + "p").c_str(), reinterpret_cast<void *>(raw));
+            break;
+        default:
+            snprintf(buf, sizeof buf, "<%%%c?>", conv);
+            break;
+        }
+        out += buf;
+    }
+    return out;
+}
+} // namespace
+
+// 把日志文件还原成文本，各线程的记录按时间排序后输出到out
+bool BinaryLog::decode(const std::string &path, FILE *out)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "BinaryLog::decode open %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < kFileHeaderSize)
+    {
+        fprintf(stderr, "BinaryLog::decode %s: file too small\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    size_t fileSize = st.st_size;
+    void *addr = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        fprintf(stderr, "BinaryLog::decode mmap %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    const char *base = static_cast<const char *>(addr);
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(base);
+    if (memcmp(header->magic, kMagic, sizeof kMagic) != 0 || header->version != kVersion
+        || header->formatTableOffset > fileSize || header->formatTableSize > fileSize - header->formatTableOffset)
+    {
+        fprintf(stderr, "BinaryLog::decode %s: bad magic, version or header\n", path.c_str());
+        ::munmap(addr, fileSize);
+        return false;
+    }
+
+    // 读出格式串表
+    std::unordered_map<uint32_t, DecodedFormat> formats;
+    const char *p = base + header->formatTableOffset;
+    const char *tableEnd = p + std::min<uint64_t>(header->formatTableUsed.load(), header->formatTableSize);
+    while (p + 12 <= tableEnd)
+    {
+        uint32_t id, line;
+        uint16_t fileLen, formatLen;
+        memcpy(&id, p, 4);
+        memcpy(&line, p + 4, 4);
+        memcpy(&fileLen, p + 8, 2);
+        memcpy(&formatLen, p + 10, 2);
+        if (p + 12 + fileLen + formatLen > tableEnd)
+        {
+            break;
+        }
+        DecodedFormat &f = formats[id];
+        f.file.assign(p + 12, fileLen);
+        f.format.assign(p + 12 + fileLen, formatLen);
+        f.line = line;
+        p += 12 + fileLen + formatLen;
+    }
+
+    // 收集所有线程环形缓冲区中[tail, head)之间的记录
+    std::vector<DecodedRecord> records;
+    const uint64_t ringSize = header->ringSize;
+    uint32_t rings = std::min(header->threadsUsed.load(), header->maxThreads);
+    for (uint32_t i = 0; i < rings; ++i)
+    {
+        size_t offset = header->ringsOffset + i * (kRingHeaderSize + ringSize);
+        if (offset + kRingHeaderSize + ringSize > fileSize)
+        {
+            break;
+        }
+        const RingHeader *ring = reinterpret_cast<const RingHeader *>(base + offset);
+        const char *data = base + offset + kRingHeaderSize;
+        uint64_t head = ring->head.load();
+        uint64_t pos = ring->tail.load();
+        if (head < pos || head - pos > ringSize)
+        {
+            continue;
+        }
+        while (pos < head)
+        {
+            const char *rec = data + pos % ringSize;
+            uint32_t size, formatId;
+            memcpy(&size, rec, 4);
+            memcpy(&formatId, rec + 4, 4);
+            if (size < 8 || size > ringSize || pos % ringSize + size > ringSize)
+            {
+                break; // 记录损坏，丢弃该线程余下的记录
+            }
+            if (formatId != kPaddingId && size >= kRecordHeaderSize)
+            {
+                DecodedRecord r;
+                memcpy(&r.nanos, rec + 8, 8);
+                r.tid = ring->tid;
+                r.formatId = formatId;
+                r.args = rec + kRecordHeaderSize;
+                r.end = rec + size;
+                records.push_back(r);
+            }
+            pos += size;
+        }
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+                     [](const DecodedRecord &a, const DecodedRecord &b) { return a.nanos < b.nanos; });
+
+    for (const DecodedRecord &r : records)
+    {
+        time_t seconds = static_cast<time_t>(r.nanos / 1000000000);
+        struct tm tm;
+        localtime_r(&seconds, &tm);
+        char timebuf[64];
+        strftime(timebuf, sizeof timebuf, "%Y/%m/%d %H:%M:%S", &tm);
+
+        auto it = formats.find(r.formatId);
+        if (it == formats.end())
+        {
+            fprintf(out, "%s.%09lld [%d] <unknown format %u>\n", timebuf,
+                    static_cast<long long>(r.nanos % 1000000000), r.tid, r.formatId);
+            continue;
+        }
+        std::string msg = formatRecord(it->second.format, r.args, r.end);
+        while (!msg.empty() && msg.back() == '\n')
+        {
+            msg.pop_back();
+        }
+        fprintf(out, "%s.%09lld [%d] %s:%u %s\n", timebuf,
+                static_cast<long long>(r.nanos % 1000000000), r.tid,
+                it->second.file.c_str(), it->second.line, msg.c_str());
+    }
+
+    ::munmap(addr, fileSize);
+    return true;
+}
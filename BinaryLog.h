@@ -0,0 +1,145 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+/*
+ * 二进制日志，和Logger并存
+ * 调用点只记录格式串的编号(每个调用点第一次执行时注册)、时间戳和原始参数，不做任何格式化
+ * 每个线程独占mmap文件中的一段环形缓冲区，写满后覆盖最旧的记录；
+ * 数据直接写在MAP_SHARED映射的页缓存里，进程崩溃后最近的日志仍然保留在文件中
+ * 由离线工具 tools/logdecode 把文件还原成文本
+ *
+ * BinaryLog::open("/tmp/server.blog");
+ * LOG_BINARY("fd=%d events=%d", fd, events);
+ */
+#define LOG_BINARY(logmsgFormat, ...)                                                       \
+    do                                                                                      \
+    {                                                                                       \
+        static const uint32_t blogFormatId = BinaryLog::registerFormat(logmsgFormat, __FILE__, __LINE__); \
+        BinaryLog::record(blogFormatId, ##__VA_ARGS__);                                     \
+    } while (0)
+
+class BinaryLog : noncopyable
+{
+public:
+    // 创建(覆盖)日志文件，ringSize为每个线程环形缓冲区的字节数，最多maxThreads个线程写入
+    static bool open(const std::string &path, size_t ringSize = 1024 * 1024, int maxThreads = 64);
+    // 解除映射，需在各线程停止写日志之后调用
+    static void close();
+    static bool enabled() { return base_.load(std::memory_order_acquire) != nullptr; }
+
+    // 注册格式串，返回格式串编号，同一个调用点只注册一次
+    static uint32_t registerFormat(const char *format, const char *file, int line);
+
+    template <typename... Args>
+    static void record(uint32_t formatId, const Args &... args)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+        size_t size = kRecordHeaderSize + argsSize(args...);
+        size = (size + 7) & ~static_cast<size_t>(7);
+        char *p = reserve(size);
+        if (p == nullptr)
+        {
+            return;
+        }
+        char *cur = writeRecordHeader(p, size, formatId);
+        encode(cur, args...);
+        commit(size);
+    }
+
+    // 把日志文件还原成文本，各线程的记录按时间排序后输出到out
+    static bool decode(const std::string &path, FILE *out);
+
+private:
+    // 参数的类型标记
+    enum ArgType : uint8_t
+    {
+        kSigned = 'i',
+        kUnsigned = 'u',
+        kDouble = 'f',
+        kString = 's',
+        kPointer = 'p',
+    };
+
+    static const size_t kRecordHeaderSize = 16; // uint32 size, uint32 formatId, int64 纳秒时间戳
+    static const uint32_t kMaxStringLen = 4096;
+
+    static char *reserve(size_t size);
+    static char *writeRecordHeader(char *p, size_t size, uint32_t formatId);
+    static void commit(size_t size);
+
+    // 计算参数编码后的长度
+    static size_t argsSize() { return 0; }
+    template <typename T, typename... Rest>
+    static size_t argsSize(const T &arg, const Rest &... rest)
+    {
+        return argSize(arg) + argsSize(rest...);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value, size_t>::type
+    argSize(const T &) { return 1 + 8; }
+    static size_t argSize(const char *s) { return 1 + 4 + stringLen(s); }
+    static size_t argSize(char *s) { return argSize(static_cast<const char *>(s)); }
+    static size_t argSize(const std::string &s) { return 1 + 4 + std::min<size_t>(s.size(), kMaxStringLen); }
+
+    static size_t stringLen(const char *s) { return s ? strnlen(s, kMaxStringLen) : 0; }
+
+    // 按 类型标记 + 原始数据 的格式依次编码参数
+    static void encode(char *&) {}
+    template <typename T, typename... Rest>
+    static void encode(char *&p, const T &arg, const Rest &... rest)
+    {
+        encodeArg(p, arg);
+        encode(p, rest...);
+    }
+
+    template <typename T>
+    static typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value) || std::is_enum<T>::value>::type
+    encodeArg(char *&p, const T &v) { putTagged(p, kSigned, static_cast<int64_t>(v)); }
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    encodeArg(char *&p, const T &v) { putTagged(p, kUnsigned, static_cast<uint64_t>(v)); }
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    encodeArg(char *&p, const T &v) { putTagged(p, kDouble, static_cast<double>(v)); }
+    template <typename T>
+    static typename std::enable_if<std::is_pointer<T>::value>::type
+    encodeArg(char *&p, const T &v) { putTagged(p, kPointer, reinterpret_cast<uint64_t>(v)); }
+    static void encodeArg(char *&p, const char *s) { putString(p, s, stringLen(s)); }
+    static void encodeArg(char *&p, char *s) { encodeArg(p, static_cast<const char *>(s)); }
+    static void encodeArg(char *&p, const std::string &s)
+    {
+        putString(p, s.data(), std::min<size_t>(s.size(), kMaxStringLen));
+    }
+
+    template <typename V>
+    static void putTagged(char *&p, ArgType type, V v)
+    {
+        *p++ = static_cast<char>(type);
+        memcpy(p, &v, sizeof v);
+        p += sizeof v;
+    }
+    static void putString(char *&p, const char *s, size_t len)
+    {
+        uint32_t n = static_cast<uint32_t>(len);
+        *p++ = static_cast<char>(kString);
+        memcpy(p, &n, sizeof n);
+        p += sizeof n;
+        memcpy(p, s, len);
+        p += len;
+    }
+
+    static std::atomic<char *> base_; // mmap映射的起始地址，为空表示未开启
+};
@@ -1,7 +1,12 @@
 #include "Buffer.h"
+#include "Timestamp.h"
 
 #include <sys/uio.h>
+#include <sys/socket.h>
 #include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
 
 /*
  * 从fd上读取数据，Poller工作在LT模式
@@ -42,6 +47,88 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     
 }
 
+// 和readFd(int, int*)相同，只是换成recvmsg，从控制消息中取出内核的软件接收时间戳和对端传来的fd
+ssize_t Buffer::readFd(int fd, int* saveErrno, Timestamp* receiveTime, std::deque<int>* fds)
+{
+    char extrabuf[65536];
+    struct iovec vec[2];
+    const size_t writable = writableBytes();
+
+    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_len = writable;
+
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof extrabuf;
+
+    // 一次最多接收kMaxFds个fd，超出部分内核会直接关闭
+    const int kMaxFds = 16;
+    // 和cmsghdr放在一个union里，保证按cmsghdr对齐
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(int) * kMaxFds)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {};
+    msg.msg_iov = vec;
+    msg.msg_iovlen = (writable < sizeof extrabuf) ? 2 : 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof control.buf;
+
+    const ssize_t n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+
+    // 控制消息被截断时fd与数据流的对应关系已经丢失，收到的fd全部关闭，由调用者关闭连接
+    const bool truncated = (msg.msg_flags & MSG_CTRUNC) != 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS && receiveTime)
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof ts);
+            *receiveTime = Timestamp(static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond
+                                     + ts.tv_nsec / 1000);
+        }
+        else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; ++i)
+            {
+                int received;
+                memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof received);
+                if (fds && !truncated)
+                {
+                    fds->push_back(received);
+                }
+                else
+                {
+                    ::close(received);
+                }
+            }
+        }
+    }
+
+    if (truncated)
+    {
+        *saveErrno = EMSGSIZE;
+        return -1;
+    }
+
+    if (n <= static_cast<ssize_t>(writable))
+    {
+        writerIndex_ += n;
+    }
+    else
+    {
+        writerIndex_ = buffer_.size();
+        append(extrabuf, n - writable);
+    }
+    return n;
+}
+
 // 向fd上写数据，source:缓冲区可读区域的所有数据，dest:fd
 ssize_t Buffer::writeFd(int fd, int* saveErrno)
 {
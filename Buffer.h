@@ -3,6 +3,9 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <deque>
+
+class Timestamp;
 
 /// +-------------------+------------------+------------------+
 /// | prependable bytes |  readable bytes  |  writable bytes  |
@@ -14,7 +17,8 @@
 class Buffer
 {
 public:
-    static const size_t kCheapPrepend = 8;
+    // 头部预留的空间，足够在数据前面直接写入一个WebSocket帧头(最长10字节)
+    static const size_t kCheapPrepend = 16;
     static const size_t kInitialSize = 1024;
 
     explicit Buffer(size_t initialSize = kInitialSize)
@@ -36,6 +40,17 @@ public:
     // 返回可读的起始地址
     const char* peek() const
     { return begin() + readerIndex_; }
+    // 可读数据的可写指针，用于原地修改已经收到的数据(例如WebSocket解掩码)
+    char* beginRead()
+    { return begin() + readerIndex_; }
+
+    // 在可读数据前面写入len字节，len不能超过prependableBytes()
+    void prepend(const void *data, size_t len)
+    {
+        readerIndex_ -= len;
+        const char *d = static_cast<const char*>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
 
     void append(const char *data, size_t len)
     {
@@ -57,6 +72,11 @@ public:
 
     // 从fd上读取数据
     ssize_t readFd(int fd, int* saveErrno);
+    // 用recvmsg读取数据，同时取出内核打上的接收时间戳(需先开启SO_TIMESTAMPNS)
+    // TCP一次读到多个分段时，内核给出的是本次读到的最后一个分段的时间戳，没有时间戳时receiveTime保持不变
+    // fds不为空时同时接收Unix域socket上通过SCM_RIGHTS传来的fd，追加到fds末尾，由调用者负责关闭
+    // 控制消息被截断(MSG_CTRUNC，对端一次传来的fd过多)时丢弃本次读到的数据和fd，返回-1，saveErrno为EMSGSIZE
+    ssize_t readFd(int fd, int* saveErrno, Timestamp* receiveTime, std::deque<int>* fds = nullptr);
     // 向fd上写数据，source:缓冲区可读区域的所有数据，dest:fd
     ssize_t writeFd(int fd, int* saveErrno);
 
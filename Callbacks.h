@@ -16,4 +16,22 @@ using MessageCallback       = std::function<void (const TcpConnectionPtr&,
                                                   Buffer*,
                                                   Timestamp)>;
 using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
-                            
\ No newline at end of file
+using TimerCallback         = std::function<void ()>;
+
+class ShmConnection;
+
+using ShmConnectionPtr      = std::shared_ptr<ShmConnection>;
+using ShmConnectionCallback = std::function<void (const ShmConnectionPtr&)>;
+using ShmMessageCallback    = std::function<void (const ShmConnectionPtr&,
+                                                  Buffer*,
+                                                  Timestamp)>;
+
+class WebSocketConnection;
+
+using WebSocketConnectionPtr      = std::shared_ptr<WebSocketConnection>;
+using WebSocketConnectionCallback = std::function<void (const WebSocketConnectionPtr&)>;
+// data指向连接的输入缓冲区，只在回调期间有效
+using WebSocketMessageCallback    = std::function<void (const WebSocketConnectionPtr&,
+                                                        const char *data,
+                                                        size_t len,
+                                                        bool binary)>;
@@ -2,6 +2,7 @@
 #include "Channel.h"
 #include "Logger.h"
 #include "EventLoop.h"
+#include "Tracer.h"
 
 #include <sys/epoll.h>
 
@@ -66,7 +67,8 @@ void Channel::handleEvent(Timestamp receiveTime)
 
 void Channel::handleEventWithGuard(Timestamp receiveTime) 
 {
-    LOG_INFO("channel handleEvent revents:%d\n", revents_);
+    TraceSpan span("handleEvent", "fd", fd_);
+    LOG_DEBUG("channel handleEvent revents:%d\n", revents_);
 
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
@@ -0,0 +1,233 @@
+#include "ComputeThreadPool.h"
+#include "Thread.h"
+#include "Logger.h"
+
+// 当前线程所属的计算线程池以及在池中的下标，用于工作线程内部提交任务时直接放入自己的队列
+static __thread ComputeThreadPool *t_computePool = nullptr;
+static __thread int t_workerIndex = -1;
+
+struct ComputeThreadPool::Worker
+{
+    mutable std::mutex mutex;
+    std::deque<Task> tasks;
+    std::unique_ptr<Thread> thread;
+    std::atomic<uint64_t> executed;
+    std::atomic<uint64_t> stolen;
+
+    Worker() : executed(0), stolen(0) {}
+};
+
+ComputeThreadPool::ComputeThreadPool(const std::string &nameArg)
+    : name_(nameArg)
+    , numThreads_(0)
+    , maxQueueSize_(65536)
+    , started_(false)
+    , running_(false)
+    , next_(0)
+    , pending_(0)
+    , idleWorkers_(0)
+    , submitted_(0)
+    , rejected_(0)
+{
+}
+
+ComputeThreadPool::~ComputeThreadPool()
+{
+    stop();
+}
+
+void ComputeThreadPool::start()
+{
+    if (started_.exchange(true) || numThreads_ <= 0)
+    {
+        return;
+    }
+    running_ = true;
+
+    // 先创建好所有的队列再启动线程，工作线程一开始就可以互相窃取
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        workers_.push_back(std::unique_ptr<Worker>(new Worker));
+    }
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        std::string threadName = name_ + std::to_string(i);
+        workers_[i]->thread.reset(new Thread(std::bind(&ComputeThreadPool::threadFunc, this, i), threadName));
+        workers_[i]->thread->start();
+    }
+}
+
+void ComputeThreadPool::stop()
+{
+    // 在工作线程中调用会join自己，直接死锁
+    if (t_computePool == this)
+    {
+        LOG_ERROR("ComputeThreadPool::stop [%s] - called in a worker thread, ignored \n", name_.c_str());
+        return;
+    }
+
+    // 持有所有队列的锁修改running_，submit在队列锁内再检查一次，停止之后不会再有任务入队而无人执行
+    {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (auto &worker : workers_)
+        {
+            locks.emplace_back(worker->mutex);
+        }
+        if (!running_.exchange(false))
+        {
+            return;
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+    }
+    cond_.notify_all();
+
+    for (auto &worker : workers_)
+    {
+        worker->thread->join();
+    }
+}
+
+// 提交一个任务，超过排队上限或线程池已停止时返回false
+bool ComputeThreadPool::submit(Task task)
+{
+    if (!running_)
+    {
+        LOG_ERROR("ComputeThreadPool::submit [%s] - pool is not running \n", name_.c_str());
+        return false;
+    }
+
+    // 工作线程内部提交的任务放入自己的队列，外部线程轮询选择工作线程
+    int index = (t_computePool == this) ? t_workerIndex
+                                        : static_cast<int>(next_++ % workers_.size());
+    {
+        Worker &worker = *workers_[index];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        // stop可能在上面的检查之后开始，工作线程排空队列退出后再入队的任务就丢了
+        if (!running_)
+        {
+            lock.unlock();
+            LOG_ERROR("ComputeThreadPool::submit [%s] - pool is stopping \n", name_.c_str());
+            return false;
+        }
+        if (pending_.fetch_add(1) >= maxQueueSize_)
+        {
+            --pending_;
+            ++rejected_;
+            return false;
+        }
+        worker.tasks.push_back(std::move(task));
+    }
+    ++submitted_;
+
+    // 只有存在休眠的工作线程时才需要加锁唤醒，pending_和idleWorkers_的顺序一致性保证了不会丢失唤醒
+    if (idleWorkers_ > 0)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+        }
+        cond_.notify_one();
+    }
+    return true;
+}
+
+// 从自己队列的队头取任务
+bool ComputeThreadPool::popLocal(int index, Task *task)
+{
+    Worker &worker = *workers_[index];
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty())
+    {
+        return false;
+    }
+    *task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return true;
+}
+
+// 从其他工作线程队列的队尾窃取任务
+bool ComputeThreadPool::steal(int index, Task *task)
+{
+    const int n = static_cast<int>(workers_.size());
+    for (int i = 1; i < n; ++i)
+    {
+        Worker &victim = *workers_[(index + i) % n];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            *task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ComputeThreadPool::threadFunc(int index)
+{
+    t_computePool = this;
+    t_workerIndex = index;
+    Worker &worker = *workers_[index];
+
+    while (true)
+    {
+        Task task;
+        bool stolen = false;
+        if (popLocal(index, &task) || (stolen = steal(index, &task)))
+        {
+            --pending_;
+            task();
+            ++worker.executed;
+            if (stolen)
+            {
+                ++worker.stolen;
+            }
+            continue;
+        }
+
+        // 所有队列都为空，休眠等待新任务；停止时已排队的任务执行完才退出
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++idleWorkers_;
+        cond_.wait(lock, [this]() { return pending_ > 0 || !running_; });
+        --idleWorkers_;
+        if (!running_ && pending_ == 0)
+        {
+            break;
+        }
+    }
+
+    t_computePool = nullptr;
+    t_workerIndex = -1;
+}
+
+ComputeThreadPool::Stats ComputeThreadPool::stats() const
+{
+    Stats s;
+    s.queueDepth = pending_;
+    s.submitted = submitted_;
+    s.rejected = rejected_;
+    s.executed = 0;
+    s.stolen = 0;
+    for (const auto &worker : workers_)
+    {
+        s.executed += worker->executed;
+        s.stolen += worker->stolen;
+    }
+    return s;
+}
+
+// 第index个工作线程的队列深度
+size_t ComputeThreadPool::queueDepth(int index) const
+{
+    const Worker &worker = *workers_[index];
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    return worker.tasks.size();
+}
+
+// 窃取执行的任务占全部已执行任务的比例
+double ComputeThreadPool::stealRate() const
+{
+    Stats s = stats();
+    return s.executed == 0 ? 0.0 : static_cast<double>(s.stolen) / s.executed;
+}
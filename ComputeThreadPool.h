@@ -0,0 +1,141 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "EventLoop.h"
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <type_traits>
+
+class Thread;
+
+/*
+ * 计算线程池，用于把解析、压缩、加解密等CPU密集型的任务从subLoop中卸载出去
+ * 每个工作线程拥有自己的任务双端队列，自己从队头取任务，空闲时从其他线程的队尾窃取任务
+ * 全局排队任务数有上限，超过上限的任务直接拒绝，由调用方决定降级策略
+ */
+class ComputeThreadPool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    struct Stats
+    {
+        size_t queueDepth;  // 当前排队中的任务数
+        uint64_t submitted; // 累计提交成功的任务数
+        uint64_t rejected;  // 因超过排队上限而被拒绝的任务数
+        uint64_t executed;  // 累计执行完成的任务数
+        uint64_t stolen;    // 其中通过窃取执行的任务数
+    };
+
+    explicit ComputeThreadPool(const std::string &nameArg = std::string("ComputeThreadPool"));
+    ~ComputeThreadPool();
+
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    // 设置全局排队任务数的上限
+    void setMaxQueueSize(size_t maxSize) { maxQueueSize_ = maxSize; }
+
+    void start();
+    // 停止接收新任务，执行完已排队的任务后回收所有工作线程，不能在工作线程中调用
+    void stop();
+
+    // 提交一个任务，超过排队上限或线程池已停止时返回false
+    bool submit(Task task);
+
+    /*
+     * 在计算线程中执行work，再通过queueInLoop把结果送回loop所在线程交给done处理
+     * 结果对象只构造一次，之后以移动的方式交给done，不会产生额外的拷贝
+     * work返回void时，done不带参数，只用来在loop线程中得到完成通知
+     * MessageCallback中的用法：pool->submit(conn->getLoop(), work, done)
+     */
+    template <typename Work, typename Done>
+    bool submit(EventLoop *loop, Work work, Done done)
+    {
+        return submit(Task(LoopTask<Work, Done>(loop, std::move(work), std::move(done))));
+    }
+
+    bool started() const { return started_; }
+    const std::string &name() const { return name_; }
+    int numThreads() const { return static_cast<int>(workers_.size()); }
+
+    Stats stats() const;
+    // 第index个工作线程的队列深度
+    size_t queueDepth(int index) const;
+    // 窃取执行的任务占全部已执行任务的比例
+    double stealRate() const;
+
+private:
+    struct Worker;
+
+    // 在计算线程中执行work，并把结果送回loop
+    template <typename Work, typename Done, typename Result = typename std::result_of<Work()>::type>
+    struct LoopTask
+    {
+        LoopTask(EventLoop *loop, Work work, Done done)
+            : loop_(loop), work_(std::move(work)), done_(std::move(done))
+        {
+        }
+
+        void operator()()
+        {
+            std::shared_ptr<Result> result = std::make_shared<Result>(work_());
+            loop_->queueInLoop(std::bind(&LoopTask::deliver, done_, result));
+        }
+
+        static void deliver(const Done &done, const std::shared_ptr<Result> &result)
+        {
+            done(std::move(*result));
+        }
+
+        EventLoop *loop_;
+        Work work_;
+        Done done_;
+    };
+
+    // work没有返回值，执行完之后在loop中调用done()
+    template <typename Work, typename Done>
+    struct LoopTask<Work, Done, void>
+    {
+        LoopTask(EventLoop *loop, Work work, Done done)
+            : loop_(loop), work_(std::move(work)), done_(std::move(done))
+        {
+        }
+
+        void operator()()
+        {
+            work_();
+            loop_->queueInLoop(done_);
+        }
+
+        EventLoop *loop_;
+        Work work_;
+        Done done_;
+    };
+
+    void threadFunc(int index);
+    bool popLocal(int index, Task *task);
+    bool steal(int index, Task *task);
+
+    std::string name_;
+    int numThreads_;
+    size_t maxQueueSize_;
+    std::atomic_bool started_;
+    std::atomic_bool running_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<unsigned> next_; // 外部线程提交任务时，以轮询的方式选择工作线程
+
+    std::atomic<size_t> pending_;   // 所有队列中排队的任务总数
+    std::atomic<int> idleWorkers_;  // 正在等待任务的工作线程数
+    std::atomic<uint64_t> submitted_;
+    std::atomic<uint64_t> rejected_;
+
+    std::mutex mutex_; // 只用于空闲线程的休眠与唤醒
+    std::condition_variable cond_;
+};
@@ -0,0 +1,33 @@
+#include "ConnectionStats.h"
+
+#include <stdio.h>
+
+void ConnectionStats::merge(const ConnectionStats &other)
+{
+    io_.add(other.io_);
+    readToCallback_.merge(other.readToCallback_);
+    callbackDuration_.merge(other.callbackDuration_);
+    enqueueToFlush_.merge(other.enqueueToFlush_);
+}
+
+void ConnectionStats::reset()
+{
+    io_ = IoCounters();
+    readToCallback_.reset();
+    callbackDuration_.reset();
+    enqueueToFlush_.reset();
+}
+
+std::string ConnectionStats::toJson() const
+{
+    char buf[128];
+    snprintf(buf, sizeof buf, "{\"bytes_read\":%llu,\"bytes_written\":%llu,\"read_calls\":%llu,\"write_calls\":%llu",
+             static_cast<unsigned long long>(io_.bytesRead), static_cast<unsigned long long>(io_.bytesWritten),
+             static_cast<unsigned long long>(io_.readCalls), static_cast<unsigned long long>(io_.writeCalls));
+    std::string json(buf);
+    json += ",\"read_to_callback_ns\":" + readToCallback_.toJson();
+    json += ",\"callback_ns\":" + callbackDuration_.toJson();
+    json += ",\"enqueue_to_flush_ns\":" + enqueueToFlush_.toJson();
+    json += "}";
+    return json;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Histogram.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+
+// 单个连接两个方向上的字节数和系统调用次数
+struct IoCounters
+{
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t readCalls = 0;
+    uint64_t writeCalls = 0;
+
+    void add(const IoCounters &other)
+    {
+        bytesRead += other.bytesRead;
+        bytesWritten += other.bytesWritten;
+        readCalls += other.readCalls;
+        writeCalls += other.writeCalls;
+    }
+};
+
+/*
+ * 一个loop上开启了统计的连接的汇总，由EventLoop持有，只在loop线程中记录和读取
+ * 用来区分延迟是花在reactor上还是花在用户的回调里：
+ *   readToCallback    epoll_wait返回到MessageCallback开始执行，包括读socket和同一轮中排在前面的连接
+ *   callbackDuration  MessageCallback本身执行的时间
+ *   enqueueToFlush    outputBuffer_从有数据到全部写入socket的时间，直接写完的数据不经过outputBuffer_，不记录
+ * 记录只是下标计算和自增，不分配内存
+ */
+class ConnectionStats
+{
+public:
+    void recordRead(ssize_t n, int64_t pollToCallbackNanos)
+    {
+        io_.bytesRead += n;
+        ++io_.readCalls;
+        readToCallback_.record(static_cast<uint64_t>(pollToCallbackNanos));
+    }
+    void recordCallback(int64_t nanos) { callbackDuration_.record(static_cast<uint64_t>(nanos)); }
+    void recordWrite(ssize_t n)
+    {
+        if (n > 0)
+        {
+            io_.bytesWritten += n;
+        }
+        ++io_.writeCalls;
+    }
+    void recordFlush(int64_t nanos) { enqueueToFlush_.record(static_cast<uint64_t>(nanos)); }
+
+    const IoCounters& io() const { return io_; }
+    const Histogram& readToCallback() const { return readToCallback_; }
+    const Histogram& callbackDuration() const { return callbackDuration_; }
+    const Histogram& enqueueToFlush() const { return enqueueToFlush_; }
+
+    void merge(const ConnectionStats &other);
+    void reset();
+
+    // {"bytes_read":..,"bytes_written":..,"read_calls":..,"write_calls":..,
+    //  "read_to_callback_ns":{..},"callback_ns":{..},"enqueue_to_flush_ns":{..}}
+    std::string toJson() const;
+
+private:
+    IoCounters io_;
+    Histogram readToCallback_;
+    Histogram callbackDuration_;
+    Histogram enqueueToFlush_;
+};
@@ -0,0 +1,259 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Socket.h"
+#include "Logger.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+static int createNonblocking(bool unixDomain)
+{
+    int sockfd = unixDomain ? ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)
+                            : ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d sockfd create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+// 在[delay/2, delay]之间随机选取实际的等待时间
+static int jitter(int delayMs)
+{
+    static __thread unsigned int seed = 0;
+    if (seed == 0)
+    {
+        seed = static_cast<unsigned int>(CurrentThread::tid()) ^ static_cast<unsigned int>(::time(NULL));
+    }
+    int half = delayMs / 2;
+    return half + static_cast<int>(::rand_r(&seed) % (half + 1));
+}
+
+const int Connector::kMaxRetryDelayMs;
+const int Connector::kInitRetryDelayMs;
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , unixDomain_(false)
+    , connect_(false)
+    , state_(kDisconnected)
+    , retryDelayMs_(kInitRetryDelayMs)
+{
+    LOG_DEBUG("Connector::ctor[%p]", this);
+}
+
+Connector::Connector(EventLoop *loop, const UnixAddress &serverAddr)
+    : loop_(loop)
+    , unixAddr_(serverAddr)
+    , unixDomain_(true)
+    , connect_(false)
+    , state_(kDisconnected)
+    , retryDelayMs_(kInitRetryDelayMs)
+{
+    if (!serverAddr.valid())
+    {
+        LOG_FATAL("%s:%s:%d empty unix socket path \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    LOG_DEBUG("Connector::ctor[%p] unix", this);
+}
+
+Connector::~Connector()
+{
+    LOG_DEBUG("Connector::dtor[%p]", this);
+}
+
+std::string Connector::serverName() const
+{
+    return unixDomain_ ? unixAddr_.toPath() : serverAddr_.toIpPort();
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    if (connect_)
+    {
+        connect();
+    }
+    else
+    {
+        LOG_DEBUG("Connector::startInLoop do not connect");
+    }
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    loop_->cancel(retryTimer_);
+    if (state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = kInitRetryDelayMs;
+    connect_ = true;
+    startInLoop();
+}
+
+// 非阻塞connect，根据errno判断是等待可写、重试还是放弃
+void Connector::connect()
+{
+    int sockfd = createNonblocking(unixDomain_);
+    int ret = unixDomain_ ? ::connect(sockfd, (const sockaddr *)unixAddr_.getSockAddr(), unixAddr_.length())
+                          : ::connect(sockfd, (const sockaddr *)serverAddr_.getSockAddr(), sizeof(sockaddr_in));
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+    case ENOENT: // Unix域socket的路径还不存在
+        retry(sockfd);
+        break;
+
+    case EACCES:
+    case EPERM:
+    case EAFNOSUPPORT:
+    case EALREADY:
+    case EBADF:
+    case EFAULT:
+    case ENOTSOCK:
+        LOG_ERROR("connect error in Connector::connect %d \n", savedErrno);
+        ::close(sockfd);
+        break;
+
+    default:
+        LOG_ERROR("Unexpected error in Connector::connect %d \n", savedErrno);
+        ::close(sockfd);
+        break;
+    }
+}
+
+// 等待socket可写，可写说明连接建立或者出错
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 当前可能正处在channel_的回调中，不能在这里直接释放channel_
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    LOG_DEBUG("Connector::handleWrite state=%d", state_);
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+
+    int sockfd = removeAndResetChannel();
+    int err = Socket::getSocketError(sockfd);
+    if (err)
+    {
+        LOG_ERROR("Connector::handleWrite - SO_ERROR = %d %s", err, strerror(err));
+        retry(sockfd);
+    }
+    else if (!unixDomain_ && Socket::isSelfConnect(sockfd))
+    {
+        LOG_ERROR("Connector::handleWrite - Self connect");
+        retry(sockfd);
+    }
+    else
+    {
+        setState(kConnected);
+        if (connect_ && newConnectionCallback_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = Socket::getSocketError(sockfd);
+        LOG_ERROR("Connector::handleError %s - SO_ERROR = %d %s",
+                  serverName().c_str(), err, strerror(err));
+        retry(sockfd);
+    }
+}
+
+// 关闭失败的socket，退避之后重新connect
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (connect_)
+    {
+        int delayMs = jitter(retryDelayMs_);
+        LOG_INFO("Connector::retry - Retry connecting to %s in %d milliseconds. ",
+                 serverName().c_str(), delayMs);
+        // 重试期间Connector不能被释放，回调里持有weak_ptr，Connector析构后不再重试
+        std::weak_ptr<Connector> weakSelf(shared_from_this());
+        retryTimer_ = loop_->runAfter(delayMs / 1000.0, [weakSelf]() {
+            std::shared_ptr<Connector> self = weakSelf.lock();
+            if (self)
+            {
+                self->startInLoop();
+            }
+        });
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
+    }
+    else
+    {
+        LOG_DEBUG("do not connect");
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "UnixAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class Channel;
+class EventLoop;
+
+/*
+ * 主动发起连接，TcpClient使用
+ * 非阻塞connect之后在EventLoop中等待socket可写，连接建立后把sockfd交给回调；
+ * 连接失败时按指数退避加随机抖动重试，避免大量连接同时重连冲击对端
+ */
+class Connector : noncopyable,
+                  public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    // 连接Unix域socket，对端尚未监听(路径不存在或拒绝连接)时同样退避重试
+    Connector(EventLoop *loop, const UnixAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+
+    // 开始连接，可以在任意线程调用
+    void start();
+    // 连接断开后重新连接，退避时间重置为初始值，必须在loop线程调用
+    void restart();
+    // 停止连接以及尚未到期的重试，可以在任意线程调用
+    void stop();
+
+    const InetAddress &serverAddress() const { return serverAddr_; }
+    const UnixAddress &unixAddress() const { return unixAddr_; }
+    bool unixDomain() const { return unixDomain_; }
+    // ip:port或者Unix域socket的路径，用于日志和连接名
+    std::string serverName() const;
+
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+    static const int kMaxRetryDelayMs = 30 * 1000;
+    static const int kInitRetryDelayMs = 500;
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    UnixAddress unixAddr_;
+    const bool unixDomain_;
+    std::atomic_bool connect_; // 用户是否希望保持连接
+    States state_;
+    std::unique_ptr<Channel> channel_; // 只在connect进行中存在
+    NewConnectionCallback newConnectionCallback_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
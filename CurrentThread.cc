@@ -9,7 +9,7 @@ namespace CurrentThread
         if (t_cachedTid == 0)
         {
             // 通过linux系统调用，获取当前线程的tid
-            t_cachedTid = static_cast<pid_t>(::syscall(SYS_getpid));
+            t_cachedTid = static_cast<pid_t>(::syscall(SYS_gettid));
         }
     }
 } // namespace CurrentThread
\ No newline at end of file
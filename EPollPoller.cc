@@ -31,8 +31,7 @@ EPollPoller::~EPollPoller()
 // 重写基类Poller的抽象方法
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    // 实际上应该用LOG_DEBUG 输出日志更为合理
-    LOG_INFO("EPollPoller::%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+    LOG_DEBUG("EPollPoller::%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
 
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
     int saveErrno = errno;
@@ -40,7 +39,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 
     if (numEvents > 0)
     {
-        LOG_INFO("%d events happened \n", numEvents);
+        LOG_DEBUG("%d events happened \n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == events_.size())
         {
@@ -76,7 +75,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 void EPollPoller::updateChannel(Channel *channel)
 {
     const int index = channel->index();
-    LOG_INFO("func=EPollPoller::%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
+    LOG_DEBUG("func=EPollPoller::%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
     
     if (index == kNew || index == kDeleted)
     {
@@ -114,7 +113,7 @@ void EPollPoller::removeChannel(Channel *channel)
     int fd = channel->fd();
     channels_.erase(fd);
 
-    LOG_INFO("func=EPollPoller::%s => fd=%d\n", __FUNCTION__, fd);
+    LOG_DEBUG("func=EPollPoller::%s => fd=%d\n", __FUNCTION__, fd);
 
     int index = channel->index();
     if (index == kAdded)
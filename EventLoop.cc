@@ -2,6 +2,11 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "ConnectionStats.h"
+#include "Tracer.h"
+#include "LoopWatchdog.h"
+#include "PerfCounters.h"
 
 #include <unistd.h>
 #include <sys/eventfd.h>
@@ -32,7 +37,15 @@ EventLoop::EventLoop()
     , quit_(false)
     , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid())
+    , pollReturnNanos_(0)
+    , busyNanos_(0)
+    , iterations_(0)
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
+    , heartbeat_(false)
+    , iterationStartNanos_(0)
+    , callbackStartNanos_(0)
+    , callbackFd_(-1)
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
 {
@@ -50,10 +63,12 @@ EventLoop::EventLoop()
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
     // 每一个eventloop都将监听wakeupchannel的EPOLLIN读时间了
     wakeupChannel_->enableReading();
+    LoopWatchdog::registerLoop(this);
 }
 
 EventLoop::~EventLoop()
 {
+    LoopWatchdog::unregisterLoop(this);
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
@@ -70,12 +85,36 @@ void EventLoop::loop()
     while (!quit_)
     {
         activeChannels_.clear();
-        // 监听两类fd   一种是client的fd，一种wakeupfd
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        {
+            TraceSpan span("epoll_wait", "events");
+            // 监听两类fd   一种是client的fd，一种wakeupfd
+            pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+            span.setArg(static_cast<int64_t>(activeChannels_.size()));
+        }
+        pollReturnNanos_ = Timestamp::monotonicNanos();
+        metrics_.events += activeChannels_.size();
+        if (activeChannels_.empty())
+        {
+            ++metrics_.pollTimeouts;
+        }
+        heartbeat_ = LoopWatchdog::active();
+        if (heartbeat_)
+        {
+            iterationStartNanos_.store(pollReturnNanos_, std::memory_order_relaxed);
+        }
         for (Channel *channel : activeChannels_)
         {
             // Poller监听哪些channel发生事件了，然后上报给EventLoop，通知channel处理相应的事件
-            channel->handleEvent(pollReturnTime_);
+            if (heartbeat_)
+            {
+                beginCallback(channel->fd());
+                channel->handleEvent(pollReturnTime_);
+                endCallback();
+            }
+            else
+            {
+                channel->handleEvent(pollReturnTime_);
+            }
         }
         // 执行当前EventLoop事件循环需要处理的回调操作
         /*
@@ -84,6 +123,23 @@ void EventLoop::loop()
          */
 
         doPendingFunctors();
+        if (heartbeat_)
+        {
+            iterationStartNanos_.store(0, std::memory_order_relaxed);
+        }
+        if (PerfCounters::enabled())
+        {
+            if (!perfCounters_)
+            {
+                perfCounters_.reset(new PerfCounters); // 计数器统计的是创建它的线程
+            }
+            perfCounters_->read(&metrics_.perf);
+        }
+
+        // 只有loop线程写入，无需原子的读改写
+        busyNanos_.store(busyNanos_.load(std::memory_order_relaxed) + Timestamp::monotonicNanos() - pollReturnNanos_,
+                         std::memory_order_relaxed);
+        iterations_.store(iterations() + 1, std::memory_order_relaxed);
     }
 
     LOG_INFO("EventLoop %p stop looping. \n", this);
@@ -133,7 +189,7 @@ void EventLoop::queueInLoop(Functor cb)
 // 用来唤醒loop所在的线程，向wakeupfd_写一个数据，wakeupChannel就发生读事件，当前loop线程就会被唤醒
 void EventLoop::wakeup()
 {
-    uint16_t one = 1;
+    uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
     {
@@ -141,15 +197,41 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    return runAt(addTime(Timestamp::now(), delay), std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), addTime(Timestamp::now(), interval), interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // 用于阻塞等待
 void EventLoop::handleRead()
 {
-    uint16_t one = 1;
+    uint64_t one = 1;
     ssize_t n = read(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
     {
         LOG_ERROR("EvetLoop::handRead() reads %lu bytes insetead of 8 \n", n);
     }
+    else
+    {
+        // eventfd的值是上次读取以来累计写入的次数
+        ++metrics_.wakeupReads;
+        metrics_.wakeups += one;
+    }
 }
 
 // EventLoop的方法 =》 Poller的方法
@@ -166,6 +248,56 @@ bool EventLoop::hasChannel(Channel *channel)
     return poller_->hasChannel(channel);
 }
 
+size_t EventLoop::queueSize()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return pendingFunctors_.size();
+}
+
+EventLoop::Heartbeat EventLoop::heartbeat() const
+{
+    Heartbeat hb;
+    hb.iterations = iterations();
+    hb.iterationStartNanos = iterationStartNanos_.load(std::memory_order_relaxed);
+    hb.callbackStartNanos = callbackStartNanos_.load(std::memory_order_relaxed);
+    hb.callbackFd = callbackFd_.load(std::memory_order_relaxed);
+    return hb;
+}
+
+void EventLoop::beginCallback(int fd)
+{
+    callbackFd_.store(fd, std::memory_order_relaxed);
+    callbackStartNanos_.store(Timestamp::monotonicNanos(), std::memory_order_relaxed);
+}
+
+// 超过预算的回调在loop线程中直接计数，每秒最多打印一条
+void EventLoop::endCallback()
+{
+    int64_t start = callbackStartNanos_.load(std::memory_order_relaxed);
+    callbackStartNanos_.store(0, std::memory_order_relaxed);
+    int64_t budget = LoopWatchdog::callbackBudgetNanos();
+    if (budget > 0)
+    {
+        int64_t elapsed = Timestamp::monotonicNanos() - start;
+        if (elapsed > budget)
+        {
+            ++metrics_.slowCallbacks;
+            LOG_ERROR_RATELIMIT(1, "EventLoop %p slow callback fd=%d took %lld us, budget %lld us",
+                                this, callbackFd_.load(std::memory_order_relaxed),
+                                static_cast<long long>(elapsed / 1000), static_cast<long long>(budget / 1000));
+        }
+    }
+}
+
+ConnectionStats* EventLoop::connectionStats()
+{
+    if (!connectionStats_)
+    {
+        connectionStats_.reset(new ConnectionStats);
+    }
+    return connectionStats_.get();
+}
+
 // 执行回调
 void EventLoop::doPendingFunctors()
 {
@@ -177,9 +309,24 @@ void EventLoop::doPendingFunctors()
         functors.swap(pendingFunctors_);
     }
 
+    metrics_.functors += functors.size();
+    if (functors.size() > metrics_.maxFunctorBatch)
+    {
+        metrics_.maxFunctorBatch = functors.size();
+    }
     for (const Functor& functor : functors)
     {
-        functor();  // 执行当前loop需要执行的回调操作s
+        TraceSpan span("functor", "batch", static_cast<int64_t>(functors.size()));
+        if (heartbeat_)
+        {
+            beginCallback(-1);
+            functor();
+            endCallback();
+        }
+        else
+        {
+            functor();  // 执行当前loop需要执行的回调操作s
+        }
     }
     callingPendingFunctors_ = false;
 }
@@ -10,8 +10,13 @@
 #include "CurrentThread.h"
 #include "Timestamp.h"
 #include "Channel.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "LoopMetrics.h"
 
 class Poller;
+class TimerQueue;
+class ConnectionStats;
 
 // 事件循环类 主要包含了两个大模块 Channel Poller (epoll的抽象)
 class EventLoop : noncopyable
@@ -28,6 +33,13 @@ public:
     void quit();
 
     Timestamp pollReturnTime() const { return pollReturnTime_; }
+    // 本轮poll返回时单调时钟的纳秒数
+    int64_t pollReturnNanos() const { return pollReturnNanos_; }
+
+    // loop线程累计处理事件和回调所花的时间(微秒)，不包含阻塞在poll上的时间，其他线程可以随时读取
+    int64_t busyMicros() const { return busyNanos_.load(std::memory_order_relaxed) / 1000; }
+    // loop已经循环的次数
+    uint64_t iterations() const { return iterations_.load(std::memory_order_relaxed); }
 
     // 在当前loop中执行cb
     void runInLoop(Functor cb);
@@ -36,17 +48,47 @@ public:
     // 用来唤醒loop所在的线程
     void wakeup();
 
+    // 定时器，可以在任意线程调用，回调在loop线程中执行
+    // 在time时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // delay秒之后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
+    // 本loop上开启了统计的连接的汇总，第一次调用时创建，只能在loop线程中调用
+    ConnectionStats* connectionStats();
+    // 运行计数，只能在loop线程中访问
+    LoopMetrics& metrics() { return metrics_; }
+    // 队列中等待执行的回调数，可在任意线程调用
+    size_t queueSize();
+
     // EventLoop的方法 =》 Poller的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
 
+    // 供LoopWatchdog读取的心跳，只在LoopWatchdog开启时记录，可在任意线程调用
+    struct Heartbeat
+    {
+        uint64_t iterations;
+        int64_t iterationStartNanos; // 当前这一轮开始的时间，0表示阻塞在poll中或者没有在循环
+        int64_t callbackStartNanos;  // 当前回调开始的时间，0表示不在回调中
+        int callbackFd;              // 当前回调的fd，-1表示queueInLoop的回调
+    };
+    Heartbeat heartbeat() const;
+    pid_t threadId() const { return threadId_; }
+
     // 判断EventLoop对象是否在自己的线程里面
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
 private:
     void handleRead();        // wake up
     void doPendingFunctors(); // 执行回调
+    void beginCallback(int fd);
+    void endCallback();
 
     using ChannelList = std::vector<Channel *>;
 
@@ -56,7 +98,20 @@ private:
     const pid_t threadId_; // 记录当前loop所在线程的id
 
     Timestamp pollReturnTime_; // poller返回发生事件的channels的时间点
+    int64_t pollReturnNanos_;
+    std::atomic<int64_t> busyNanos_;    // 只由loop线程写入，负载均衡时由其他线程读取
+    std::atomic<uint64_t> iterations_;
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> timerQueue_; // 声明在poller_之后，先于poller_析构
+    std::unique_ptr<ConnectionStats> connectionStats_;
+    std::unique_ptr<PerfCounters> perfCounters_; // 开启PerfCounters后在loop线程中创建
+    LoopMetrics metrics_;
+
+    // 心跳，只由loop线程写入，LoopWatchdog的后台线程读取
+    bool heartbeat_; // 本轮是否记录心跳
+    std::atomic<int64_t> iterationStartNanos_;
+    std::atomic<int64_t> callbackStartNanos_;
+    std::atomic<int> callbackFd_;
 
     int wakeupFd_; // 保存eventfd创建的fd。主要作用，当mainLoop获取一个新用户的cahnnel，通过轮询算法选择一个subLoop，通过该成员wakeupFd_唤醒subLoop处理。
     std::unique_ptr<Channel> wakeupChannel_;
@@ -23,9 +23,20 @@ EventLoopThread::~EventLoopThread()
 }
 
 EventLoop *EventLoopThread::startLoop()
+{
+    startThread();
+    return waitLoop();
+}
+
+// 只启动底层线程，不等待loop创建完成
+void EventLoopThread::startThread()
 {
     thread_.start(); // 启动底层的新线程
+}
 
+// 等待loop创建完成，返回该loop的地址
+EventLoop *EventLoopThread::waitLoop()
+{
     EventLoop *loop = nullptr;
     {
         std::unique_lock<std::mutex> lock(mutex_);
@@ -39,6 +50,12 @@ EventLoop *EventLoopThread::startLoop()
     return loop;
 }
 
+EventLoop *EventLoopThread::loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return loop_;
+}
+
 // 该方法是作为回调函数，在单独的新线程里面运行的
 void EventLoopThread::threadFunc()
 {
@@ -20,6 +20,13 @@ public:
 
     EventLoop* startLoop();
 
+    // 只启动底层线程，不等待loop创建完成，配合waitLoop可以让多个loop并行启动
+    void startThread();
+    // 等待loop创建完成，返回该loop的地址
+    EventLoop* waitLoop();
+    // 返回当前运行的loop，线程未启动或已退出时返回nullptr
+    EventLoop* loop();
+
 private:
     void threadFunc();
 
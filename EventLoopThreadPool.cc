@@ -7,6 +7,7 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string
     , started_(false)
     , numThreads_(0)
     , next_(0)
+    , nextThreadId_(0)
 {}
 
 EventLoopThreadPool::~EventLoopThreadPool()
@@ -15,15 +16,9 @@ EventLoopThreadPool::~EventLoopThreadPool()
 void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 {
     started_ = true;
+    callback_ = cb;
 
-    for (int i = 0; i < numThreads_; ++i)
-    {
-        char buf[name_.size() + 32];
-        snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
-        EventLoopThread *t = new EventLoopThread(cb, buf);
-        threads_.push_back(std::unique_ptr<EventLoopThread>(t));
-        loops_.push_back(t->startLoop());   // 底层创建线程，绑定一个新的EventLoop，并返回该loop的地址
-    }
+    addThreads(numThreads_);
 
     // 若整个服务端只有一个线程，则运行着baseloop
     if (numThreads_ == 0 && cb)
@@ -32,6 +27,47 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     }
 }
 
+/*
+ * 先启动所有的线程，再逐个等待loop创建完成
+ * 各线程中EventLoop的创建和初始化回调并行执行，启动耗时不再随线程数线性增长
+ */
+void EventLoopThreadPool::addThreads(int numThreads)
+{
+    std::vector<EventLoopThread*> starting;
+    for (int i = 0; i < numThreads; ++i)
+    {
+        std::string name = name_ + std::to_string(nextThreadId_++);
+        EventLoopThread *t = new EventLoopThread(callback_, name);
+        threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+        t->startThread();
+        starting.push_back(t);
+    }
+
+    for (EventLoopThread *t : starting)
+    {
+        loops_.push_back(t->waitLoop());   // 底层创建线程，绑定一个新的EventLoop，并返回该loop的地址
+    }
+    numThreads_ = static_cast<int>(loops_.size());
+}
+
+// 运行时摘下最后numThreads个loop线程
+std::vector<std::unique_ptr<EventLoopThread>> EventLoopThreadPool::retireThreads(int numThreads)
+{
+    std::vector<std::unique_ptr<EventLoopThread>> retired;
+    while (numThreads-- > 0 && !threads_.empty())
+    {
+        retired.push_back(std::move(threads_.back()));
+        threads_.pop_back();
+        loops_.pop_back();
+    }
+    numThreads_ = static_cast<int>(loops_.size());
+    if (next_ >= numThreads_)
+    {
+        next_ = 0;
+    }
+    return retired;
+}
+
 // 如果工作在多线程中，baseLoop_默认以轮询的方式分配channel给subloop
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
@@ -5,6 +5,7 @@
 #include <functional>
 #include <vector>
 #include <memory>
+#include <string>
 
 class EventLoop;
 class EventLoopThread;
@@ -19,6 +20,13 @@ public:
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
+
+    // 运行时新增numThreads个loop线程，新线程并行启动，需在baseLoop线程中调用
+    void addThreads(int numThreads);
+    // 运行时摘下最后numThreads个loop线程，之后getNextLoop不再返回它们
+    // 由调用方迁移其上的连接后再析构返回的线程对象，需在baseLoop线程中调用
+    std::vector<std::unique_ptr<EventLoopThread>> retireThreads(int numThreads);
+    int numThreads() const { return static_cast<int>(loops_.size()); }
     
     // 如果工作在多线程中，baseLoop_默认以轮询的方式分配channel给subloop
     EventLoop *getNextLoop();
@@ -34,6 +42,8 @@ private:
     bool started_;
     int numThreads_;
     int next_;
+    int nextThreadId_;              // 线程名的编号，扩缩容后也不重复
+    ThreadInitCallback callback_;   // 运行时新增的线程同样需要执行初始化回调
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
 };
\ No newline at end of file
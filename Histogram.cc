@@ -0,0 +1,76 @@
+#include "Histogram.h"
+
+#include <stdio.h>
+#include <string.h>
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+void Histogram::reset()
+{
+    memset(counts_, 0, sizeof counts_);
+    count_ = 0;
+    sum_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if (other.min_ < min_) min_ = other.min_;
+    if (other.max_ > max_) max_ = other.max_;
+}
+
+uint64_t Histogram::bucketUpperBound(int bucket)
+{
+    if (bucket < (2 << kSubBucketBits))
+    {
+        return static_cast<uint64_t>(bucket);
+    }
+    int shift = (bucket >> kSubBucketBits) - 1;
+    uint64_t top = static_cast<uint64_t>(bucket & ((1 << kSubBucketBits) - 1)) + (1 << kSubBucketBits);
+    return ((top + 1) << shift) - 1;
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count_) rank = count_;
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        seen += counts_[i];
+        if (seen >= rank)
+        {
+            uint64_t upper = bucketUpperBound(i);
+            return upper < max_ ? upper : max_;
+        }
+    }
+    return max_;
+}
+
+std::string Histogram::toJson() const
+{
+    char buf[512];
+    snprintf(buf, sizeof buf,
+             "{\"count\":%llu,\"min\":%llu,\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+             "\"p99.9\":%llu,\"p99.99\":%llu,\"max\":%llu}",
+             static_cast<unsigned long long>(count_), static_cast<unsigned long long>(min()), mean(),
+             static_cast<unsigned long long>(percentile(50)), static_cast<unsigned long long>(percentile(90)),
+             static_cast<unsigned long long>(percentile(99)), static_cast<unsigned long long>(percentile(99.9)),
+             static_cast<unsigned long long>(percentile(99.99)), static_cast<unsigned long long>(max_));
+    return buf;
+}
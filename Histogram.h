@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/*
+ * 对数-线性分桶的直方图(和HdrHistogram同样的思路)，记录延迟等非负整数
+ * 小于64的值每个值一个桶，之后每翻一倍分成32个桶，相对误差不超过1/32
+ * 桶数固定，记录一次只是算下标和自增，不分配内存，不加锁，每个线程(或每个loop)各用一个，最后merge
+ */
+class Histogram
+{
+public:
+    static const int kSubBucketBits = 5;
+    static const int kMaxValueBits = 40;    // 超过2^40(纳秒时约18分钟)的值记在最后一个桶
+    static const int kNumBuckets = (kMaxValueBits - kSubBucketBits + 1) << kSubBucketBits;
+
+    Histogram();
+
+    void record(uint64_t value)
+    {
+        ++counts_[bucketOf(value)];
+        ++count_;
+        sum_ += value;
+        if (value < min_) min_ = value;
+        if (value > max_) max_ = value;
+    }
+    void merge(const Histogram &other);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ > 0 ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ > 0 ? static_cast<double>(sum_) / count_ : 0; }
+    // p在[0, 100]之间，返回所在桶的上界(不超过max)
+    uint64_t percentile(double p) const;
+
+    // {"count":..,"min":..,"mean":..,"p50":..,"p90":..,"p99":..,"p99.9":..,"p99.99":..,"max":..}
+    std::string toJson() const;
+
+    static int bucketOf(uint64_t value)
+    {
+        if (value < (1ULL << (kSubBucketBits + 1)))
+        {
+            return static_cast<int>(value);
+        }
+        int msb = 63 - __builtin_clzll(value);
+        if (msb >= kMaxValueBits)
+        {
+            return kNumBuckets - 1;
+        }
+        int shift = msb - kSubBucketBits;
+        // value >> shift在[32, 64)之间
+        return ((shift + 1) << kSubBucketBits) + static_cast<int>(value >> shift) - (1 << kSubBucketBits);
+    }
+    // 桶中最大的值
+    static uint64_t bucketUpperBound(int bucket);
+
+private:
+    uint64_t counts_[kNumBuckets];
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
@@ -0,0 +1,278 @@
+#include "HttpParser.h"
+#include "Buffer.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+const size_t HttpParser::kMaxHeaderBytes;
+const size_t HttpParser::kMaxBodyBytes;
+
+HttpParser::HttpParser()
+{
+    reset();
+}
+
+void HttpParser::reset()
+{
+    request_.reset();
+    state_ = kExpectRequestLine;
+    lineStart_ = 0;
+    scanned_ = 0;
+    contentLength_ = 0;
+    requestBytes_ = 0;
+    errorStatus_ = 0;
+}
+
+HttpParser::Result HttpParser::fail(int status)
+{
+    errorStatus_ = status;
+    return kError;
+}
+
+HttpParser::Result HttpParser::parse(const Buffer *buf)
+{
+    const char *begin = buf->peek();
+    const size_t readable = buf->readableBytes();
+
+    // 逐行解析请求行和头部，行以\n结尾，行尾的\r被忽略
+    while (state_ == kExpectRequestLine || state_ == kExpectHeaders)
+    {
+        const char *eol = static_cast<const char*>(memchr(begin + scanned_, '\n', readable - scanned_));
+        if (eol == nullptr)
+        {
+            scanned_ = readable;
+            if (readable > kMaxHeaderBytes)
+            {
+                return fail(431);
+            }
+            return kNeedMore;
+        }
+
+        size_t lineEnd = eol - begin;
+        scanned_ = lineEnd + 1;
+        if (lineEnd > lineStart_ && begin[lineEnd - 1] == '\r')
+        {
+            --lineEnd;
+        }
+
+        if (state_ == kExpectRequestLine)
+        {
+            // 容忍请求之间多余的空行
+            if (lineEnd == lineStart_)
+            {
+                lineStart_ = scanned_;
+                continue;
+            }
+            if (!parseRequestLine(begin, lineStart_, lineEnd))
+            {
+                return fail(400);
+            }
+            state_ = kExpectHeaders;
+        }
+        else if (lineEnd == lineStart_)
+        {
+            // 空行，头部结束
+            if (!finishHeaders(begin))
+            {
+                return kError;
+            }
+        }
+        else if (!parseHeaderLine(begin, lineStart_, lineEnd))
+        {
+            return fail(400);
+        }
+        lineStart_ = scanned_;
+        if (scanned_ > kMaxHeaderBytes && state_ != kGotAll && state_ != kExpectBody)
+        {
+            return fail(431);
+        }
+    }
+
+    if (state_ == kExpectBody)
+    {
+        if (readable - scanned_ < contentLength_)
+        {
+            return kNeedMore;
+        }
+        request_.body_.offset = scanned_;
+        request_.body_.len = contentLength_;
+        state_ = kGotAll;
+    }
+
+    requestBytes_ = scanned_ + contentLength_;
+    request_.base_ = begin;
+    return kComplete;
+}
+
+// GET /path?query HTTP/1.1
+bool HttpParser::parseRequestLine(const char *begin, size_t lineStart, size_t lineEnd)
+{
+    const char *start = begin + lineStart;
+    const char *end = begin + lineEnd;
+    const char *space = static_cast<const char*>(memchr(start, ' ', end - start));
+    if (space == nullptr)
+    {
+        return false;
+    }
+
+    StringPiece method(start, space - start);
+    request_.methodSlice_.offset = lineStart;
+    request_.methodSlice_.len = method.size();
+    if (method == "GET")
+    {
+        request_.method_ = HttpRequest::kGet;
+    }
+    else if (method == "POST")
+    {
+        request_.method_ = HttpRequest::kPost;
+    }
+    else if (method == "HEAD")
+    {
+        request_.method_ = HttpRequest::kHead;
+    }
+    else if (method == "PUT")
+    {
+        request_.method_ = HttpRequest::kPut;
+    }
+    else if (method == "DELETE")
+    {
+        request_.method_ = HttpRequest::kDelete;
+    }
+    else if (method == "OPTIONS")
+    {
+        request_.method_ = HttpRequest::kOptions;
+    }
+    else if (method == "PATCH")
+    {
+        request_.method_ = HttpRequest::kPatch;
+    }
+    else
+    {
+        return false;
+    }
+
+    const char *targetStart = space + 1;
+    const char *targetEnd = static_cast<const char*>(memchr(targetStart, ' ', end - targetStart));
+    if (targetEnd == nullptr || targetEnd == targetStart)
+    {
+        return false;
+    }
+    request_.target_.offset = targetStart - begin;
+    request_.target_.len = targetEnd - targetStart;
+    const char *question = static_cast<const char*>(memchr(targetStart, '?', targetEnd - targetStart));
+    const char *pathEnd = question ? question : targetEnd;
+    request_.path_.offset = targetStart - begin;
+    request_.path_.len = pathEnd - targetStart;
+    if (question)
+    {
+        request_.query_.offset = question + 1 - begin;
+        request_.query_.len = targetEnd - question - 1;
+    }
+
+    StringPiece version(targetEnd + 1, end - targetEnd - 1);
+    if (version == "HTTP/1.1")
+    {
+        request_.version_ = HttpRequest::kHttp11;
+    }
+    else if (version == "HTTP/1.0")
+    {
+        request_.version_ = HttpRequest::kHttp10;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Name: value，名称和冒号之间不允许空白，值两端的空白被去掉
+bool HttpParser::parseHeaderLine(const char *begin, size_t lineStart, size_t lineEnd)
+{
+    const char *start = begin + lineStart;
+    const char *end = begin + lineEnd;
+    const char *colon = static_cast<const char*>(memchr(start, ':', end - start));
+    if (colon == nullptr || colon == start)
+    {
+        return false;
+    }
+
+    const char *valueStart = colon + 1;
+    while (valueStart < end && (*valueStart == ' ' || *valueStart == '\t'))
+    {
+        ++valueStart;
+    }
+    const char *valueEnd = end;
+    while (valueEnd > valueStart && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+    {
+        --valueEnd;
+    }
+
+    HttpRequest::Header header;
+    header.name.offset = lineStart;
+    header.name.len = colon - start;
+    header.value.offset = valueStart - begin;
+    header.value.len = valueEnd - valueStart;
+    request_.headers_.push_back(header);
+    return true;
+}
+
+// 头部收齐后确定请求体长度和是否保持连接
+bool HttpParser::finishHeaders(const char *begin)
+{
+    request_.base_ = begin;
+
+    StringPiece connection = request_.getHeader("Connection");
+    if (request_.version_ == HttpRequest::kHttp11)
+    {
+        request_.keepAlive_ = !connection.equalsIgnoreCase("close");
+    }
+    else
+    {
+        request_.keepAlive_ = connection.equalsIgnoreCase("keep-alive");
+    }
+
+    if (!request_.getHeader("Transfer-Encoding").empty())
+    {
+        errorStatus_ = 501;
+        return false;
+    }
+
+    // 多个Content-Length或者空值时无法确定请求体的边界，前后两级对边界理解不一致会导致请求走私
+    StringPiece length;
+    int lengthHeaders = 0;
+    for (size_t i = 0; i < request_.headerCount(); ++i)
+    {
+        if (request_.headerName(i).equalsIgnoreCase("Content-Length"))
+        {
+            length = request_.headerValue(i);
+            ++lengthHeaders;
+        }
+    }
+    if (lengthHeaders > 1 || (lengthHeaders == 1 && length.empty()))
+    {
+        errorStatus_ = 400;
+        return false;
+    }
+    if (!length.empty())
+    {
+        size_t value = 0;
+        for (size_t i = 0; i < length.size(); ++i)
+        {
+            if (length[i] < '0' || length[i] > '9' || value > kMaxBodyBytes)
+            {
+                errorStatus_ = (value > kMaxBodyBytes) ? 413 : 400;
+                return false;
+            }
+            value = value * 10 + (length[i] - '0');
+        }
+        if (value > kMaxBodyBytes)
+        {
+            errorStatus_ = 413;
+            return false;
+        }
+        contentLength_ = value;
+    }
+
+    state_ = contentLength_ > 0 ? kExpectBody : kGotAll;
+    return true;
+}
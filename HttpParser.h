@@ -0,0 +1,48 @@
+#pragma once
+
+#include "HttpRequest.h"
+
+class Buffer;
+
+/*
+ * 增量式HTTP/1.x请求解析器，每个连接一个
+ * 直接在连接的inputBuffer_上解析，只记录偏移不拷贝；数据不完整时返回kNeedMore，
+ * 已经扫描过的字节下次不再重复扫描(偏移相对buf->peek()，Buffer扩容搬移数据不影响)
+ * 请求体只支持Content-Length，chunked请求体返回501
+ */
+class HttpParser
+{
+public:
+    enum Result { kNeedMore, kComplete, kError };
+
+    HttpParser();
+
+    // 解析buf->peek()开始的一个请求，kComplete时request()指向buf中的数据，直到buf被retrieve
+    Result parse(const Buffer *buf);
+    const HttpRequest& request() const { return request_; }
+    // 整个请求(包括请求体)的字节数，处理完之后从buf中retrieve这么多字节
+    size_t requestBytes() const { return requestBytes_; }
+    // kError时应答的状态码
+    int errorStatus() const { return errorStatus_; }
+    // 准备解析下一个请求
+    void reset();
+
+    static const size_t kMaxHeaderBytes = 64 * 1024;
+    static const size_t kMaxBodyBytes = 64 * 1024 * 1024;
+
+private:
+    enum State { kExpectRequestLine, kExpectHeaders, kExpectBody, kGotAll };
+
+    bool parseRequestLine(const char *begin, size_t lineStart, size_t lineEnd);
+    bool parseHeaderLine(const char *begin, size_t lineStart, size_t lineEnd);
+    bool finishHeaders(const char *begin);
+    Result fail(int status);
+
+    HttpRequest request_;
+    State state_;
+    size_t lineStart_;      // 当前行的起始偏移
+    size_t scanned_;        // 已经扫描过的字节数，下次从这里继续找换行
+    size_t contentLength_;
+    size_t requestBytes_;
+    int errorStatus_;
+};
@@ -0,0 +1,34 @@
+#include "HttpRequest.h"
+
+HttpRequest::HttpRequest()
+    : base_(nullptr)
+{
+    reset();
+}
+
+void HttpRequest::reset()
+{
+    const Slice empty = {0, 0};
+    base_ = nullptr;
+    method_ = kInvalid;
+    version_ = kUnknown;
+    methodSlice_ = empty;
+    target_ = empty;
+    path_ = empty;
+    query_ = empty;
+    body_ = empty;
+    headers_.clear();
+    keepAlive_ = false;
+}
+
+StringPiece HttpRequest::getHeader(const StringPiece &name) const
+{
+    for (const Header &header : headers_)
+    {
+        if (piece(header.name).equalsIgnoreCase(name))
+        {
+            return piece(header.value);
+        }
+    }
+    return StringPiece();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "StringPiece.h"
+
+#include <vector>
+#include <stddef.h>
+
+class HttpParser;
+
+/*
+ * 解析完成的HTTP请求，本身不保存任何字符串，只记录各部分在连接的inputBuffer_中的偏移
+ * 所有StringPiece都指向inputBuffer_，只在HttpServer的回调期间有效，需要保留时调用toString()拷贝
+ */
+class HttpRequest
+{
+public:
+    enum Method { kInvalid, kGet, kPost, kHead, kPut, kDelete, kOptions, kPatch };
+    enum Version { kUnknown, kHttp10, kHttp11 };
+
+    HttpRequest();
+
+    Method method() const { return method_; }
+    Version version() const { return version_; }
+    StringPiece methodString() const { return piece(methodSlice_); }
+    // 请求行中的目标，例如/index.html?a=1
+    StringPiece target() const { return piece(target_); }
+    StringPiece path() const { return piece(path_); }
+    // 不含'?'，没有查询串时为空
+    StringPiece query() const { return piece(query_); }
+    StringPiece body() const { return piece(body_); }
+
+    // 按名称查找头部，忽略大小写，不存在时返回空
+    StringPiece getHeader(const StringPiece &name) const;
+    size_t headerCount() const { return headers_.size(); }
+    StringPiece headerName(size_t i) const { return piece(headers_[i].name); }
+    StringPiece headerValue(size_t i) const { return piece(headers_[i].value); }
+
+    // HTTP/1.1默认保持连接，HTTP/1.0需要Connection: keep-alive
+    bool keepAlive() const { return keepAlive_; }
+
+private:
+    friend class HttpParser;
+
+    // 相对请求起始位置的偏移
+    struct Slice
+    {
+        size_t offset;
+        size_t len;
+    };
+    struct Header
+    {
+        Slice name;
+        Slice value;
+    };
+
+    StringPiece piece(const Slice &slice) const { return StringPiece(base_ + slice.offset, slice.len); }
+    void reset();
+
+    const char *base_; // 请求在inputBuffer_中的起始地址，解析完成时才确定
+    Method method_;
+    Version version_;
+    Slice methodSlice_;
+    Slice target_;
+    Slice path_;
+    Slice query_;
+    Slice body_;
+    std::vector<Header> headers_; // clear时保留容量，稳定后不再分配内存
+    bool keepAlive_;
+};
@@ -0,0 +1,123 @@
+#include "HttpResponse.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace
+{
+const char* statusMessageOf(int code)
+{
+    switch (code)
+    {
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    default: return "Unknown";
+    }
+}
+
+// 每个线程缓存当前这一秒的Date头部，同一秒内的应答直接拷贝
+__thread time_t t_lastDateSecond = 0;
+__thread char t_dateHeader[64];
+__thread int t_dateHeaderLen = 0;
+
+void appendDateHeader(Buffer *output)
+{
+    time_t now = ::time(nullptr);
+    if (now != t_lastDateSecond)
+    {
+        struct tm tm_time;
+        ::gmtime_r(&now, &tm_time);
+        t_dateHeaderLen = static_cast<int>(strftime(t_dateHeader, sizeof t_dateHeader,
+                                                    "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm_time));
+        t_lastDateSecond = now;
+    }
+    output->append(t_dateHeader, t_dateHeaderLen);
+}
+} // namespace
+
+HttpResponse::HttpResponse(bool close)
+    : statusCode_(kUnknown)
+    , closeConnection_(close)
+    , headOnly_(false)
+    , headerCount_(0)
+{
+}
+
+void HttpResponse::reset(bool close, bool headOnly)
+{
+    statusCode_ = kUnknown;
+    statusMessage_.clear();
+    closeConnection_ = close;
+    headOnly_ = headOnly;
+    headerCount_ = 0;
+    body_.clear();
+}
+
+void HttpResponse::addHeader(const std::string &key, const std::string &value)
+{
+    if (headerCount_ < headers_.size())
+    {
+        headers_[headerCount_].first.assign(key);
+        headers_[headerCount_].second.assign(value);
+    }
+    else
+    {
+        headers_.push_back(std::make_pair(key, value));
+    }
+    ++headerCount_;
+}
+
+void HttpResponse::appendToBuffer(Buffer *output) const
+{
+    char buf[64];
+    int code = statusCode_ == kUnknown ? 200 : statusCode_;
+    int len = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", code);
+    output->append(buf, len);
+    if (statusMessage_.empty())
+    {
+        const char *message = statusMessageOf(code);
+        output->append(message, strlen(message));
+    }
+    else
+    {
+        output->append(statusMessage_.data(), statusMessage_.size());
+    }
+    output->append("\r\n", 2);
+
+    if (closeConnection_)
+    {
+        output->append("Connection: close\r\n", 19);
+    }
+    appendDateHeader(output);
+    // 1xx和204应答不能带Content-Length
+    if (code >= 200 && code != 204)
+    {
+        len = snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+        output->append(buf, len);
+    }
+
+    for (size_t i = 0; i < headerCount_; ++i)
+    {
+        const std::pair<std::string, std::string> &header = headers_[i];
+        output->append(header.first.data(), header.first.size());
+        output->append(": ", 2);
+        output->append(header.second.data(), header.second.size());
+        output->append("\r\n", 2);
+    }
+    output->append("\r\n", 2);
+
+    if (!headOnly_)
+    {
+        output->append(body_.data(), body_.size());
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "StringPiece.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Buffer;
+
+/*
+ * HTTP应答，由HttpServer在每个请求之前reset后交给回调填写，回调返回后直接序列化到连接的发送缓冲区
+ * 同一个连接上的应答对象被重复使用，头部和正文的容量保留下来，稳定后不再分配内存
+ */
+class HttpResponse
+{
+public:
+    enum HttpStatusCode
+    {
+        kUnknown,
+        k101SwitchingProtocols = 101,
+        k200Ok = 200,
+        k204NoContent = 204,
+        k301MovedPermanently = 301,
+        k400BadRequest = 400,
+        k404NotFound = 404,
+        k413PayloadTooLarge = 413,
+        k431HeaderFieldsTooLarge = 431,
+        k500InternalServerError = 500,
+        k501NotImplemented = 501,
+    };
+
+    explicit HttpResponse(bool close);
+    // 准备下一个应答，close表示应答之后关闭连接，headOnly表示HEAD请求只发送头部
+    void reset(bool close, bool headOnly = false);
+
+    void setStatusCode(HttpStatusCode code) { statusCode_ = code; }
+    // 不设置时使用状态码对应的标准描述
+    void setStatusMessage(const std::string &message) { statusMessage_ = message; }
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    void setContentType(const std::string &contentType) { addHeader("Content-Type", contentType); }
+    void addHeader(const std::string &key, const std::string &value);
+    void setBody(const std::string &body) { body_ = body; }
+    void setBody(const char *data, size_t len) { body_.assign(data, len); }
+    void appendBody(const char *data, size_t len) { body_.append(data, len); }
+
+    // 状态行、头部(自动加上Date和Content-Length，1xx和204除外)和正文依次追加到output中
+    void appendToBuffer(Buffer *output) const;
+
+private:
+    HttpStatusCode statusCode_;
+    std::string statusMessage_;
+    bool closeConnection_;
+    bool headOnly_;
+    std::vector<std::pair<std::string, std::string>> headers_;
+    size_t headerCount_; // headers_中前headerCount_个有效，其余留作复用
+    std::string body_;
+};
@@ -0,0 +1,132 @@
+#include "HttpServer.h"
+#include "HttpParser.h"
+#include "Logger.h"
+
+namespace
+{
+// 每个连接的HTTP状态，挂在TcpConnection的context上
+struct HttpSession
+{
+    HttpSession()
+        : response(false)
+        , closing(false)
+    {}
+
+    HttpParser parser;
+    HttpResponse response;
+    Buffer output;  // 本次读到的所有请求的应答，处理完一起发送
+    bool closing;   // 已经发出了Connection: close的应答，之后收到的数据直接丢弃
+};
+
+void defaultHttpCallback(const HttpRequest &, HttpResponse *resp)
+{
+    resp->setStatusCode(HttpResponse::k404NotFound);
+}
+} // namespace
+
+HttpServer::HttpServer(EventLoop *loop,
+                       const InetAddress &listenAddr,
+                       const std::string &name,
+                       TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , httpCallback_(defaultHttpCallback)
+{
+    server_.setConnectionCallback(std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&HttpServer::onMessage, this, std::placeholders::_1,
+                                         std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer[%s] starts listening", server_.name().c_str());
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<HttpSession>());
+    }
+}
+
+/*
+ * 循环解析buf中完整的请求，请求数据留在buf中直到应答序列化完成，然后再retrieve
+ * 不完整的请求留在buf中，解析器记住已经扫描的位置，下次数据到来时继续
+ */
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    HttpSession *session = static_cast<HttpSession*>(conn->getContext().get());
+    if (session->closing)
+    {
+        buf->retrieveAll();
+        return;
+    }
+
+    HttpParser &parser = session->parser;
+    HttpResponse &response = session->response;
+    while (buf->readableBytes() > 0)
+    {
+        HttpParser::Result result = parser.parse(buf);
+        if (result == HttpParser::kNeedMore)
+        {
+            break;
+        }
+        if (result == HttpParser::kError)
+        {
+            response.reset(true);
+            response.setStatusCode(static_cast<HttpResponse::HttpStatusCode>(parser.errorStatus()));
+            response.appendToBuffer(&session->output);
+            buf->retrieveAll();
+            session->closing = true;
+            break;
+        }
+
+        const HttpRequest &request = parser.request();
+        if (upgradeCallback_ && !request.getHeader("Upgrade").empty())
+        {
+            response.reset(false);
+            MessageCallback upgraded = upgradeCallback_(conn, request, &response);
+            if (upgraded)
+            {
+                // 先发出升级应答，之后的数据(可能已经跟在请求后面)交给新的协议处理
+                response.appendToBuffer(&session->output);
+                buf->retrieve(parser.requestBytes());
+                parser.reset();
+                conn->send(&session->output);
+                conn->setMessageCallback(upgraded);
+                if (buf->readableBytes() > 0)
+                {
+                    upgraded(conn, buf, receiveTime);
+                }
+                return;
+            }
+        }
+
+        response.reset(!request.keepAlive(), request.method() == HttpRequest::kHead);
+        httpCallback_(request, &response);
+        if (!response.closeConnection() && request.version() == HttpRequest::kHttp10)
+        {
+            response.addHeader("Connection", "Keep-Alive");
+        }
+        response.appendToBuffer(&session->output);
+
+        buf->retrieve(parser.requestBytes());
+        parser.reset();
+        if (response.closeConnection())
+        {
+            buf->retrieveAll();
+            session->closing = true;
+            break;
+        }
+    }
+
+    if (session->output.readableBytes() > 0)
+    {
+        conn->send(&session->output);
+    }
+    if (session->closing)
+    {
+        conn->shutdown(); // 发送缓冲区中的应答发完之后才关闭写端
+    }
+}
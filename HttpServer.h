@@ -0,0 +1,53 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+#include <functional>
+#include <string>
+
+/*
+ * 基于TcpServer的HTTP/1.1服务器
+ * 支持持久连接和管线化：一次读到的多个请求依次解析、依次回调，应答按请求顺序序列化到同一个缓冲区，最后一次发出
+ * 回调在连接所在的loop线程中同步执行，需要耗时计算时应提交到TcpServer的计算线程池并自行组织应答
+ *
+ * HttpServer server(&loop, InetAddress(8000), "http");
+ * server.setHttpCallback([](const HttpRequest &req, HttpResponse *resp) {
+ *     resp->setContentType("text/plain");
+ *     resp->setBody("Hello, World!");
+ * });
+ * server.start();
+ */
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void(const HttpRequest&, HttpResponse*)>;
+    // 收到带Upgrade头部的请求时调用，同意升级时填写应答(通常是101)并返回之后接管连接的MessageCallback，
+    // 返回空的MessageCallback表示不升级，请求按普通HTTP请求交给HttpCallback
+    using UpgradeCallback = std::function<MessageCallback(const TcpConnectionPtr&,
+                                                          const HttpRequest&,
+                                                          HttpResponse*)>;
+
+    HttpServer(EventLoop *loop,
+               const InetAddress &listenAddr,
+               const std::string &name,
+               TcpServer::Option option = TcpServer::kNoReusePort);
+
+    // 默认的回调对所有请求应答404
+    void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+    void setUpgradeCallback(const UpgradeCallback &cb) { upgradeCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    TcpServer *tcpServer() { return &server_; }
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    TcpServer server_;
+    HttpCallback httpCallback_;
+    UpgradeCallback upgradeCallback_;
+};
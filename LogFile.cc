@@ -0,0 +1,175 @@
+#include "LogFile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// 带64KB用户态缓冲区的追加写文件，后台线程独占使用，因此用无锁版本的fwrite
+class LogFile::AppendFile : noncopyable
+{
+public:
+    explicit AppendFile(const std::string &filename)
+        : fp_(::fopen(filename.c_str(), "ae")) // 'e' 即 O_CLOEXEC
+        , writtenBytes_(0)
+    {
+        if (fp_)
+        {
+            ::setbuffer(fp_, buffer_, sizeof buffer_);
+        }
+        else
+        {
+            // 打开日志文件失败时不能再写日志，直接输出到stderr
+            fprintf(stderr, "LogFile::AppendFile open %s failed: %s\n", filename.c_str(), strerror(errno));
+        }
+    }
+
+    ~AppendFile()
+    {
+        if (fp_)
+        {
+            ::fclose(fp_);
+        }
+    }
+
+    void append(const char *logline, size_t len)
+    {
+        if (!fp_)
+        {
+            return;
+        }
+        size_t written = 0;
+        while (written != len)
+        {
+            size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+            if (n == 0)
+            {
+                int err = ferror(fp_);
+                if (err)
+                {
+                    fprintf(stderr, "LogFile::AppendFile::append() failed: %s\n", strerror(err));
+                }
+                break;
+            }
+            written += n;
+        }
+        writtenBytes_ += written;
+    }
+
+    void flush()
+    {
+        if (fp_)
+        {
+            ::fflush(fp_);
+        }
+    }
+
+    off_t writtenBytes() const { return writtenBytes_; }
+
+private:
+    FILE *fp_;
+    char buffer_[64 * 1024];
+    off_t writtenBytes_;
+};
+
+LogFile::LogFile(const std::string &basename,
+                 off_t rollSize,
+                 int flushInterval,
+                 int rollInterval,
+                 int checkEveryN)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , rollInterval_(rollInterval)
+    , checkEveryN_(checkEveryN)
+    , count_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+    , lastFlush_(0)
+{
+    rollFile();
+}
+
+LogFile::~LogFile() = default;
+
+void LogFile::append(const char *logline, int len)
+{
+    file_->append(logline, len);
+
+    if (file_->writtenBytes() > rollSize_)
+    {
+        rollFile();
+        return;
+    }
+
+    // 每写入checkEveryN次才检查一次时间，是否需要按周期滚动或者刷盘
+    if (++count_ >= checkEveryN_)
+    {
+        count_ = 0;
+        time_t now = ::time(NULL);
+        time_t thisPeriod = now / rollInterval_ * rollInterval_;
+        if (thisPeriod != startOfPeriod_)
+        {
+            rollFile();
+        }
+        else if (now - lastFlush_ > flushInterval_)
+        {
+            lastFlush_ = now;
+            file_->flush();
+        }
+    }
+}
+
+void LogFile::flush()
+{
+    file_->flush();
+}
+
+// 切换到新的日志文件，同一秒内重复调用不会切换
+bool LogFile::rollFile()
+{
+    time_t now = 0;
+    std::string filename = getLogFileName(basename_, &now);
+    time_t start = now / rollInterval_ * rollInterval_;
+
+    if (now > lastRoll_)
+    {
+        lastRoll_ = now;
+        lastFlush_ = now;
+        startOfPeriod_ = start;
+        file_.reset(new AppendFile(filename));
+        return true;
+    }
+    return false;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t *now)
+{
+    std::string filename;
+    filename.reserve(basename.size() + 64);
+    filename = basename;
+
+    char timebuf[32];
+    struct tm tm;
+    *now = ::time(NULL);
+    localtime_r(now, &tm);
+    strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256];
+    if (::gethostname(hostname, sizeof hostname) == 0)
+    {
+        hostname[sizeof hostname - 1] = '\0';
+        filename += hostname;
+    }
+    else
+    {
+        filename += "unknownhost";
+    }
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof pidbuf, ".%d", ::getpid());
+    filename += pidbuf;
+
+    filename += ".log";
+    return filename;
+}
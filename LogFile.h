@@ -0,0 +1,46 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <string>
+#include <memory>
+#include <time.h>
+#include <sys/types.h>
+
+/*
+ * 滚动日志文件，文件名为 basename.20261019-024905.hostname.pid.log
+ * 写入量超过rollSize，或者跨过一个rollInterval周期(默认一天)时，切换到新文件
+ * 不是线程安全的，只由AsyncLogging的后台线程使用
+ */
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string &basename,
+            off_t rollSize,
+            int flushInterval = 3,
+            int rollInterval = 60 * 60 * 24,
+            int checkEveryN = 1024);
+    ~LogFile();
+
+    void append(const char *logline, int len);
+    void flush();
+    // 切换到新的日志文件，同一秒内重复调用不会切换
+    bool rollFile();
+
+private:
+    class AppendFile;
+
+    static std::string getLogFileName(const std::string &basename, time_t *now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const int rollInterval_;
+    const int checkEveryN_;
+
+    int count_;             // 距离上次检查时间过去的写入次数
+    time_t startOfPeriod_;  // 当前文件所属周期的起始时间
+    time_t lastRoll_;
+    time_t lastFlush_;
+    std::unique_ptr<AppendFile> file_;
+};
@@ -1,42 +1,78 @@
 #include "Logger.h"
 #include "Timestamp.h"
 
-#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
 
-// 获取日志唯一的实例对象
-Logger &Logger::instance()
+// 默认的日志输出：stdout，每条日志都刷新，stdout是管道或文件时日志也不会滞留在缓冲区中或在进程异常退出时丢失
+// 日志量大时应通过setOutput改用AsyncLogging
+static void defaultOutput(const char *msg, int len)
 {
-    static Logger logger;
-    return logger;
+    ::fwrite(msg, 1, len, stdout);
+    ::fflush(stdout);
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int Level)
+static void defaultFlush()
 {
-    logLevel_ = Level;
+    ::fflush(stdout);
 }
 
-// 写日志  [级别信息] time : msg
-void Logger::log(std::string msg)
+static const char *levelName(int level)
 {
-    switch (logLevel_)
+    switch (level)
     {
     case INFO:
-        std::cout << "[INFO]";
-        break;
+        return "[INFO]";
     case ERROR:
-        std::cout << "[ERROR]";
-        break;
+        return "[ERROR]";
     case FATAL:
-        std::cout << "[FATAL]";
-        break;
+        return "[FATAL]";
     case DEBUG:
-        std::cout << "[DEBUG]";
-        break;
+        return "[DEBUG]";
     default:
-        break;
+        return "";
+    }
+}
+
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+{
+}
+
+std::atomic<int> g_logLevel(INFO);
+
+// 获取日志唯一的实例对象
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+// 写日志  [级别信息] time : msg
+// 整条日志先在栈上拼好，再一次性交给output_，多个线程的日志不会交错
+void Logger::log(int level, const char *msg, int msgLen)
+{
+    char line[1280];
+    int n = snprintf(line, sizeof line, "%s", levelName(level));
+    n += Timestamp::now().formatTo(line + n, static_cast<int>(sizeof line) - n);
+    n += snprintf(line + n, sizeof line - n, " : ");
+
+    // 去掉消息末尾的换行，每条日志统一以一个换行结尾
+    size_t len = msgLen > 0 ? static_cast<size_t>(msgLen) : 0;
+    while (len > 0 && msg[len - 1] == '\n')
+    {
+        --len;
     }
+    len = std::min(len, sizeof line - n - 1);
+    memcpy(line + n, msg, len);
+    n += static_cast<int>(len);
+    line[n++] = '\n';
 
-    // 打印时间和msg
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    output_(line, n);
+    if (level == FATAL)
+    {
+        flush_();
+    }
+}
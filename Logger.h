@@ -1,80 +1,169 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "noncopyable.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...)                             \
-    do                                                          \
-    {                                                           \
-        Logger &logger = Logger::instance();                    \
-        logger.setLogLevel(INFO);                               \
-        char buf[1024] = {0};                                   \
-        /*使用编译器提供的宏：获取可变参的宏*/ \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__);       \
-        logger.log(buf);                                        \
+/*
+ * 编译期的最低日志级别，低于该级别的日志宏展开为空语句，参数也不会被求值
+ * 0:DEBUG 1:INFO 2:ERROR，FATAL总是保留；定义了MUDEBUG时默认保留DEBUG日志
+ */
+#ifndef MUDUO_MIN_LOG_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_MIN_LOG_LEVEL 0
+#else
+#define MUDUO_MIN_LOG_LEVEL 1
+#endif
+#endif
+
+// snprintf返回的是未截断时的长度，超出缓冲区时按截断后的长度计算
+#define LOG_CLAMP_LEN(loglen, logbuf) ((loglen) < static_cast<int>(sizeof(logbuf)) ? (loglen) : static_cast<int>(sizeof(logbuf)) - 1)
+
+// 先检查运行期的日志级别阈值，通过之后才格式化日志，关闭时只有一次分支判断
+#define LOG_BASE(level, logmsgFormat, ...)                                             \
+    do                                                                                 \
+    {                                                                                  \
+        if (Logger::logLevel() <= (level))                                             \
+        {                                                                              \
+            char logbuf[1024];                                                         \
+            /*使用编译器提供的宏：获取可变参的宏*/                                     \
+            int loglen = snprintf(logbuf, sizeof logbuf, logmsgFormat, ##__VA_ARGS__); \
+            Logger::instance().log(level, logbuf, LOG_CLAMP_LEN(loglen, logbuf));      \
+        }                                                                              \
     } while (0)
 
-// LOG_ERROR("%s %d", arg1, arg2)
-#define LOG_ERROR(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(ERROR);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// 采样：每个调用点在每个线程中每n次只输出第1次
+#define LOG_EVERY_N_BASE(level, n, logmsgFormat, ...)                           \
+    do                                                                          \
+    {                                                                           \
+        if (Logger::logLevel() <= (level))                                      \
+        {                                                                       \
+            static __thread unsigned logOccurrences = 0;                        \
+            if (logOccurrences++ % (n) == 0)                                    \
+            {                                                                   \
+                LOG_BASE(level, logmsgFormat, ##__VA_ARGS__);                   \
+            }                                                                   \
+        }                                                                       \
     } while (0)
 
-// LOG_FATAL("%s %d", arg1, arg2)
-#define LOG_FATAL(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(FATAL);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
+// 限流：每个调用点在每个线程中每seconds秒最多输出一条，并附带期间被抑制的条数
+#define LOG_RATELIMIT_BASE(level, seconds, logmsgFormat, ...)                                       \
+    do                                                                                              \
+    {                                                                                               \
+        if (Logger::logLevel() <= (level))                                                          \
+        {                                                                                           \
+            static __thread time_t logLastTime = 0;                                                 \
+            static __thread unsigned logSuppressed = 0;                                             \
+            time_t logNow = ::time(NULL);                                                           \
+            if (logNow - logLastTime >= (seconds))                                                  \
+            {                                                                                       \
+                char logbuf[1024];                                                                  \
+                int loglen = snprintf(logbuf, sizeof logbuf, logmsgFormat, ##__VA_ARGS__);          \
+                if (logSuppressed > 0 && loglen >= 0 && loglen < static_cast<int>(sizeof logbuf))   \
+                {                                                                                   \
+                    loglen += snprintf(logbuf + loglen, sizeof logbuf - loglen, " (%u suppressed)", \
+                                       logSuppressed);                                              \
+                }                                                                                   \
+                Logger::instance().log(level, logbuf, LOG_CLAMP_LEN(loglen, logbuf));               \
+                logLastTime = logNow;                                                               \
+                logSuppressed = 0;                                                                  \
+            }                                                                                       \
+            else                                                                                    \
+            {                                                                                       \
+                ++logSuppressed;                                                                    \
+            }                                                                                       \
+        }                                                                                           \
     } while (0)
 
-#ifdef MUDEBUG
+#if MUDUO_MIN_LOG_LEVEL <= 0
 // LOG_DEBUG("%s %d", arg1, arg2)
-#define LOG_DEBUG(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::instance();              \
-        logger.setlogLevel(DEBUG);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-    } while (0)
+#define LOG_DEBUG(logmsgFormat, ...) LOG_BASE(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define LOG_DEBUG_EVERY_N(n, logmsgFormat, ...) LOG_EVERY_N_BASE(DEBUG, n, logmsgFormat, ##__VA_ARGS__)
+#define LOG_DEBUG_RATELIMIT(seconds, logmsgFormat, ...) LOG_RATELIMIT_BASE(DEBUG, seconds, logmsgFormat, ##__VA_ARGS__)
 #else
-#define LOG_DEBUG(logmsgFormat, ...)
+#define LOG_DEBUG(logmsgFormat, ...) do {} while (0)
+#define LOG_DEBUG_EVERY_N(n, logmsgFormat, ...) do {} while (0)
+#define LOG_DEBUG_RATELIMIT(seconds, logmsgFormat, ...) do {} while (0)
 #endif
 
-    // 定义日志的级别 INFO ERROR FATAL DEBUG
-    enum LogLevel
-    {
-        INFO,  // 普通信息
-        ERROR, // 错误信息
-        FATAL, // core信息
-        DEBUG, // 调试信息
-    };
+#if MUDUO_MIN_LOG_LEVEL <= 1
+// LOG_INFO("%s %d", arg1, arg2)
+#define LOG_INFO(logmsgFormat, ...) LOG_BASE(INFO, logmsgFormat, ##__VA_ARGS__)
+#define LOG_INFO_EVERY_N(n, logmsgFormat, ...) LOG_EVERY_N_BASE(INFO, n, logmsgFormat, ##__VA_ARGS__)
+#define LOG_INFO_RATELIMIT(seconds, logmsgFormat, ...) LOG_RATELIMIT_BASE(INFO, seconds, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logmsgFormat, ...) do {} while (0)
+#define LOG_INFO_EVERY_N(n, logmsgFormat, ...) do {} while (0)
+#define LOG_INFO_RATELIMIT(seconds, logmsgFormat, ...) do {} while (0)
+#endif
+
+#if MUDUO_MIN_LOG_LEVEL <= 2
+// LOG_ERROR("%s %d", arg1, arg2)
+#define LOG_ERROR(logmsgFormat, ...) LOG_BASE(ERROR, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR_EVERY_N(n, logmsgFormat, ...) LOG_EVERY_N_BASE(ERROR, n, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR_RATELIMIT(seconds, logmsgFormat, ...) LOG_RATELIMIT_BASE(ERROR, seconds, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(logmsgFormat, ...) do {} while (0)
+#define LOG_ERROR_EVERY_N(n, logmsgFormat, ...) do {} while (0)
+#define LOG_ERROR_RATELIMIT(seconds, logmsgFormat, ...) do {} while (0)
+#endif
+
+// LOG_FATAL("%s %d", arg1, arg2)   不受日志级别的限制，输出之后退出进程
+#define LOG_FATAL(logmsgFormat, ...)                                               \
+    do                                                                             \
+    {                                                                              \
+        char logbuf[1024];                                                         \
+        int loglen = snprintf(logbuf, sizeof logbuf, logmsgFormat, ##__VA_ARGS__); \
+        Logger::instance().log(FATAL, logbuf, LOG_CLAMP_LEN(loglen, logbuf));      \
+        exit(-1);                                                                  \
+    } while (0)
+
+// 定义日志的级别 DEBUG INFO ERROR FATAL，数值越大越严重
+enum LogLevel
+{
+    DEBUG, // 调试信息
+    INFO,  // 普通信息
+    ERROR, // 错误信息
+    FATAL, // core信息
+};
+
+// 运行期的日志级别阈值，低于该级别的日志在格式化之前就被丢弃
+extern std::atomic<int> g_logLevel;
 
 // 输出一个日志类
 class Logger : noncopyable
 {
 public:
+    // 日志的输出目的地，参数为一条完整的日志(含换行)及其长度
+    using OutputFunc = std::function<void(const char *msg, int len)>;
+    using FlushFunc = std::function<void()>;
+
     // 获取日志唯一的实例对象
     static Logger &instance();
-    // 设置日志级别
-    void setLogLevel(int Level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行期的日志级别阈值，默认为INFO，可在任意线程随时修改
+    static int logLevel() { return g_logLevel.load(std::memory_order_relaxed); }
+    static void setLogLevel(int level) { g_logLevel.store(level, std::memory_order_relaxed); }
+
+    // 写日志，级别作为参数传入，多个线程同时写日志时互不干扰
+    // len为snprintf的返回值，超过缓冲区时按截断处理
+    void log(int level, const char *msg, int len);
+    void log(int level, const std::string &msg) { log(level, msg.data(), static_cast<int>(msg.size())); }
+
+    // 设置日志的输出目的地，默认输出到stdout并逐条刷新，需在各线程开始写日志之前设置
+    // 异步写文件：setOutput(std::bind(&AsyncLogging::append, &asyncLog, _1, _2))
+    void setOutput(OutputFunc out) { output_ = std::move(out); }
+    // FATAL日志在退出进程前会调用flush
+    void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
 
 private:
-    int logLevel_;
-    Logger(){};
-};
\ No newline at end of file
+    Logger();
+
+    OutputFunc output_;
+    FlushFunc flush_;
+};
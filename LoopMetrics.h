@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ConnectionStats.h"
+#include "PerfCounters.h"
+
+#include <stdint.h>
+
+/*
+ * 一个loop的运行计数，由EventLoop持有，只在loop线程中用普通的整数自增，不加锁也不用原子操作
+ * 其他线程需要时通过runInLoop到loop线程中拷贝一份(见TcpServer::collectMetrics)
+ */
+struct LoopMetrics
+{
+    uint64_t events = 0;            // poll返回的活跃channel数之和
+    uint64_t pollTimeouts = 0;      // poll超时、没有任何事件返回的次数
+    uint64_t functors = 0;          // 执行过的queueInLoop回调数
+    uint64_t maxFunctorBatch = 0;   // 一轮中执行的回调数的最大值
+    uint64_t wakeupReads = 0;       // 被wakeupFd_唤醒的次数
+    uint64_t wakeups = 0;           // 其他线程调用wakeup()的次数，多次写eventfd会被合并成一次唤醒
+    uint64_t slowCallbacks = 0;     // 超过LoopWatchdog回调预算的回调数
+    IoCounters io;                  // 这个loop上所有TcpConnection的收发字节数和系统调用次数
+    int64_t outputBacklog = 0;      // 这个loop上所有TcpConnection的outputBuffer_中待发送的字节数
+    PerfValues perf;                // loop线程的性能计数器，开启PerfCounters时每轮循环结束时更新
+};
@@ -0,0 +1,278 @@
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Thread.h"
+#include "Timestamp.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+const int kMaxFrames = 64;
+const int kStackWaitMs = 100;
+const int kStackSignal = SIGURG; // 默认动作是忽略，处理函数没装上时误发也没有影响
+
+// 每个loop在后台线程中的检查状态
+struct WatchedLoop
+{
+    EventLoop *loop;
+    bool reported;          // 当前这一轮已经报告过
+    uint64_t iteration;     // 报告时的轮次
+    int64_t stalledNanos;   // 最近一次检查时这一轮已经执行的时间
+};
+
+std::mutex g_mutex;                // 保护g_loops和后台线程的启停
+std::vector<WatchedLoop> g_loops;
+std::unique_ptr<Thread> g_thread;
+std::condition_variable g_cond;
+bool g_running = false;
+int g_stallMs = 1000;
+bool g_captureStack = true;
+std::atomic<uint64_t> g_stalls(0);
+
+// 进程退出时停止后台线程，定义在其他全局变量之后，先于它们析构
+struct StopAtExit
+{
+    ~StopAtExit() { LoopWatchdog::stop(); }
+} g_stopAtExit;
+
+// 每次抓取调用栈都有一个序号，随信号一起发给目标线程(si_value)
+// 信号处理函数只有认领了当前等待中的序号才写g_frames，之前超时的请求迟到的信号不会覆盖结果
+void *g_frames[kMaxFrames];
+int g_frameCount = 0;
+std::atomic<uint64_t> g_pendingSeq(0);  // 等待中的请求，信号处理函数认领后清零
+std::atomic<uint64_t> g_doneSeq(0);     // g_frames中是哪个请求的结果
+uint64_t g_nextSeq = 0;                 // 只在后台线程中访问
+
+void stackHandler(int, siginfo_t *info, void *)
+{
+    int savedErrno = errno;
+    uint64_t seq = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(info->si_value.sival_ptr));
+    uint64_t expected = seq;
+    if (info->si_code == SI_QUEUE && seq != 0 && g_pendingSeq.compare_exchange_strong(expected, 0))
+    {
+        g_frameCount = ::backtrace(g_frames, kMaxFrames);
+        g_doneSeq.store(seq, std::memory_order_release);
+    }
+    errno = savedErrno;
+}
+
+// 让目标线程在信号处理函数中记录自己的调用栈，然后在当前线程中符号化并打印
+void dumpStack(pid_t tid)
+{
+    uint64_t seq = ++g_nextSeq;
+    g_pendingSeq.store(seq, std::memory_order_seq_cst);
+
+    siginfo_t info;
+    memset(&info, 0, sizeof info);
+    info.si_signo = kStackSignal;
+    info.si_code = SI_QUEUE;
+    info.si_pid = ::getpid();
+    info.si_uid = ::getuid();
+    info.si_value.sival_ptr = reinterpret_cast<void*>(static_cast<uintptr_t>(seq));
+    if (::syscall(SYS_rt_tgsigqueueinfo, ::getpid(), tid, kStackSignal, &info) < 0)
+    {
+        g_pendingSeq.store(0, std::memory_order_relaxed);
+        LOG_ERROR("LoopWatchdog rt_tgsigqueueinfo %d failed: %d", tid, errno);
+        return;
+    }
+    bool done = false;
+    for (int waited = 0; waited < kStackWaitMs; ++waited)
+    {
+        if (g_doneSeq.load(std::memory_order_acquire) == seq)
+        {
+            done = true;
+            break;
+        }
+        ::usleep(1000);
+    }
+    if (!done)
+    {
+        // 撤销请求，信号之后才送达时处理函数认领失败，不再写g_frames
+        g_pendingSeq.store(0, std::memory_order_seq_cst);
+        LOG_ERROR("LoopWatchdog: thread %d did not report its stack within %d ms", tid, kStackWaitMs);
+        return;
+    }
+
+    int count = g_frameCount;
+    LOG_ERROR("LoopWatchdog: stack of thread %d", tid);
+    char **symbols = ::backtrace_symbols(g_frames, count);
+    // 前两帧是信号处理函数和内核的信号跳板
+    for (int i = 2; i < count; ++i)
+    {
+        if (symbols)
+        {
+            LOG_ERROR("    #%d %s", i - 2, symbols[i]);
+        }
+        else
+        {
+            LOG_ERROR("    #%d %p", i - 2, g_frames[i]);
+        }
+    }
+    ::free(symbols);
+}
+
+// 调用时持有g_mutex，新发现卡住时返回true
+bool check(WatchedLoop &w, int64_t now, int64_t stallNanos)
+{
+    EventLoop::Heartbeat hb = w.loop->heartbeat();
+    if (w.reported && (hb.iterations != w.iteration || hb.iterationStartNanos == 0))
+    {
+        LOG_INFO("LoopWatchdog: EventLoop %p resumed after at least %lld ms",
+                 w.loop, static_cast<long long>(w.stalledNanos / 1000000));
+        w.reported = false;
+    }
+    if (hb.iterationStartNanos == 0 || now - hb.iterationStartNanos < stallNanos)
+    {
+        return false;
+    }
+    w.stalledNanos = now - hb.iterationStartNanos;
+    if (w.reported)
+    {
+        return false; // 同一轮只报告一次
+    }
+    w.reported = true;
+    w.iteration = hb.iterations;
+    ++g_stalls;
+
+    long long callbackMs = hb.callbackStartNanos ? (now - hb.callbackStartNanos) / 1000000 : -1;
+    if (hb.callbackStartNanos && hb.callbackFd >= 0)
+    {
+        LOG_ERROR("LoopWatchdog: EventLoop %p (tid %d) stalled, iteration %llu running for %lld ms, "
+                  "handleEvent fd=%d for %lld ms",
+                  w.loop, w.loop->threadId(), static_cast<unsigned long long>(hb.iterations),
+                  static_cast<long long>(w.stalledNanos / 1000000), hb.callbackFd, callbackMs);
+    }
+    else
+    {
+        LOG_ERROR("LoopWatchdog: EventLoop %p (tid %d) stalled, iteration %llu running for %lld ms, "
+                  "%s for %lld ms",
+                  w.loop, w.loop->threadId(), static_cast<unsigned long long>(hb.iterations),
+                  static_cast<long long>(w.stalledNanos / 1000000),
+                  hb.callbackStartNanos ? "pending functor" : "between callbacks", callbackMs);
+    }
+    return true;
+}
+
+void watchdogThread()
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (g_running)
+    {
+        int intervalMs = std::max(10, g_stallMs / 4);
+        g_cond.wait_for(lock, std::chrono::milliseconds(intervalMs));
+        if (!g_running)
+        {
+            break;
+        }
+        int64_t now = Timestamp::monotonicNanos();
+        int64_t stallNanos = static_cast<int64_t>(g_stallMs) * 1000000;
+        std::vector<pid_t> stalled;
+        for (WatchedLoop &w : g_loops)
+        {
+            if (check(w, now, stallNanos) && g_captureStack)
+            {
+                stalled.push_back(w.loop->threadId());
+            }
+        }
+        // 抓取调用栈最多等待kStackWaitMs，期间不持有g_mutex，不阻塞loop的注册和注销
+        if (!stalled.empty())
+        {
+            lock.unlock();
+            for (pid_t tid : stalled)
+            {
+                dumpStack(tid);
+            }
+            lock.lock();
+        }
+    }
+}
+} // namespace
+
+std::atomic<bool> LoopWatchdog::active_(false);
+std::atomic<int64_t> LoopWatchdog::callbackBudgetNanos_(0);
+
+void LoopWatchdog::start(int stallMs, int64_t callbackBudgetMicros, bool captureStack)
+{
+    stop();
+
+    if (captureStack)
+    {
+        // backtrace第一次调用时会加载libgcc，提前调用一次，避免在信号处理函数中分配内存
+        void *frame;
+        ::backtrace(&frame, 1);
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof sa);
+        sa.sa_sigaction = stackHandler;
+        sa.sa_flags = SA_RESTART | SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        ::sigaction(kStackSignal, &sa, nullptr);
+    }
+
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_stallMs = stallMs > 0 ? stallMs : 1;
+    g_captureStack = captureStack;
+    g_running = true;
+    callbackBudgetNanos_.store(callbackBudgetMicros * 1000, std::memory_order_relaxed);
+    active_.store(true, std::memory_order_relaxed);
+    g_thread.reset(new Thread(watchdogThread, "LoopWatchdog"));
+    g_thread->start();
+}
+
+void LoopWatchdog::stop()
+{
+    std::unique_ptr<Thread> thread;
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        if (!g_running)
+        {
+            return;
+        }
+        g_running = false;
+        active_.store(false, std::memory_order_relaxed);
+        callbackBudgetNanos_.store(0, std::memory_order_relaxed);
+        thread = std::move(g_thread);
+    }
+    g_cond.notify_all();
+    thread->join();
+}
+
+uint64_t LoopWatchdog::stalls()
+{
+    return g_stalls.load(std::memory_order_relaxed);
+}
+
+void LoopWatchdog::registerLoop(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+    WatchedLoop w = {loop, false, 0, 0};
+    g_loops.push_back(w);
+}
+
+void LoopWatchdog::unregisterLoop(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+    for (size_t i = 0; i < g_loops.size(); ++i)
+    {
+        if (g_loops[i].loop == loop)
+        {
+            g_loops[i] = g_loops.back();
+            g_loops.pop_back();
+            break;
+        }
+    }
+}
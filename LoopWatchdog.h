@@ -0,0 +1,43 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+#include <atomic>
+
+class EventLoop;
+
+/*
+ * 发现卡住的EventLoop：一个阻塞的回调会让同一个loop上的所有连接停止响应
+ * 开启后各loop在每个回调前后记录心跳(当前轮次、开始时间、正在处理的fd)，
+ * 后台线程定期检查，一轮循环超过stallMs毫秒时打印卡住的loop、fd、已耗时，并抓取该线程的调用栈
+ * 抓取调用栈时向loop线程发送SIGURG，信号处理函数只调用backtrace，符号化在后台线程中完成；
+ * 信号会打断loop线程中的sleep和带超时的阻塞调用，使其提前返回，不希望如此时可以关闭captureStack
+ *
+ * 单个回调超过预算时在loop线程中计入LoopMetrics::slowCallbacks，并限频打印fd和耗时
+ *
+ * LoopWatchdog::start(500, 2000);  // 卡住500ms报告，回调超过2ms计数
+ */
+class LoopWatchdog : noncopyable
+{
+public:
+    // 启动后台检查线程，callbackBudgetMicros为0表示不统计慢回调，可在任意线程调用
+    static void start(int stallMs = 1000, int64_t callbackBudgetMicros = 0, bool captureStack = true);
+    // 停止后台线程，之后loop不再记录心跳
+    static void stop();
+
+    // loop是否需要记录心跳，每轮循环读取一次
+    static bool active() { return active_.load(std::memory_order_relaxed); }
+    // 单个回调的耗时预算(纳秒)，0表示不检查
+    static int64_t callbackBudgetNanos() { return callbackBudgetNanos_.load(std::memory_order_relaxed); }
+    // 已报告的卡住次数
+    static uint64_t stalls();
+
+    // EventLoop构造和析构时调用，析构后后台线程不会再访问该loop
+    static void registerLoop(EventLoop *loop);
+    static void unregisterLoop(EventLoop *loop);
+
+private:
+    static std::atomic<bool> active_;
+    static std::atomic<int64_t> callbackBudgetNanos_;
+};
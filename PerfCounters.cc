@@ -0,0 +1,152 @@
+#include "PerfCounters.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace
+{
+struct EventConfig
+{
+    uint32_t type;
+    uint64_t config;
+};
+
+const EventConfig kHardware[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+};
+
+const EventConfig kSoftware[] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+int perfEventOpen(const EventConfig &event, bool excludeKernel, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.exclude_kernel = excludeKernel ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid = 0, cpu = -1：只统计调用线程，跟随它在任意CPU上运行
+    return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+}
+
+void closeGroup(int fds[], int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        if (fds[i] >= 0)
+        {
+            ::close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+// 打开一组计数器，任何一个失败则整组不可用，fds[0]为组长
+void openGroup(const EventConfig events[], int n, int fds[], const char *name)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        fds[i] = -1;
+    }
+    // perf_event_paranoid >= 2时普通用户只能统计用户态
+    for (int excludeKernel = 0; excludeKernel <= 1; ++excludeKernel)
+    {
+        int i = 0;
+        for (; i < n; ++i)
+        {
+            fds[i] = perfEventOpen(events[i], excludeKernel != 0, i == 0 ? -1 : fds[0]);
+            if (fds[i] < 0)
+            {
+                break;
+            }
+        }
+        if (i == n)
+        {
+            return;
+        }
+        int saveErrno = errno;
+        closeGroup(fds, n);
+        if (saveErrno != EACCES && saveErrno != EPERM)
+        {
+            LOG_INFO("PerfCounters: %s counters unavailable, errno %d", name, saveErrno);
+            return;
+        }
+    }
+    LOG_INFO("PerfCounters: %s counters not permitted", name);
+}
+
+// 读出一组计数器，values[i]为第i个计数器按复用比例放大后的值
+bool readGroup(int leaderFd, int n, uint64_t values[])
+{
+    // read_format为GROUP|TOTAL_TIME_ENABLED|TOTAL_TIME_RUNNING时的布局：nr, time_enabled, time_running, value[nr]
+    uint64_t buf[3 + 8];
+    ssize_t len = ::read(leaderFd, buf, sizeof buf);
+    if (len < static_cast<ssize_t>((3 + n) * sizeof(uint64_t)) || buf[0] != static_cast<uint64_t>(n))
+    {
+        return false;
+    }
+    uint64_t enabled = buf[1];
+    uint64_t running = buf[2];
+    for (int i = 0; i < n; ++i)
+    {
+        values[i] = buf[3 + i];
+        if (running > 0 && running < enabled)
+        {
+            values[i] = static_cast<uint64_t>(static_cast<double>(values[i]) * enabled / running);
+        }
+    }
+    return true;
+}
+
+// 环境变量非空且不为"0"时视为开启
+bool envEnabled(const char *name)
+{
+    const char *value = ::getenv(name);
+    return value != nullptr && value[0] != '\0' && strcmp(value, "0") != 0;
+}
+} // namespace
+
+std::atomic<bool> PerfCounters::enabled_(envEnabled("MUDUO_PERF_COUNTERS"));
+
+PerfCounters::PerfCounters()
+{
+    openGroup(kHardware, kHardwareEvents, hardwareFds_, "hardware");
+    openGroup(kSoftware, kSoftwareEvents, softwareFds_, "software");
+}
+
+PerfCounters::~PerfCounters()
+{
+    closeGroup(hardwareFds_, kHardwareEvents);
+    closeGroup(softwareFds_, kSoftwareEvents);
+}
+
+void PerfCounters::read(PerfValues *values) const
+{
+    uint64_t hw[kHardwareEvents];
+    values->hardware = hardwareAvailable() && readGroup(hardwareFds_[0], kHardwareEvents, hw);
+    if (values->hardware)
+    {
+        values->cycles = hw[0];
+        values->instructions = hw[1];
+        values->llcMisses = hw[2];
+    }
+    uint64_t sw[kSoftwareEvents];
+    values->software = softwareAvailable() && readGroup(softwareFds_[0], kSoftwareEvents, sw);
+    if (values->software)
+    {
+        values->contextSwitches = sw[0];
+        values->pageFaults = sw[1];
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+#include <atomic>
+
+// 一个线程的性能计数器的累计值，不可用的计数器为0
+struct PerfValues
+{
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t llcMisses = 0;       // 末级缓存未命中(PERF_COUNT_HW_CACHE_MISSES)
+    uint64_t contextSwitches = 0;
+    uint64_t pageFaults = 0;
+    bool hardware = false;        // cycles、instructions、llcMisses可用，虚拟机中通常没有PMU
+    bool software = false;        // contextSwitches、pageFaults可用
+};
+
+/*
+ * 用perf_event_open为调用线程打开两组计数器：
+ *   硬件组 cycles、instructions、LLC misses
+ *   软件组 context switches、page faults
+ * 每组只用一次read读出组内所有计数器，权限不够统计内核态时退回只统计用户态，打不开的组标记为不可用
+ *
+ * 开启全局开关后，各EventLoop在自己的线程中创建计数器，每轮循环结束时读取一次写入LoopMetrics::perf，
+ * 每次读取是一到两个read系统调用，默认关闭；环境变量MUDUO_PERF_COUNTERS非空且不为"0"时默认开启
+ */
+class PerfCounters : noncopyable
+{
+public:
+    // 为调用线程打开计数器，之后的读取不限线程，但统计的始终是创建它的线程
+    PerfCounters();
+    ~PerfCounters();
+
+    bool hardwareAvailable() const { return hardwareFds_[0] >= 0; }
+    bool softwareAvailable() const { return softwareFds_[0] >= 0; }
+
+    // 读取累计值，计数器被内核分时复用时按实际运行时间的比例放大
+    void read(PerfValues *values) const;
+
+    static void enable() { enabled_.store(true, std::memory_order_relaxed); }
+    static void disable() { enabled_.store(false, std::memory_order_relaxed); }
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+private:
+    static const int kHardwareEvents = 3;
+    static const int kSoftwareEvents = 2;
+
+    int hardwareFds_[kHardwareEvents]; // 第一个是组长，-1表示不可用
+    int softwareFds_[kSoftwareEvents];
+
+    static std::atomic<bool> enabled_;
+};
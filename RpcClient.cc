@@ -0,0 +1,148 @@
+#include "RpcClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+RpcClient::RpcClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg)
+    : loop_(loop)
+    , nextId_(1)
+    , flushQueued_(false)
+    , token_(std::make_shared<int>(0))
+    , client_(loop, serverAddr, nameArg)
+{
+    client_.setConnectionCallback(std::bind(&RpcClient::onConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(std::bind(&RpcClient::onMessage, this, std::placeholders::_1,
+                                         std::placeholders::_2, std::placeholders::_3));
+}
+
+// 连接可能比RpcClient活得久，先断开它和this的联系，未完成的调用全部以kRpcDisconnected结束
+RpcClient::~RpcClient()
+{
+    TcpConnectionPtr conn = client_.connection();
+    if (conn)
+    {
+        conn->setConnectionCallback([](const TcpConnectionPtr &) {});
+        conn->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    }
+    token_.reset();
+    connection_.reset();
+    failAll();
+}
+
+void RpcClient::call(uint16_t method, const void *data, size_t len, const ResponseCallback &cb)
+{
+    if (loop_->isInLoopThread())
+    {
+        if (!connection_)
+        {
+            cb(kRpcDisconnected, nullptr, 0);
+            return;
+        }
+        uint64_t id = nextId_++;
+        RpcHeader header = { 0, RpcCodec::kRequest, kRpcOk, method, id };
+        RpcCodec::appendFrame(&output_, header, data, len);
+        pending_[id] = cb;
+        if (!flushQueued_)
+        {
+            flushQueued_ = true;
+            loop_->queueInLoop(std::bind(&RpcClient::flushIfAlive, std::weak_ptr<void>(token_), this));
+        }
+    }
+    else
+    {
+        std::string request(static_cast<const char*>(data), len);
+        loop_->runInLoop(std::bind(&RpcClient::callIfAlive, std::weak_ptr<void>(token_), this,
+                                   method, request, cb));
+    }
+}
+
+// 排队期间RpcClient已经析构时，调用按未连接处理
+void RpcClient::callIfAlive(const std::weak_ptr<void> &token, RpcClient *client, uint16_t method,
+                            const std::string &request, const ResponseCallback &cb)
+{
+    if (token.lock())
+    {
+        client->call(method, request.data(), request.size(), cb);
+    }
+    else
+    {
+        cb(kRpcDisconnected, nullptr, 0);
+    }
+}
+
+void RpcClient::flushIfAlive(const std::weak_ptr<void> &token, RpcClient *client)
+{
+    if (token.lock())
+    {
+        client->flush();
+    }
+}
+
+void RpcClient::flush()
+{
+    flushQueued_ = false;
+    if (connection_ && output_.readableBytes() > 0)
+    {
+        connection_->send(&output_);
+    }
+}
+
+void RpcClient::failAll()
+{
+    output_.retrieveAll();
+    std::unordered_map<uint64_t, ResponseCallback> pending;
+    pending.swap(pending_);
+    for (auto &call : pending)
+    {
+        call.second(kRpcDisconnected, nullptr, 0);
+    }
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        connection_ = conn;
+    }
+    else
+    {
+        connection_.reset();
+        failAll();
+    }
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    RpcHeader header;
+    RpcCodec::Result result;
+    while ((result = RpcCodec::parse(buf, &header)) == RpcCodec::kComplete)
+    {
+        auto it = pending_.find(header.id);
+        if (header.type == RpcCodec::kResponse && it != pending_.end())
+        {
+            // 先从表中摘下再回调，回调中可以发起新的调用
+            ResponseCallback cb;
+            cb.swap(it->second);
+            pending_.erase(it);
+            const char *payload = buf->peek() + RpcCodec::kHeaderBytes;
+            if (header.status == kRpcOk)
+            {
+                cb(kRpcOk, payload, header.payloadLen);
+            }
+            else
+            {
+                cb(static_cast<RpcStatus>(header.status), nullptr, 0);
+            }
+        }
+        buf->retrieve(RpcCodec::kHeaderBytes + header.payloadLen);
+    }
+    if (result == RpcCodec::kError)
+    {
+        LOG_ERROR("RpcClient[%s] - bad frame, payload length %u", client_.name().c_str(), header.payloadLen);
+        buf->retrieveAll();
+        conn->forceClose();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpClient.h"
+#include "RpcCodec.h"
+#include "Buffer.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/*
+ * 二进制RPC的客户端，一个TcpConnection上同时有任意多个未完成的调用，应答按id匹配，可以乱序到达
+ * 未完成的调用只在loop线程中访问，不需要加锁；其他线程的call通过runInLoop转到loop线程
+ * loop线程中(例如在应答回调中)连续发起的调用先攒在输出缓冲区中，本轮事件处理完后一次发出
+ * 和TcpClient一样需在loop线程中析构
+ */
+class RpcClient : noncopyable
+{
+public:
+    // data只在回调期间有效；status不是kRpcOk时没有数据
+    using ResponseCallback = std::function<void(RpcStatus status, const char *data, size_t len)>;
+
+    RpcClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+    ~RpcClient();
+
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    void enableRetry() { client_.enableRetry(); }
+    // 需在connect之前设置
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+
+    // 发起一次调用，可以在任意线程调用；未连接时回调立即收到kRpcDisconnected
+    void call(uint16_t method, const void *data, size_t len, const ResponseCallback &cb);
+    void call(uint16_t method, const std::string &request, const ResponseCallback &cb)
+    { call(method, request.data(), request.size(), cb); }
+
+    // 尚未收到应答的调用数，需在loop线程中调用
+    size_t inFlight() const { return pending_.size(); }
+    EventLoop *getLoop() const { return loop_; }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    static void callIfAlive(const std::weak_ptr<void> &token, RpcClient *client, uint16_t method,
+                            const std::string &request, const ResponseCallback &cb);
+    static void flushIfAlive(const std::weak_ptr<void> &token, RpcClient *client);
+    void flush();
+    void failAll();
+
+    EventLoop *loop_;
+    ConnectionCallback connectionCallback_;
+
+    // 以下只在loop线程中访问
+    TcpConnectionPtr connection_;
+    std::unordered_map<uint64_t, ResponseCallback> pending_;
+    uint64_t nextId_;
+    Buffer output_;     // 还没有发出的请求
+    bool flushQueued_;  // 已经排队了一次flush
+    std::shared_ptr<void> token_; // RpcClient析构后，已排队的call和flush不再访问this
+
+    TcpClient client_; // 声明在最后，析构时先断开连接的回调
+};
@@ -0,0 +1,87 @@
+#include "RpcCodec.h"
+#include "Buffer.h"
+
+#include <endian.h>
+#include <string.h>
+#include <utility>
+
+void RpcCodec::encode(char *dst, const RpcHeader &header)
+{
+    uint32_t len = htobe32(header.payloadLen);
+    uint16_t method = htobe16(header.method);
+    uint64_t id = htobe64(header.id);
+    memcpy(dst, &len, 4);
+    dst[4] = static_cast<char>(header.type);
+    dst[5] = static_cast<char>(header.status);
+    memcpy(dst + 6, &method, 2);
+    memcpy(dst + 8, &id, 8);
+}
+
+RpcCodec::Result RpcCodec::parse(const Buffer *buf, RpcHeader *header)
+{
+    if (buf->readableBytes() < kHeaderBytes)
+    {
+        return kNeedMore;
+    }
+    const char *p = buf->peek();
+    uint32_t len;
+    uint16_t method;
+    uint64_t id;
+    memcpy(&len, p, 4);
+    memcpy(&method, p + 6, 2);
+    memcpy(&id, p + 8, 8);
+    header->payloadLen = be32toh(len);
+    header->type = static_cast<uint8_t>(p[4]);
+    header->status = static_cast<uint8_t>(p[5]);
+    header->method = be16toh(method);
+    header->id = be64toh(id);
+    if (header->payloadLen > kMaxPayloadBytes || header->type > kResponse)
+    {
+        return kError;
+    }
+    return buf->readableBytes() - kHeaderBytes < header->payloadLen ? kNeedMore : kComplete;
+}
+
+void RpcCodec::appendFrame(Buffer *buf, const RpcHeader &header, const void *payload, size_t len)
+{
+    RpcHeader h = header;
+    h.payloadLen = static_cast<uint32_t>(len);
+    char encoded[kHeaderBytes];
+    encode(encoded, h);
+    buf->append(encoded, kHeaderBytes);
+    buf->append(static_cast<const char*>(payload), len);
+}
+
+size_t RpcCodec::beginFrame(Buffer *buf, const RpcHeader &header)
+{
+    size_t offset = buf->readableBytes();
+    char encoded[kHeaderBytes];
+    encode(encoded, header);
+    buf->append(encoded, kHeaderBytes);
+    return offset;
+}
+
+void RpcCodec::finishFrame(Buffer *buf, size_t frameOffset)
+{
+    uint32_t len = htobe32(static_cast<uint32_t>(buf->readableBytes() - frameOffset - kHeaderBytes));
+    memcpy(buf->beginRead() + frameOffset, &len, 4);
+}
+
+void RpcCodec::prependHeader(Buffer *buf, const RpcHeader &header)
+{
+    RpcHeader h = header;
+    h.payloadLen = static_cast<uint32_t>(buf->readableBytes());
+    char encoded[kHeaderBytes];
+    encode(encoded, h);
+    if (buf->prependableBytes() >= kHeaderBytes)
+    {
+        buf->prepend(encoded, kHeaderBytes);
+    }
+    else
+    {
+        Buffer frame(kHeaderBytes + h.payloadLen);
+        frame.append(encoded, kHeaderBytes);
+        frame.append(buf->peek(), buf->readableBytes());
+        *buf = std::move(frame);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Buffer;
+
+// 应答的状态，kRpcDisconnected只在客户端本地产生
+enum RpcStatus
+{
+    kRpcOk = 0,
+    kRpcNoMethod = 1,       // 服务端没有注册这个方法
+    kRpcOverloaded = 2,     // 计算线程池排队已满，请求被拒绝
+    kRpcDisconnected = 3,   // 应答到达之前连接断开
+};
+
+// 帧头，网络字节序
+struct RpcHeader
+{
+    uint32_t payloadLen;
+    uint8_t type;
+    uint8_t status;
+    uint16_t method;
+    uint64_t id;
+};
+
+/*
+ * RPC的帧格式：| payloadLen(4) | type(1) | status(1) | method(2) | id(8) | payload |
+ * 请求和应答同一种格式，应答沿用请求的method和id，客户端按id匹配，应答可以乱序
+ * 帧头正好16字节，等于Buffer::kCheapPrepend，已经写在Buffer中的payload可以直接在前面补上帧头
+ */
+class RpcCodec
+{
+public:
+    enum Type { kRequest = 0, kResponse = 1 };
+    enum Result { kNeedMore, kComplete, kError };
+
+    static const size_t kHeaderBytes = 16;
+    static const size_t kMaxPayloadBytes = 64 * 1024 * 1024;
+
+    // 解析buf->peek()开始的帧头，整个帧都已收到时返回kComplete，帧长超过上限时返回kError
+    static Result parse(const Buffer *buf, RpcHeader *header);
+
+    static void appendFrame(Buffer *buf, const RpcHeader &header, const void *payload, size_t len);
+    // 先写帧头，payload直接追加到buf中，最后用finishFrame补上长度，省去payload的一次拷贝
+    // 返回帧相对buf->peek()的偏移
+    static size_t beginFrame(Buffer *buf, const RpcHeader &header);
+    static void finishFrame(Buffer *buf, size_t frameOffset);
+    // buf中的可读数据作为payload，在前面的预留空间中写入帧头
+    static void prependHeader(Buffer *buf, const RpcHeader &header);
+
+private:
+    static void encode(char *dst, const RpcHeader &header);
+};
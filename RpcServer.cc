@@ -0,0 +1,114 @@
+#include "RpcServer.h"
+#include "Logger.h"
+
+RpcServer::RpcServer(EventLoop *loop,
+                     const InetAddress &listenAddr,
+                     const std::string &name,
+                     TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+{
+    server_.setConnectionCallback(std::bind(&RpcServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&RpcServer::onMessage, this, std::placeholders::_1,
+                                         std::placeholders::_2, std::placeholders::_3));
+}
+
+void RpcServer::registerMethod(uint16_t method, const Handler &handler, Dispatch dispatch)
+{
+    Method &m = methods_[method];
+    m.handler = handler;
+    m.dispatch = dispatch;
+}
+
+void RpcServer::start()
+{
+    LOG_INFO("RpcServer[%s] starts listening, %zu methods", server_.name().c_str(), methods_.size());
+    server_.start();
+}
+
+// 每个连接一个输出缓冲区，挂在TcpConnection的context上
+void RpcServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<Buffer>());
+    }
+}
+
+/*
+ * 循环处理buf中完整的请求帧，kInline方法的应答依次写进output，最后一次conn->send发出
+ * 客户端一次发来的一批管线化请求只产生一次write
+ */
+void RpcServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    Buffer *output = static_cast<Buffer*>(conn->getContext().get());
+    RpcHeader header;
+    RpcCodec::Result result;
+    while ((result = RpcCodec::parse(buf, &header)) == RpcCodec::kComplete)
+    {
+        const char *payload = buf->peek() + RpcCodec::kHeaderBytes;
+        // 应答类型的帧在服务端没有意义，直接丢弃
+        if (header.type == RpcCodec::kRequest)
+        {
+            RpcHeader response = header;
+            response.type = RpcCodec::kResponse;
+            response.status = kRpcOk;
+            response.payloadLen = 0;
+
+            auto it = methods_.find(header.method);
+            if (it == methods_.end())
+            {
+                response.status = kRpcNoMethod;
+                RpcCodec::appendFrame(output, response, nullptr, 0);
+            }
+            else if (it->second.dispatch == kInline)
+            {
+                size_t frame = RpcCodec::beginFrame(output, response);
+                it->second.handler(StringPiece(payload, header.payloadLen), output);
+                RpcCodec::finishFrame(output, frame);
+            }
+            else
+            {
+                offload(conn, it->second, response, StringPiece(payload, header.payloadLen), output);
+            }
+        }
+        buf->retrieve(RpcCodec::kHeaderBytes + header.payloadLen);
+    }
+
+    if (output->readableBytes() > 0)
+    {
+        conn->send(output);
+    }
+    if (result == RpcCodec::kError)
+    {
+        LOG_ERROR("RpcServer[%s] - bad frame from %s, payload length %u",
+                  server_.name().c_str(), conn->name().c_str(), header.payloadLen);
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+// 请求拷贝一份交给计算线程，应答在计算线程中生成，帧头写进预留空间后由loop线程发送
+void RpcServer::offload(const TcpConnectionPtr &conn, const Method &method, const RpcHeader &response,
+                        const StringPiece &payload, Buffer *output)
+{
+    ComputeThreadPool *pool = server_.computePool();
+    const Method *m = &method;
+    std::string request = payload.toString();
+    TcpConnectionPtr c = conn;
+    bool submitted = pool != nullptr && pool->submit(conn->getLoop(),
+        [m, request]() {
+            Buffer out;
+            m->handler(StringPiece(request), &out);
+            return out;
+        },
+        [c, response](Buffer out) {
+            RpcCodec::prependHeader(&out, response);
+            c->send(&out);
+        });
+    if (!submitted)
+    {
+        RpcHeader rejected = response;
+        rejected.status = kRpcOverloaded;
+        RpcCodec::appendFrame(output, rejected, nullptr, 0);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "RpcCodec.h"
+#include "StringPiece.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+/*
+ * 基于TcpServer的二进制RPC服务端，帧格式见RpcCodec
+ * 每个方法注册时选择执行位置：
+ *   kInline  在连接所在的loop线程中同步执行，应答直接写进本次读到的所有请求共用的输出缓冲区，处理完一起发出
+ *   kOffload 请求拷贝一份提交到TcpServer的计算线程池，执行完通过queueInLoop回到loop发送应答，
+ *            同一连接上的应答可能乱序，客户端按id匹配
+ *
+ * RpcServer server(&loop, InetAddress(9000), "rpc");
+ * server.registerMethod(1, [](const StringPiece &req, Buffer *resp) { resp->append(req.data(), req.size()); });
+ * server.start();
+ */
+class RpcServer : noncopyable
+{
+public:
+    // request只在调用期间有效，应答追加到response中
+    using Handler = std::function<void(const StringPiece &request, Buffer *response)>;
+    enum Dispatch { kInline, kOffload };
+
+    RpcServer(EventLoop *loop,
+              const InetAddress &listenAddr,
+              const std::string &name,
+              TcpServer::Option option = TcpServer::kNoReusePort);
+
+    // 以下需在start之前调用
+    void registerMethod(uint16_t method, const Handler &handler, Dispatch dispatch = kInline);
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    // 使用kOffload的方法时需要设置计算线程数
+    void setComputeThreadNum(int numThreads) { server_.setComputeThreadNum(numThreads); }
+    TcpServer *tcpServer() { return &server_; }
+
+    void start();
+
+private:
+    struct Method
+    {
+        Handler handler;
+        Dispatch dispatch;
+    };
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void offload(const TcpConnectionPtr &conn, const Method &method, const RpcHeader &response,
+                 const StringPiece &payload, Buffer *output);
+
+    TcpServer server_;
+    std::unordered_map<uint16_t, Method> methods_; // start之后只读
+};
@@ -0,0 +1,119 @@
+#include "ShmClient.h"
+#include "ShmServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string.h>
+
+ShmClient::ShmClient(EventLoop *loop, const UnixAddress &serverAddr, const std::string &nameArg)
+    : loop_(loop)
+    , busyPollMicros_(0)
+    , client_(loop, serverAddr, nameArg)
+{
+    client_.setConnectionCallback(std::bind(&ShmClient::onControlConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(std::bind(&ShmClient::onControlMessage, this, std::placeholders::_1,
+                                         std::placeholders::_2, std::placeholders::_3));
+}
+
+// 握手连接可能比ShmClient活得久，先断开它和this的联系，再销毁共享内存连接
+ShmClient::~ShmClient()
+{
+    TcpConnectionPtr control = client_.connection();
+    if (control)
+    {
+        control->setConnectionCallback([](const TcpConnectionPtr &) {});
+        control->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    }
+
+    ShmConnectionPtr shm;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        shm.swap(connection_);
+    }
+    if (shm)
+    {
+        shm->connectDestroyed();
+    }
+}
+
+void ShmClient::disconnect()
+{
+    ShmConnectionPtr shm = connection();
+    if (shm)
+    {
+        shm->shutdown();
+    }
+    client_.stop();
+}
+
+void ShmClient::onControlConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        return; // 等待服务端发来握手消息
+    }
+
+    ShmConnectionPtr shm;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        shm.swap(connection_);
+    }
+    if (shm)
+    {
+        shm->connectDestroyed();
+    }
+}
+
+// 握手消息收齐后，按顺序取出memfd、服务端的门铃和自己的门铃
+void ShmClient::onControlMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    if (connection() || buf->readableBytes() < ShmServer::kHandshakeBytes)
+    {
+        return;
+    }
+
+    ShmServer::Handshake handshake;
+    memcpy(&handshake, buf->peek(), sizeof handshake);
+    buf->retrieve(ShmServer::kHandshakeBytes);
+    int memfd = conn->takeReceivedFd();
+    int serverBell = conn->takeReceivedFd();
+    int clientBell = conn->takeReceivedFd();
+    if (memcmp(handshake.magic, ShmServer::kMagic, sizeof handshake.magic) != 0
+        || handshake.ringSize == 0 || (handshake.ringSize & (handshake.ringSize - 1)) != 0
+        || memfd < 0 || serverBell < 0 || clientBell < 0)
+    {
+        LOG_ERROR("ShmClient::onControlMessage [%s] - bad handshake", conn->name().c_str());
+        ::close(memfd);
+        ::close(serverBell);
+        ::close(clientBell);
+        conn->forceClose();
+        return;
+    }
+
+    // 共享内存的实际大小必须容纳两个环，否则mmap之后访问超出文件末尾的部分会SIGBUS
+    struct stat st;
+    if (::fstat(memfd, &st) < 0
+        || static_cast<uint64_t>(st.st_size) / 2 < ShmRing::mappedSize(handshake.ringSize))
+    {
+        LOG_ERROR("ShmClient::onControlMessage [%s] - shared memory smaller than the rings", conn->name().c_str());
+        ::close(memfd);
+        ::close(serverBell);
+        ::close(clientBell);
+        conn->forceClose();
+        return;
+    }
+
+    ShmConnectionPtr shm(new ShmConnection(loop_, conn->name(), memfd, handshake.ringSize,
+                                           false, clientBell, serverBell, conn));
+    ::close(memfd);
+    shm->setBusyPoll(busyPollMicros_);
+    shm->setConnectionCallback(connectionCallback_);
+    shm->setMessageCallback(messageCallback_);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connection_ = shm;
+    }
+    shm->connectEstablished();
+}
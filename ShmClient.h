@@ -0,0 +1,52 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpClient.h"
+#include "UnixAddress.h"
+#include "Callbacks.h"
+#include "ShmConnection.h"
+
+#include <string>
+#include <mutex>
+
+/*
+ * 共享内存连接的客户端，通过Unix域socket连接ShmServer，收到共享内存和门铃的fd后建立ShmConnection
+ * 和TcpClient一样需在loop线程中析构
+ */
+class ShmClient : noncopyable
+{
+public:
+    ShmClient(EventLoop *loop, const UnixAddress &serverAddr, const std::string &nameArg);
+    ~ShmClient();
+
+    void connect() { client_.connect(); }
+    void disconnect();
+    // 握手连接断开之后自动重连
+    void enableRetry() { client_.enableRetry(); }
+
+    // 当前的共享内存连接，未建立时为空，可以在任意线程调用
+    ShmConnectionPtr connection() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    // 以下需在connect之前设置
+    void setBusyPoll(int micros) { busyPollMicros_ = micros; }
+    void setConnectionCallback(const ShmConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const ShmMessageCallback &cb) { messageCallback_ = cb; }
+
+private:
+    void onControlConnection(const TcpConnectionPtr &conn);
+    void onControlMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    EventLoop *loop_;
+    int busyPollMicros_;
+    ShmConnectionCallback connectionCallback_;
+    ShmMessageCallback messageCallback_;
+
+    mutable std::mutex mutex_;
+    ShmConnectionPtr connection_; // 由mutex_保护
+
+    TcpClient client_; // 声明在最后，析构时先关闭握手连接
+};
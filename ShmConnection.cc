@@ -0,0 +1,271 @@
+#include "ShmConnection.h"
+#include "TcpConnection.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+ShmConnection::ShmConnection(EventLoop *loop,
+                             const std::string &name,
+                             int memfd,
+                             size_t ringSize,
+                             bool serverSide,
+                             int bellFd,
+                             int peerBellFd,
+                             const TcpConnectionPtr &control)
+    : loop_(loop)
+    , name_(name)
+    , state_(kDisconnected)
+    , base_(nullptr)
+    , mapSize_(2 * ShmRing::mappedSize(ringSize))
+    , bellFd_(bellFd)
+    , peerBellFd_(peerBellFd)
+    , bellChannel_(new Channel(loop, bellFd))
+    , control_(control)
+    , busyPollMicros_(0)
+    , notificationsSent_(0)
+    , notificationsSkipped_(0)
+{
+    base_ = ::mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (base_ == MAP_FAILED)
+    {
+        LOG_FATAL("%s:%s:%d mmap shm connection %s err:%d \n", __FILE__, __FUNCTION__, __LINE__, name_.c_str(), errno);
+    }
+
+    // 第一个环server => client，第二个环client => server，创建方(server)负责初始化
+    char *first = static_cast<char*>(base_);
+    char *second = first + ShmRing::mappedSize(ringSize);
+    sendRing_.attach(serverSide ? first : second, ringSize, serverSide);
+    recvRing_.attach(serverSide ? second : first, ringSize, serverSide);
+
+    bellChannel_->setReadCallback(std::bind(&ShmConnection::handleBell, this));
+    LOG_DEBUG("ShmConnection::ctor[%s] at %p ring=%zu", name_.c_str(), this, ringSize);
+}
+
+ShmConnection::~ShmConnection()
+{
+    LOG_DEBUG("ShmConnection::dtor[%s] at %p", name_.c_str(), this);
+    ::munmap(base_, mapSize_);
+    ::close(bellFd_);
+    ::close(peerBellFd_);
+}
+
+void ShmConnection::send(const void *data, size_t len)
+{
+    send(std::string(static_cast<const char*>(data), len));
+}
+
+void ShmConnection::send(const std::string &buf)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(buf.data(), buf.size());
+    }
+    else
+    {
+        loop_->runInLoop(std::bind(&ShmConnection::sendStringInLoop, shared_from_this(), buf));
+    }
+}
+
+void ShmConnection::sendStringInLoop(const std::string &message)
+{
+    sendInLoop(message.data(), message.size());
+}
+
+// 之前没有积压的数据时直接写入发送环，写不下的部分暂存在outputBuffer_中
+void ShmConnection::sendInLoop(const char *data, size_t len)
+{
+    if (state_ != kConnected)
+    {
+        LOG_ERROR("ShmConnection::sendInLoop [%s] disconnected, give up writing!", name_.c_str());
+        return;
+    }
+
+    size_t n = 0;
+    if (outputBuffer_.readableBytes() == 0)
+    {
+        n = sendRing_.write(data, len);
+        if (n > 0)
+        {
+            if (sendRing_.takeConsumerWaiting())
+            {
+                ring(peerBellFd_);
+            }
+            else
+            {
+                ++notificationsSkipped_;
+            }
+        }
+    }
+    if (n < len)
+    {
+        outputBuffer_.append(data + n, len - n);
+        flush();
+    }
+}
+
+// 把outputBuffer_中积压的数据写入发送环，环满时登记等待，对方读出数据后会按门铃
+void ShmConnection::flush()
+{
+    bool wrote = false;
+    while (outputBuffer_.readableBytes() > 0)
+    {
+        size_t n = sendRing_.write(outputBuffer_.peek(), outputBuffer_.readableBytes());
+        if (n > 0)
+        {
+            outputBuffer_.retrieve(n);
+            wrote = true;
+        }
+        else if (sendRing_.armProducer())
+        {
+            break;
+        }
+    }
+
+    if (wrote)
+    {
+        if (sendRing_.takeConsumerWaiting())
+        {
+            ring(peerBellFd_);
+        }
+        else
+        {
+            ++notificationsSkipped_;
+        }
+    }
+}
+
+void ShmConnection::shutdown()
+{
+    TcpConnectionPtr control = control_.lock();
+    if (control)
+    {
+        // 握手连接关闭后，ShmServer/ShmClient在各自的loop中调用connectDestroyed
+        control->forceClose();
+    }
+}
+
+void ShmConnection::ring(int fd)
+{
+    uint64_t one = 1;
+    if (::write(fd, &one, sizeof one) != sizeof one)
+    {
+        LOG_ERROR("ShmConnection::ring [%s] writes eventfd err:%d", name_.c_str(), errno);
+    }
+    ++notificationsSent_;
+}
+
+// 门铃既表示接收环有了数据，也表示对方腾出了发送环的空间
+void ShmConnection::handleBell()
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    uint64_t count = 0;
+    ::read(bellFd_, &count, sizeof count);
+    drain(Timestamp::now());
+    if (state_ == kConnected)
+    {
+        flush();
+    }
+}
+
+/*
+ * 读出接收环中的数据交给MessageCallback，直到接收环为空并且登记了等待
+ * 开启忙轮询时，登记等待之前先轮询busyPollMicros_微秒，期间对方写入数据不需要按门铃
+ * 连续读了kMaxRoundsPerEvent轮仍有数据时让出loop，避免饿死同一个loop上的其他连接
+ */
+void ShmConnection::drain(Timestamp receiveTime)
+{
+    for (int round = 0; ; ++round)
+    {
+        if (round == kMaxRoundsPerEvent)
+        {
+            // 对方一直在写，让出loop处理其他事件，不登记等待，排队之后继续读
+            loop_->queueInLoop(std::bind(&ShmConnection::handleBell, shared_from_this()));
+            return;
+        }
+        ssize_t n = recvRing_.readInto(&inputBuffer_);
+        if (n < 0)
+        {
+            // 对方写坏了共享内存，不能再信任其中的数据
+            LOG_ERROR("ShmConnection::drain [%s] - receive ring corrupted, closing", name_.c_str());
+            shutdown();
+            return;
+        }
+        if (n > 0)
+        {
+            if (recvRing_.takeProducerWaiting())
+            {
+                ring(peerBellFd_);
+            }
+            if (messageCallback_)
+            {
+                messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            }
+            if (state_ != kConnected)
+            {
+                return;
+            }
+            continue;
+        }
+
+        if (busyPollMicros_ > 0)
+        {
+            int64_t deadline = Timestamp::monotonic().microSecondsSinceEpoch() + busyPollMicros_;
+            while (recvRing_.empty() && Timestamp::monotonic().microSecondsSinceEpoch() < deadline)
+            {
+            }
+            if (!recvRing_.empty())
+            {
+                receiveTime = Timestamp::now();
+                continue;
+            }
+        }
+
+        if (recvRing_.armConsumer())
+        {
+            return;
+        }
+    }
+}
+
+void ShmConnection::connectEstablished()
+{
+    state_ = kConnected;
+    bellChannel_->tie(shared_from_this());
+    bellChannel_->enableReading();
+    if (connectionCallback_)
+    {
+        connectionCallback_(shared_from_this());
+    }
+    // 建立之前对方可能已经写入了数据，这时consumerWaiting为0，对方不会按门铃
+    drain(Timestamp::now());
+}
+
+// 握手连接断开之后调用，先把对方关闭前已经写入接收环的数据交给用户
+void ShmConnection::connectDestroyed()
+{
+    if (state_ == kConnected)
+    {
+        if (!recvRing_.empty())
+        {
+            drain(Timestamp::now());
+        }
+        state_ = kDisconnected;
+        bellChannel_->disableAll();
+        if (connectionCallback_)
+        {
+            connectionCallback_(shared_from_this());
+        }
+    }
+    bellChannel_->remove();
+}
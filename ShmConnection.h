@@ -0,0 +1,94 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+#include "ShmRing.h"
+#include "Timestamp.h"
+
+#include <memory>
+#include <atomic>
+#include <string>
+
+class Channel;
+class EventLoop;
+
+/*
+ * 同一台机器上两个进程之间的共享内存连接，由ShmServer/ShmClient通过Unix域socket握手建立
+ * 共享内存中是两个方向的ShmRing，各方一个eventfd作为门铃注册到自己的loop中
+ * 收发都不经过内核：send直接写入发送环，门铃响或者忙轮询时把接收环中的数据读到inputBuffer_交给MessageCallback
+ * 握手用的Unix域连接一直保留，任意一方关闭或进程退出时另一方由此得知连接断开
+ */
+class ShmConnection : noncopyable,
+                      public std::enable_shared_from_this<ShmConnection>
+{
+public:
+    // memfd映射后，server一方写第一个环读第二个环，client一方相反；bellFd是自己的门铃，peerBellFd是对方的
+    ShmConnection(EventLoop *loop,
+                  const std::string &name,
+                  int memfd,
+                  size_t ringSize,
+                  bool serverSide,
+                  int bellFd,
+                  int peerBellFd,
+                  const TcpConnectionPtr &control);
+    ~ShmConnection();
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    bool connected() const { return state_ == kConnected; }
+
+    // 发送数据，可以在任意线程调用，发送环满时暂存在outputBuffer_中，对方腾出空间后继续写
+    void send(const void *data, size_t len);
+    void send(const std::string &buf);
+    // 关闭连接，已写入发送环的数据对方仍能收到
+    void shutdown();
+
+    // 门铃响之后，读完数据先忙轮询micros微秒再睡眠，轮询期间对方发送不需要写eventfd，需在connectEstablished之前调用
+    void setBusyPoll(int micros) { busyPollMicros_ = micros; }
+
+    void setConnectionCallback(const ShmConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const ShmMessageCallback &cb) { messageCallback_ = cb; }
+
+    // 统计写eventfd唤醒对方的次数，以及因对方正在处理而省掉的次数
+    uint64_t notificationsSent() const { return notificationsSent_.load(std::memory_order_relaxed); }
+    uint64_t notificationsSkipped() const { return notificationsSkipped_.load(std::memory_order_relaxed); }
+
+    // 以下由ShmServer/ShmClient在loop线程中调用
+    void connectEstablished();
+    void connectDestroyed();
+
+private:
+    enum StateE { kDisconnected, kConnected };
+    static const int kMaxRoundsPerEvent = 16;
+
+    void handleBell();
+    void drain(Timestamp receiveTime);
+    void flush();
+    void sendInLoop(const char *data, size_t len);
+    void sendStringInLoop(const std::string &message);
+    void ring(int fd);
+
+    EventLoop *loop_;
+    const std::string name_;
+    std::atomic_int state_;
+
+    void *base_;
+    size_t mapSize_;
+    ShmRing sendRing_;
+    ShmRing recvRing_;
+    int bellFd_;
+    int peerBellFd_;
+    std::unique_ptr<Channel> bellChannel_;
+    std::weak_ptr<TcpConnection> control_;
+    int busyPollMicros_;
+
+    ShmConnectionCallback connectionCallback_;
+    ShmMessageCallback messageCallback_;
+
+    Buffer inputBuffer_;
+    Buffer outputBuffer_; // 发送环满时暂存的数据
+
+    std::atomic<uint64_t> notificationsSent_;
+    std::atomic<uint64_t> notificationsSkipped_;
+};
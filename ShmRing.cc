@@ -0,0 +1,118 @@
+#include "ShmRing.h"
+#include "Buffer.h"
+
+#include <new>
+#include <string.h>
+#include <algorithm>
+
+ShmRing::ShmRing()
+    : header_(nullptr)
+    , data_(nullptr)
+    , capacity_(0)
+{
+}
+
+void ShmRing::attach(void *base, size_t capacity, bool init)
+{
+    header_ = static_cast<Header*>(base);
+    data_ = static_cast<char*>(base) + sizeof(Header);
+    capacity_ = capacity;
+    if (init)
+    {
+        new (header_) Header();
+        header_->head.store(0, std::memory_order_relaxed);
+        header_->tail.store(0, std::memory_order_relaxed);
+        header_->consumerWaiting.store(0, std::memory_order_relaxed);
+        header_->producerWaiting.store(0, std::memory_order_relaxed);
+    }
+}
+
+// 先拷贝数据，再用release发布head，消费者acquire读到head之后一定能看到数据
+size_t ShmRing::write(const char *data, size_t len)
+{
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    uint64_t tail = header_->tail.load(std::memory_order_acquire);
+    // tail由对方进程写入，已用空间超过容量时当作环满，避免越界写
+    size_t used = static_cast<size_t>(head - tail);
+    if (used > capacity_)
+    {
+        return 0;
+    }
+    size_t n = std::min(len, capacity_ - used);
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    size_t offset = static_cast<size_t>(head & (capacity_ - 1));
+    size_t first = std::min(n, capacity_ - offset);
+    memcpy(data_ + offset, data, first);
+    memcpy(data_, data + first, n - first);
+    // seq_cst：发布head和随后读取consumerWaiting不能重排，和armConsumer配对
+    header_->head.store(head + n, std::memory_order_seq_cst);
+    return n;
+}
+
+bool ShmRing::takeConsumerWaiting()
+{
+    return header_->consumerWaiting.load(std::memory_order_seq_cst) != 0
+           && header_->consumerWaiting.exchange(0, std::memory_order_seq_cst) != 0;
+}
+
+bool ShmRing::armProducer()
+{
+    header_->producerWaiting.store(1, std::memory_order_seq_cst);
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    if (head - header_->tail.load(std::memory_order_seq_cst) < capacity_)
+    {
+        header_->producerWaiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+ssize_t ShmRing::readInto(Buffer *buf)
+{
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+    size_t n = static_cast<size_t>(head - tail);
+    if (n == 0)
+    {
+        return 0;
+    }
+    // head由对方进程写入，不可信，超过容量时按原样拷贝会越界读
+    if (n > capacity_)
+    {
+        return -1;
+    }
+
+    size_t offset = static_cast<size_t>(tail & (capacity_ - 1));
+    size_t first = std::min(n, capacity_ - offset);
+    buf->append(data_ + offset, first);
+    buf->append(data_, n - first);
+    // seq_cst：发布tail和随后读取producerWaiting不能重排，和armProducer配对
+    header_->tail.store(head, std::memory_order_seq_cst);
+    return static_cast<ssize_t>(n);
+}
+
+bool ShmRing::takeProducerWaiting()
+{
+    return header_->producerWaiting.load(std::memory_order_seq_cst) != 0
+           && header_->producerWaiting.exchange(0, std::memory_order_seq_cst) != 0;
+}
+
+bool ShmRing::armConsumer()
+{
+    header_->consumerWaiting.store(1, std::memory_order_seq_cst);
+    if (header_->head.load(std::memory_order_seq_cst) != header_->tail.load(std::memory_order_relaxed))
+    {
+        header_->consumerWaiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool ShmRing::empty() const
+{
+    return header_->head.load(std::memory_order_acquire) == header_->tail.load(std::memory_order_relaxed);
+}
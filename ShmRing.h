@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+class Buffer;
+
+/*
+ * 共享内存中的单生产者单消费者字节环，两个进程各映射一份，一方只写一方只读
+ * head/tail是一直递增的字节位置，下标为位置对容量取模，容量必须是2的幂
+ *
+ * 通知：消费者处理完数据准备睡眠时置consumerWaiting，生产者写入后只有看到该标志才去写eventfd唤醒对方；
+ * 消费者正在处理(或者忙轮询)时标志为0，生产者省掉这次系统调用。环满时生产者用producerWaiting请求对方腾出空间后唤醒
+ */
+class ShmRing
+{
+public:
+    // 各字段独占一个cache line，避免两个进程互相使对方的cache line失效
+    struct Header
+    {
+        alignas(64) std::atomic<uint64_t> head;            // 生产者写到的位置
+        alignas(64) std::atomic<uint64_t> tail;            // 消费者读到的位置
+        alignas(64) std::atomic<uint32_t> consumerWaiting; // 消费者在等待新数据
+        alignas(64) std::atomic<uint32_t> producerWaiting; // 生产者在等待空闲空间
+    };
+
+    // 容量为capacity的环在共享内存中占用的字节数
+    static size_t mappedSize(size_t capacity) { return sizeof(Header) + capacity; }
+
+    ShmRing();
+    // base指向mappedSize(capacity)字节的共享内存，init为true时初始化头部(只由创建方调用一次)
+    void attach(void *base, size_t capacity, bool init);
+
+    // 生产者：尽量写入，返回实际写入的字节数
+    size_t write(const char *data, size_t len);
+    // 生产者：写入之后检查消费者是否在等待，是则清除标志并返回true，调用者需要唤醒对方
+    bool takeConsumerWaiting();
+    // 生产者：环满时登记等待，返回false表示登记期间已经有了空闲空间，不需要等待
+    bool armProducer();
+
+    // 消费者：把当前所有数据追加到buf中，返回读出的字节数
+    // 对方写坏了head(未读的数据超过容量)时不读任何数据，返回-1，调用者应断开连接
+    ssize_t readInto(Buffer *buf);
+    // 消费者：读出数据之后检查生产者是否在等待空间，是则清除标志并返回true
+    bool takeProducerWaiting();
+    // 消费者：准备睡眠时登记等待，返回false表示登记期间又来了数据，需要继续读
+    bool armConsumer();
+
+    bool empty() const;
+    size_t capacity() const { return capacity_; }
+
+private:
+    Header *header_;
+    char *data_;
+    size_t capacity_;
+};
@@ -0,0 +1,95 @@
+#include "ShmServer.h"
+#include "Logger.h"
+
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+const char ShmServer::kMagic[8] = {'M', 'U', 'D', 'U', 'O', 'S', 'H', 'M'};
+const size_t ShmServer::kHandshakeBytes;
+
+ShmServer::ShmServer(EventLoop *loop, const UnixAddress &listenAddr, const std::string &nameArg)
+    : name_(nameArg)
+    , ringSize_(1024 * 1024)
+    , busyPollMicros_(0)
+    , server_(loop, listenAddr, nameArg)
+{
+    server_.setConnectionCallback(std::bind(&ShmServer::onControlConnection, this, std::placeholders::_1));
+    // 握手连接上不会再有数据，收到了直接丢弃
+    server_.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+}
+
+ShmServer::~ShmServer()
+{
+}
+
+void ShmServer::setRingSize(size_t bytes)
+{
+    size_t size = 4096;
+    while (size < bytes)
+    {
+        size <<= 1;
+    }
+    ringSize_ = size;
+}
+
+// 在握手连接所在的subLoop中执行，共享内存连接也运行在这个loop上
+void ShmServer::onControlConnection(const TcpConnectionPtr &conn)
+{
+    if (!conn->connected())
+    {
+        ShmConnectionPtr shm;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto it = connections_.find(conn->name());
+            if (it != connections_.end())
+            {
+                shm = it->second;
+                connections_.erase(it);
+            }
+        }
+        if (shm)
+        {
+            shm->connectDestroyed();
+        }
+        return;
+    }
+
+    int memfd = ::memfd_create(name_.c_str(), MFD_CLOEXEC);
+    int serverBell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int clientBell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (memfd < 0 || serverBell < 0 || clientBell < 0
+        || ::ftruncate(memfd, 2 * ShmRing::mappedSize(ringSize_)) < 0)
+    {
+        LOG_ERROR("ShmServer::onControlConnection [%s] - create shm for %s err:%d",
+                  name_.c_str(), conn->name().c_str(), errno);
+        ::close(memfd);
+        ::close(serverBell);
+        ::close(clientBell);
+        conn->forceClose();
+        return;
+    }
+
+    // 先映射并初始化两个环，再把fd交给客户端
+    ShmConnectionPtr shm(new ShmConnection(conn->getLoop(), conn->name(), memfd, ringSize_,
+                                           true, serverBell, clientBell, conn));
+    shm->setBusyPoll(busyPollMicros_);
+    shm->setConnectionCallback(connectionCallback_);
+    shm->setMessageCallback(messageCallback_);
+
+    Handshake handshake;
+    memcpy(handshake.magic, kMagic, sizeof handshake.magic);
+    handshake.ringSize = ringSize_;
+    conn->sendFd(memfd, std::string(reinterpret_cast<const char*>(&handshake), sizeof handshake));
+    conn->sendFd(serverBell, "s");
+    conn->sendFd(clientBell, "c");
+    ::close(memfd); // 已经映射，sendFd也dup了一份
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connections_[conn->name()] = shm;
+    }
+    shm->connectEstablished();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "UnixAddress.h"
+#include "Callbacks.h"
+#include "ShmConnection.h"
+
+#include <string>
+#include <mutex>
+#include <unordered_map>
+
+/*
+ * 共享内存连接的服务端
+ * 在Unix域socket上接受握手连接，为每个连接创建memfd共享内存和两个eventfd，通过SCM_RIGHTS交给客户端，
+ * 之后数据只经过共享内存中的环，握手连接只用来感知对方关闭
+ *
+ * ShmServer server(&loop, UnixAddress("@md-feed"), "md-feed");
+ * server.setMessageCallback(onMessage);
+ * server.start();
+ */
+class ShmServer : noncopyable
+{
+public:
+    ShmServer(EventLoop *loop, const UnixAddress &listenAddr, const std::string &nameArg);
+    ~ShmServer();
+
+    // 以下需在start之前设置
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    // 每个方向的环的大小，向上取整为2的幂
+    void setRingSize(size_t bytes);
+    // 见ShmConnection::setBusyPoll
+    void setBusyPoll(int micros) { busyPollMicros_ = micros; }
+    void setConnectionCallback(const ShmConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const ShmMessageCallback &cb) { messageCallback_ = cb; }
+
+    void start() { server_.start(); }
+
+    // 握手消息，随第一个字节传递memfd，之后两个字节分别传递server和client的门铃
+    struct Handshake
+    {
+        char magic[8];
+        uint64_t ringSize;
+    };
+    static const char kMagic[8];
+    static const size_t kHandshakeBytes = sizeof(Handshake) + 2;
+
+private:
+    void onControlConnection(const TcpConnectionPtr &conn);
+
+    std::string name_;
+    size_t ringSize_;
+    int busyPollMicros_;
+    ShmConnectionCallback connectionCallback_;
+    ShmMessageCallback messageCallback_;
+
+    // 握手连接的名字 => 共享内存连接，握手连接分布在各个subLoop中，需要加锁
+    std::mutex mutex_;
+    std::unordered_map<std::string, ShmConnectionPtr> connections_;
+
+    TcpServer server_; // 声明在最后，析构时先关闭握手连接
+};
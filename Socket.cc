@@ -1,6 +1,7 @@
 #include "Socket.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "UnixAddress.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -22,6 +23,14 @@ void Socket::bindAddress(const InetAddress &Localaddr)
     }
 }
 
+void Socket::bindAddress(const UnixAddress &localaddr)
+{
+    if (0 != ::bind(sockfd_, (sockaddr*)localaddr.getSockAddr(), localaddr.length()))
+    {
+        LOG_FATAL("bind unix sockfd:%d path:%s fail:%d \n", sockfd_, localaddr.toPath().c_str(), errno);
+    }
+}
+
 // 对系统的::listen()进行封装
 void Socket::listen()
 {
@@ -38,8 +47,9 @@ int Socket::accept(InetAddress *peeraddr)
     sockaddr_in addr;
     socklen_t len = sizeof addr;
     bzero(&addr, sizeof addr);
-    int connfd = ::accept4(sockfd_, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
-    if (connfd >= 0)
+    int connfd = peeraddr ? ::accept4(sockfd_, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC)
+                          : ::accept4(sockfd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (connfd >= 0 && peeraddr)
     {
         peeraddr->setSockAddr(&addr);
     }
@@ -76,6 +86,12 @@ void Socket::setKeepAlive(bool on)
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
 }
 
+void Socket::setReceiveTimestamp(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPNS, &optval, sizeof optval);
+}
+
 
 
 int Socket::getSocketError(int sockfd)
@@ -105,4 +121,25 @@ sockaddr_in Socket::getLocalAddr(int sockfd)
     }
     return localaddr;
     
-}
\ No newline at end of file
+}
+
+// 通过sockfd获取对端的ip地址和端口信息
+sockaddr_in Socket::getPeerAddr(int sockfd)
+{
+    struct sockaddr_in peeraddr;
+    bzero(&peeraddr, sizeof peeraddr);
+    socklen_t addrlen = static_cast<socklen_t>(sizeof peeraddr);
+    if (::getpeername(sockfd, (sockaddr*)(&peeraddr), &addrlen) < 0)
+    {
+        LOG_ERROR("Socket::getPeerAddr");
+    }
+    return peeraddr;
+}
+
+bool Socket::isSelfConnect(int sockfd)
+{
+    struct sockaddr_in localaddr = getLocalAddr(sockfd);
+    struct sockaddr_in peeraddr = getPeerAddr(sockfd);
+    return localaddr.sin_port == peeraddr.sin_port
+        && localaddr.sin_addr.s_addr == peeraddr.sin_addr.s_addr;
+}
@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 
 class InetAddress;
+class UnixAddress;
 
 // 类本身并不创建socket，而是管理传进来的socketfd，并辅以对应系统bind listen accept函数
 class Socket : noncopyable
@@ -16,7 +17,9 @@ public:
 
     int fd() const { return sockfd_; }
     void bindAddress(const InetAddress &Localaddr);
+    void bindAddress(const UnixAddress &localaddr);
     void listen();
+    // peeraddr为空时不取对端地址，Unix域socket使用
     int accept(InetAddress *peeraddr);
 
     void shutdownWrite();
@@ -25,9 +28,14 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 让内核为收到的数据打上软件接收时间戳(SO_TIMESTAMPNS)，通过recvmsg的控制消息取出
+    void setReceiveTimestamp(bool on);
 
     static int getSocketError(int sockfd);
     static sockaddr_in getLocalAddr(int sockfd);
+    static sockaddr_in getPeerAddr(int sockfd);
+    // 连接本机的临时端口时可能和自己建立连接(TCP自连接)，Connector需要排除这种情况
+    static bool isSelfConnect(int sockfd);
 
 private:
     const int sockfd_;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+#include <strings.h>
+
+// 指向一段已有内存的字符串视图，不拥有也不拷贝数据，只在底层内存有效期间使用
+class StringPiece
+{
+public:
+    StringPiece()
+        : data_(nullptr)
+        , size_(0)
+    {}
+    StringPiece(const char *data, size_t size)
+        : data_(data)
+        , size_(size)
+    {}
+    StringPiece(const char *str)
+        : data_(str)
+        , size_(strlen(str))
+    {}
+    StringPiece(const std::string &str)
+        : data_(str.data())
+        , size_(str.size())
+    {}
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    char operator[](size_t i) const { return data_[i]; }
+
+    std::string toString() const { return std::string(data_, size_); }
+
+    bool operator==(const StringPiece &other) const
+    {
+        return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+    }
+    bool operator!=(const StringPiece &other) const { return !(*this == other); }
+
+    // 忽略大小写比较，HTTP头部名称使用
+    bool equalsIgnoreCase(const StringPiece &other) const
+    {
+        return size_ == other.size_ && strncasecmp(data_, other.data_, size_) == 0;
+    }
+
+private:
+    const char *data_;
+    size_t size_;
+};
@@ -0,0 +1,146 @@
+#include "TcpClient.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Socket.h"
+#include "Logger.h"
+
+#include <stdio.h>
+
+// TcpClient析构后仍存活的连接，关闭时直接销毁
+static void removeConnectionAfterClient(EventLoop *loop, const TcpConnectionPtr &conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+TcpClient::TcpClient(EventLoop *loop,
+                     const InetAddress &serverAddr,
+                     const std::string &nameArg)
+    : loop_(loop)
+    , connector_(new Connector(loop, serverAddr))
+    , name_(nameArg)
+    , retry_(false)
+    , connect_(true)
+    , nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(
+        std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+    LOG_INFO("TcpClient::TcpClient[%s] - connector %p", name_.c_str(), connector_.get());
+}
+
+TcpClient::TcpClient(EventLoop *loop,
+                     const UnixAddress &serverAddr,
+                     const std::string &nameArg)
+    : loop_(loop)
+    , connector_(new Connector(loop, serverAddr))
+    , name_(nameArg)
+    , retry_(false)
+    , connect_(true)
+    , nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(
+        std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+    LOG_INFO("TcpClient::TcpClient[%s] - unix connector %p", name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient()
+{
+    LOG_INFO("TcpClient::~TcpClient[%s] - connector %p", name_.c_str(), connector_.get());
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        unique = connection_.use_count() == 1;
+        conn = connection_;
+    }
+
+    if (conn)
+    {
+        // 连接可能比TcpClient活得久，关闭回调不能再指向this
+        EventLoop *loop = loop_;
+        loop_->runInLoop([conn, loop]() {
+            conn->setCloseCallback(std::bind(&removeConnectionAfterClient, loop, std::placeholders::_1));
+        });
+        if (unique)
+        {
+            conn->forceClose();
+        }
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect[%s] - connecting to %s", name_.c_str(),
+             connector_->serverName().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    // Unix域socket没有IP地址，localAddr和peerAddr都保持默认值
+    const bool unixDomain = connector_->unixDomain();
+    InetAddress peerAddr = unixDomain ? InetAddress() : InetAddress(Socket::getPeerAddr(sockfd));
+    char buf[160];
+    snprintf(buf, sizeof buf, ":%s#%d",
+             unixDomain ? connector_->serverName().c_str() : peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    InetAddress localAddr = unixDomain ? InetAddress() : InetAddress(Socket::getLocalAddr(sockfd));
+    TcpConnectionPtr conn(new TcpConnection(loop_,
+                                            connName,
+                                            sockfd,
+                                            localAddr,
+                                            peerAddr));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (unixDomain)
+    {
+        conn->setPassFd(true);
+    }
+    conn->setCloseCallback(
+        std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+// 连接断开，开启重连时重新发起连接
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    if (retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::connect[%s] - Reconnecting to %s", name_.c_str(),
+                 connector_->serverName().c_str());
+        connector_->restart();
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpConnection.h"
+#include "UnixAddress.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <atomic>
+
+class Connector;
+using ConnectorPtr = std::shared_ptr<Connector>;
+
+/*
+ * 客户端，和TcpServer对应，连接建立后得到的是普通的TcpConnection
+ * 一个EventLoop中可以有任意多个TcpClient，不需要额外的线程
+ *
+ * TcpClient client(&loop, InetAddress(8000), "upstream");
+ * client.setMessageCallback(onMessage);
+ * client.enableRetry();
+ * client.connect();
+ */
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop,
+              const InetAddress &serverAddr,
+              const std::string &nameArg);
+    // 连接本机的Unix域socket，连接支持sendFd传递fd
+    TcpClient(EventLoop *loop,
+              const UnixAddress &serverAddr,
+              const std::string &nameArg);
+    // 需在loop线程中析构
+    ~TcpClient();
+
+    // 发起连接，失败时由Connector退避重试
+    void connect();
+    // 关闭已建立的连接(半关闭，等待输出缓冲区发送完)
+    void disconnect();
+    // 停止尚未完成的连接
+    void stop();
+
+    // 当前的连接，未连接时为空，可以在任意线程调用
+    TcpConnectionPtr connection() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop *getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    // 连接建立之后又断开时自动重连
+    void enableRetry() { retry_ = true; }
+    const std::string &name() const { return name_; }
+
+    // 非线程安全，需在connect之前设置
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+    void setWriteCompleteCallback(WriteCompleteCallback cb) { writeCompleteCallback_ = std::move(cb); }
+
+private:
+    // Connector连接成功后在loop线程中回调
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_; // 只在loop线程中访问
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // 由mutex_保护
+};
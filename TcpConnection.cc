@@ -3,8 +3,13 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "Tracer.h"
 
 #include <functional>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -15,6 +20,35 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
     return loop;
 }
 
+// 用sendmsg发送数据，同时通过SCM_RIGHTS把fd传给对端，内核在发送时就增加了fd的引用，之后可以关闭本地的fd
+static ssize_t sendWithFd(int sockfd, const char *data, size_t len, int fd)
+{
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(data);
+    vec.iov_len = len;
+
+    // 和cmsghdr放在一个union里，保证按cmsghdr对齐
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(control.buf, 0, sizeof control.buf);
+    struct msghdr msg = {};
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof control.buf;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof fd);
+
+    return ::sendmsg(sockfd, &msg, 0);
+}
+
 TcpConnection::TcpConnection(EventLoop *loop,
                              const std::string &nameArg,
                              int sockfd,
@@ -25,12 +59,27 @@ TcpConnection::TcpConnection(EventLoop *loop,
     , state_(kConnecting)
     , reading_(true)
     , socket_(new Socket(sockfd))
-    , channel_(new Channel(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024)
+    , migrating_(false)
+    , migrationRefused_(false)
+    , recentBytes_(0)
+    , kernelTimestamp_(false)
+    , passFd_(false)
+    , outputQueuedNanos_(0)
+    , migratedBacklog_(0)
 {
-    // 下面给channel设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会回调相应的操作函数
+    setupChannel(loop, sockfd);
+
+    LOG_DEBUG("TcpConnection::ctor[%s] at %p fd=%d", name_.c_str(), this, sockfd);
+    socket_->setKeepAlive(true);
+}
+
+// 创建当前loop上的channel，并设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会回调相应的操作函数
+void TcpConnection::setupChannel(EventLoop *loop, int sockfd)
+{
+    channel_.reset(new Channel(loop, sockfd));
     channel_->setReadCallback(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
     channel_->setWriteCallback(
@@ -39,15 +88,20 @@ TcpConnection::TcpConnection(EventLoop *loop,
         std::bind(&TcpConnection::handleClose, this));
     channel_->setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
-
-    LOG_INFO("TcpConnection::ctor[%s] at %p fd=%d", name_.c_str(), this, sockfd);
-    socket_->setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at %p fd=%d state=%s", 
+    LOG_DEBUG("TcpConnection::dtor[%s] at %p fd=%d state=%s", 
         name_.c_str(), this, channel_->fd(), stateToString());
+    for (int fd : receivedFds_)
+    {
+        ::close(fd);
+    }
+    for (auto &pending : pendingFds_)
+    {
+        ::close(pending.second);
+    }
 }
 
 
@@ -63,25 +117,48 @@ void TcpConnection::send(const std::string &buf)
 {
     if (state_ == kConnected)
     {
-        if (loop_->isInLoopThread())
+        EventLoop *loop = getLoop();
+        if (loop->isInLoopThread())
         {
             sendInLoop(buf.c_str(), buf.size());
         }
         else
         {
-            loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()
+            // 跨线程发送时buf的生命周期无法保证，需要拷贝一份数据交给loop线程
+            loop->runInLoop(std::bind(
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                buf
             ));
         }
     }
 }
 
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (getLoop()->isInLoopThread())
+        {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            send(buf->retrieveAllAsString());
+        }
+    }
+}
+
+void TcpConnection::sendStringInLoop(const std::string &message)
+{
+    sendInLoop(message.data(), message.size());
+}
+
 // 发送数据  应用写的快，而内核发动数据慢，需要把待发送数据写入缓冲区，而且设置了水位回调
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
+    TraceSpan span("sendInLoop", "bytes", static_cast<int64_t>(len));
     ssize_t nwrote = 0;
     size_t remaining = len;
     bool faultError = false;
@@ -93,17 +170,31 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         return;
     }
 
+    // 排队期间连接被迁移到了其他loop，按原顺序转发过去
+    EventLoop *loop = getLoop();
+    if (!loop->isInLoopThread())
+    {
+        loop->runInLoop(std::bind(
+            &TcpConnection::sendStringInLoop,
+            shared_from_this(),
+            std::string(static_cast<const char*>(data), len)
+        ));
+        return;
+    }
+
     // 表示channel_第一次开始写数据，而且缓冲区没有待发送数据
     if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
     {
         nwrote = ::write(channel_->fd(), data, len);
+        recordWrite(nwrote);
         if (nwrote >= 0)
         {
             remaining = len - nwrote;
+            recentBytes_ += nwrote;
             if (remaining == 0 && writeCompleteCallback_)
             {
                 // 既然在这路数据全部发送完成， 就不用再给channel设置epollout事件了
-                loop_->queueInLoop(
+                loop->queueInLoop(
                     std::bind(writeCompleteCallback_, shared_from_this())
                 );
             }
@@ -136,12 +227,17 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
             && oldlen < highWaterMark_              // 上次剩余数据量无需水位回调
             && highWaterMarkCallback_)
         {
-            loop_->queueInLoop(
+            loop->queueInLoop(
                 std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining)
             );
         }
         
+        if (ioCounters_ && oldlen == 0)
+        {
+            outputQueuedNanos_ = Timestamp::monotonicNanos();
+        }
         outputBuffer_.append((char*)data + nwrote, remaining);
+        loop->metrics().outputBacklog += remaining;
         if (!channel_->isWriting())
         {
             channel_->enableWriting();  // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
@@ -151,19 +247,181 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
 
 
 
+// 发送fd，跨线程时fd的生命周期无法保证，先dup一份交给loop线程
+void TcpConnection::sendFd(int fd, const std::string &data)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (data.empty())
+    {
+        LOG_ERROR("TcpConnection::sendFd [%s] - data must not be empty", name_.c_str());
+        return;
+    }
+    int dupFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupFd < 0)
+    {
+        LOG_ERROR("TcpConnection::sendFd [%s] - dup fd:%d error:%d", name_.c_str(), fd, errno);
+        return;
+    }
+    getLoop()->runInLoop(std::bind(&TcpConnection::sendFdInLoop, shared_from_this(), dupFd, data));
+}
+
+/*
+ * outputBuffer_为空时直接sendmsg，否则记下fd对应的字节位置，和数据一起排队
+ * handleWrite写到这个位置时再用sendmsg把fd带上，保证fd和数据的先后顺序不变
+ */
+void TcpConnection::sendFdInLoop(int fd, const std::string &data)
+{
+    EventLoop *loop = getLoop();
+    if (!loop->isInLoopThread())
+    {
+        loop->runInLoop(std::bind(&TcpConnection::sendFdInLoop, shared_from_this(), fd, data));
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up sending fd!");
+        ::close(fd);
+        return;
+    }
+
+    size_t nwrote = 0;
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    {
+        ssize_t n = sendWithFd(channel_->fd(), data.data(), data.size(), fd);
+        recordWrite(n);
+        if (n >= 0)
+        {
+            ::close(fd);
+            recentBytes_ += n;
+            nwrote = n;
+            if (nwrote == data.size())
+            {
+                if (writeCompleteCallback_)
+                {
+                    loop->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                }
+                return;
+            }
+            fd = -1;
+        }
+        else if (errno != EWOULDBLOCK)
+        {
+            LOG_ERROR("TcpConnection::sendFdInLoop");
+            ::close(fd);
+            return;
+        }
+    }
+
+    if (fd >= 0)
+    {
+        pendingFds_.push_back(std::make_pair(outputBuffer_.readableBytes(), fd));
+    }
+    if (ioCounters_ && outputBuffer_.readableBytes() == 0)
+    {
+        outputQueuedNanos_ = Timestamp::monotonicNanos();
+    }
+    outputBuffer_.append(data.data() + nwrote, data.size() - nwrote);
+    loop->metrics().outputBacklog += data.size() - nwrote;
+    if (!channel_->isWriting())
+    {
+        channel_->enableWriting();
+    }
+}
+
+int TcpConnection::takeReceivedFd()
+{
+    if (receivedFds_.empty())
+    {
+        return -1;
+    }
+    int fd = receivedFds_.front();
+    receivedFds_.pop_front();
+    return fd;
+}
+
+// 有排队的fd时，先写到fd所在的位置为止，再用sendmsg把fd和它之后的数据一起发出，不越过下一个fd的位置
+ssize_t TcpConnection::writeWithPendingFd(int *saveErrno)
+{
+    std::pair<size_t, int> &next = pendingFds_.front();
+    ssize_t n;
+    if (next.first > 0)
+    {
+        n = ::write(channel_->fd(), outputBuffer_.peek(), next.first);
+    }
+    else
+    {
+        size_t len = pendingFds_.size() > 1 ? pendingFds_[1].first : outputBuffer_.readableBytes();
+        n = sendWithFd(channel_->fd(), outputBuffer_.peek(), len, next.second);
+        if (n >= 0)
+        {
+            ::close(next.second);
+            pendingFds_.pop_front();
+        }
+    }
+
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+    for (auto &pending : pendingFds_)
+    {
+        pending.first -= n;
+    }
+    return n;
+}
+
 // 关闭连接
 void TcpConnection::shutdown()
 {
     if (state_ == kConnected)
     {
-        setState(kConnecting);
-        loop_->runInLoop(
-            std::bind(&TcpConnection::shutdownInLoop, this)
+        setState(kDisconnecting);
+        getLoop()->runInLoop(
+            std::bind(&TcpConnection::shutdownInLoop, shared_from_this())
+        );
+    }
+}
+
+// 不等待对端关闭，直接关闭连接，未发送完的数据被丢弃
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        getLoop()->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this())
         );
     }
 }
+
+void TcpConnection::forceCloseInLoop()
+{
+    EventLoop *loop = getLoop();
+    if (!loop->isInLoopThread())
+    {
+        loop->runInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        return;
+    }
+
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
 void TcpConnection::shutdownInLoop()
 {
+    // 排队期间连接被迁移到了其他loop，排在迁移前发送的数据之后关闭写端
+    EventLoop *loop = getLoop();
+    if (!loop->isInLoopThread())
+    {
+        loop->runInLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+        return;
+    }
+
     if (!channel_->isWriting()) // 说明outputBuffer中的数据已经全部发送完成
     {
         socket_->shutdownWrite();   // 关闭写端
@@ -179,7 +437,10 @@ void TcpConnection::connectEstablished()
     channel_->enableReading();  // 向poller注册channel的epollin事件
 
     // 新连接建立，执行回调
-    connetionCallback_(shared_from_this());
+    if (connetionCallback_)
+    {
+        connetionCallback_(shared_from_this());
+    }
 }
 // 连接销毁
 void TcpConnection::connectDestroyed()
@@ -188,18 +449,165 @@ void TcpConnection::connectDestroyed()
     {
         setState(kDisconnected);
         channel_->disableAll(); // 把channel的所有感兴趣的事件，从poller中del掉
-        connetionCallback_(shared_from_this());
+        if (connetionCallback_)
+        {
+            connetionCallback_(shared_from_this());
+        }
     }
     channel_->remove(); // 把channel从poller中删除掉
+    // 没发出去的数据不会再发送，从所在loop的积压字节数中扣除
+    getLoop()->metrics().outputBacklog -= outputBuffer_.readableBytes();
+    outputBuffer_.retrieveAll();
 }
 
 
+// 把连接迁移到另一个loop上
+void TcpConnection::moveToLoop(EventLoop *newLoop)
+{
+    // 总是排队执行，避免在当前channel的事件回调中销毁channel
+    migrating_ = true;
+    getLoop()->queueInLoop(
+        std::bind(&TcpConnection::detachInLoop, shared_from_this(), newLoop)
+    );
+}
+
+/*
+ * 在旧loop中把channel从poller上摘下来，然后在新loop上重建channel
+ * 摘下之后内核缓冲区中的数据会暂存在socket中，outputBuffer_中未发送的数据随连接一起迁移
+ * 新的channel建好之后才以release方式发布loop_，新loop线程通过getLoop()看到新loop_时，channel_和outputBuffer_已经就绪；
+ * 新loop中先于attachInLoop执行的send会直接写socket或注册写事件，旧loop中排在迁移之后的send/shutdown会按原顺序转发到新loop
+ */
+void TcpConnection::detachInLoop(EventLoop *newLoop)
+{
+    EventLoop *oldLoop = getLoop();
+    // 被TcpRelay接管的连接和对端连接必须在同一个loop上，不参与迁移，记下拒绝让调用者不再重试
+    if (relayReadCallback_)
+    {
+        migrationRefused_ = true;
+    }
+    if (state_ == kDisconnected || newLoop == oldLoop || relayReadCallback_)
+    {
+        migrating_ = false;
+        return;
+    }
+
+    LOG_INFO("TcpConnection::moveToLoop [%s] fd=%d from loop %p to loop %p \n",
+             name_.c_str(), channel_->fd(), oldLoop, newLoop);
+
+    channel_->disableAll();
+    channel_->remove();
+
+    // 随连接迁移的待发送数据在attachInLoop中计入新loop
+    migratedBacklog_ = outputBuffer_.readableBytes();
+    oldLoop->metrics().outputBacklog -= migratedBacklog_;
+    setupChannel(newLoop, socket_->fd());
+    channel_->tie(shared_from_this());
+    loop_.store(newLoop, std::memory_order_release);
+    newLoop->queueInLoop(std::bind(&TcpConnection::attachInLoop, shared_from_this()));
+}
+
+// 在新loop中重新注册channel感兴趣的事件
+void TcpConnection::attachInLoop()
+{
+    migrating_ = false;
+    getLoop()->metrics().outputBacklog += migratedBacklog_;
+    migratedBacklog_ = 0;
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    if (reading_ && !channel_->isReading())
+    {
+        channel_->enableReading();
+    }
+    if (outputBuffer_.readableBytes() > 0 && !channel_->isWriting())
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::setKernelTimestamp(bool on)
+{
+    socket_->setReceiveTimestamp(on);
+    kernelTimestamp_ = on;
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::setStatsEnabled(bool on)
+{
+    if (on && !ioCounters_)
+    {
+        ioCounters_.reset(new IoCounters);
+        outputQueuedNanos_ = Timestamp::monotonicNanos();
+    }
+    else if (!on)
+    {
+        ioCounters_.reset();
+    }
+}
+
+// 所在loop的计数总是记录，开启统计时再记入连接自己的计数和ConnectionStats
+void TcpConnection::recordWrite(ssize_t n)
+{
+    EventLoop *loop = getLoop();
+    IoCounters &io = loop->metrics().io;
+    ++io.writeCalls;
+    if (n > 0)
+    {
+        io.bytesWritten += n;
+    }
+    if (ioCounters_)
+    {
+        ++ioCounters_->writeCalls;
+        if (n > 0)
+        {
+            ioCounters_->bytesWritten += n;
+        }
+        loop->connectionStats()->recordWrite(n);
+    }
+}
+
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    // 被TcpRelay接管后，数据由TcpRelay直接从socket读走
+    if (relayReadCallback_)
+    {
+        relayReadCallback_();
+        return;
+    }
+
     int saveErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    // 开启内核时间戳时，用内核收到数据的时间替换epoll_wait返回的时间；传递fd时同样需要recvmsg
+    ssize_t n = (kernelTimestamp_ || passFd_)
+                    ? inputBuffer_.readFd(channel_->fd(), &saveErrno, &receiveTime,
+                                          passFd_ ? &receivedFds_ : nullptr)
+                    : inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    // 和写路径、loop的统计一致，每次系统调用都计数，返回EAGAIN和EOF的读也算在内
+    IoCounters &io = getLoop()->metrics().io;
+    ++io.readCalls;
+    if (ioCounters_)
+    {
+        ++ioCounters_->readCalls;
+    }
     if (n > 0)
     {
+        io.bytesRead += n;
+        recentBytes_ += n;
+        if (ioCounters_)
+        {
+            ioCounters_->bytesRead += n;
+            // 回调中可能迁移连接，统计记在回调开始时所在的loop上
+            EventLoop *loop = getLoop();
+            int64_t callbackStart = Timestamp::monotonicNanos();
+            loop->connectionStats()->recordRead(n, callbackStart - loop->pollReturnNanos());
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            loop->connectionStats()->recordCallback(Timestamp::monotonicNanos() - callbackStart);
+            return;
+        }
         // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
     }
@@ -207,6 +615,12 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     {
         handleClose();
     }
+    else if (saveErrno == EMSGSIZE)
+    {
+        // 控制消息被截断，后续的数据和fd无法再对应，直接关闭连接
+        LOG_ERROR("TcpConnection::handleRead [%s] - control message truncated, closing", name_.c_str());
+        handleClose();
+    }
     else
     {
         errno = saveErrno;
@@ -217,24 +631,45 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 // 发送缓冲区未发送完。写到一半，没写完，仍需继续写时，回调
 void TcpConnection::handleWrite()
 {
+    // outputBuffer_中的数据先发送，发送完之后再交给TcpRelay
+    if (relayWriteCallback_ && outputBuffer_.readableBytes() == 0)
+    {
+        relayWriteCallback_();
+        return;
+    }
+
     if (channel_->isWriting())
     {
+        TraceSpan span("handleWrite", "bytes");
         int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        ssize_t n = pendingFds_.empty() ? outputBuffer_.writeFd(channel_->fd(), &saveErrno)
+                                        : writeWithPendingFd(&saveErrno);
+        span.setArg(n);
+        recordWrite(n);
         if (n > 0)
         {
             outputBuffer_.retrieve(n);
+            getLoop()->metrics().outputBacklog -= n;
+            recentBytes_ += n;
             if (outputBuffer_.readableBytes() == 0) // 若已写完，则关闭写监听writeEvent
             {
                 channel_->disableWriting();
+                if (ioCounters_)
+                {
+                    getLoop()->connectionStats()->recordFlush(Timestamp::monotonicNanos() - outputQueuedNanos_);
+                }
 
                 if (writeCompleteCallback_)
                 {
                     // 唤醒loop, 对应的thread线程，执行写完回调
-                    loop_->queueInLoop(
+                    getLoop()->queueInLoop(
                         std::bind(writeCompleteCallback_, this->shared_from_this())
                     );
                 }
+                if (relayWriteCallback_)
+                {
+                    relayWriteCallback_(); // 继续发送TcpRelay中积压的数据
+                }
                 if (state_ == kDisconnecting)
                 {
                     shutdownInLoop();
@@ -259,7 +694,10 @@ void TcpConnection::handleClose()
     channel_->disableAll();
 
     TcpConnectionPtr guardThis(this->shared_from_this());
-    connetionCallback_(guardThis);  // 执行连接关闭的回调
+    if (connetionCallback_)
+    {
+        connetionCallback_(guardThis);  // 执行连接关闭的回调
+    }
     closeCallback_(guardThis);      // 关闭连接的回调   执行的是TcpServer::removeConnection()
 }
 void TcpConnection::handleError()
@@ -5,10 +5,13 @@
 #include "Callbacks.h"
 #include "Timestamp.h"
 #include "Buffer.h"
+#include "ConnectionStats.h"
 
 #include <memory>
 #include <atomic>
 #include <functional>
+#include <deque>
+#include <utility>
 
 class Channel;
 class EventLoop;
@@ -25,7 +28,7 @@ public:
                   const InetAddress& peerAddr);
     ~TcpConnection();
 
-    EventLoop* getLoop() const { return loop_; }
+    EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
     const std::string& name() const { return name_; }
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
@@ -37,8 +40,43 @@ public:
     void send(const void* data, int len);
     // 发送数据
     void send(const std::string &buf);
+    // 发送buf中的全部可读数据并清空buf，loop线程中调用时不拷贝到临时的string
+    void send(Buffer *buf);
     // 关闭连接
     void shutdown();
+    // 立即关闭连接，不等待输出缓冲区发送完
+    void forceClose();
+
+    // 把连接迁移到另一个loop上，Channel、缓冲区和回调都随连接一起迁移，不丢字节也不打乱写入顺序
+    void moveToLoop(EventLoop *newLoop);
+    // 迁移是否仍在进行中
+    bool migrating() const { return migrating_; }
+    // 迁移是否被拒绝过(连接被TcpRelay接管，必须和对端留在同一个loop上)，此后不应再尝试迁移
+    bool migrationRefused() const { return migrationRefused_; }
+    // 取出并清零上次调用以来收发的字节数，用于衡量连接的活跃程度
+    uint64_t takeRecentBytes() { return recentBytes_.exchange(0); }
+    // 开启后MessageCallback收到的是内核收到数据的时间，而不是epoll_wait返回的时间
+    // 一次读到多个分段时是最后一个分段到达的时间，与epoll_wait返回的时间之差是排队时间的下限，需在connectEstablished之前调用
+    void setKernelTimestamp(bool on);
+    // 关闭Nagle算法，应答分几次写出时后面的小段不用等前一段的ACK
+    void setTcpNoDelay(bool on);
+    // 开启后记录本连接的收发字节数和系统调用次数，并把读到回调的延迟、回调耗时、输出排队时间
+    // 记入所在loop的ConnectionStats；需在loop线程中或connectEstablished之前调用
+    void setStatsEnabled(bool on);
+    // 未开启统计时返回nullptr，只在loop线程中读取
+    const IoCounters* ioCounters() const { return ioCounters_.get(); }
+
+    // Unix域连接上传递fd(SCM_RIGHTS)
+    // 开启后用recvmsg读取，收到的fd暂存在连接中，需在connectEstablished之前调用
+    void setPassFd(bool on) { passFd_ = on; }
+    // 把fd随data的第一个字节一起发给对端，调用时会dup一份，调用者仍需自己关闭fd；data不能为空
+    void sendFd(int fd, const std::string &data);
+    // 取出一个收到的fd，没有时返回-1，调用者负责关闭，需在loop线程中调用(一般在MessageCallback中)
+    int takeReceivedFd();
+
+    // 上层协议(例如HttpServer)挂在连接上的状态，只在loop线程中访问
+    void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+    const std::shared_ptr<void>& getContext() const { return context_; }
 
     void setConnectionCallback(const ConnectionCallback& cb)
     { connetionCallback_ = cb; }
@@ -56,6 +94,7 @@ public:
     // 连接销毁
     void connectDestroyed();
 private:
+    friend class TcpRelay;
     enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
     
     void handleRead(Timestamp receiveTime);
@@ -64,12 +103,20 @@ private:
     void handleError();
 
     void sendInLoop(const void* data, size_t len);
+    void sendStringInLoop(const std::string &message);
+    void sendFdInLoop(int fd, const std::string &data);
+    ssize_t writeWithPendingFd(int *saveErrno);
+    void recordWrite(ssize_t n);
+    void setupChannel(EventLoop *loop, int sockfd);
+    void detachInLoop(EventLoop *newLoop);
+    void attachInLoop();
     void setState(StateE s) { state_ = s; }
     void shutdownInLoop();
+    void forceCloseInLoop();
 
     const char* stateToString() const;
 
-    EventLoop* loop_;   // 这里不是baseLoop，因为TcpConnection都是在subLoop里面管理的
+    std::atomic<EventLoop*> loop_;   // 这里不是baseLoop，因为TcpConnection都是在subLoop里面管理的，迁移时会被其他线程读取
     const std::string name_;
     std::atomic_int state_;
     bool reading_;
@@ -88,6 +135,26 @@ private:
     CloseCallback closeCallback_;
     size_t highWaterMark_;
 
+    std::atomic_bool migrating_;
+    std::atomic_bool migrationRefused_;
+    std::atomic<uint64_t> recentBytes_; // 最近收发的字节数，负载均衡时用来挑选迁移的连接
+    bool kernelTimestamp_;              // 是否用内核的接收时间戳作为MessageCallback的时间
+    bool passFd_;                       // 是否接收对端传来的fd
+
+    std::deque<int> receivedFds_;       // 收到但还没被取走的fd
+    // 等待发送的fd(已dup)，first是它要随outputBuffer_中哪个字节发出，为相对可读位置的偏移
+    std::deque<std::pair<size_t, int>> pendingFds_;
+
+    // 被TcpRelay接管时，socket的读写事件交给TcpRelay处理，只在loop线程中访问
+    std::function<void()> relayReadCallback_;
+    std::function<void()> relayWriteCallback_;
+
+    std::shared_ptr<void> context_;
+
+    std::unique_ptr<IoCounters> ioCounters_;    // 开启统计时才分配
+    int64_t outputQueuedNanos_;                 // outputBuffer_从空变为非空的时刻
+    size_t migratedBacklog_;                    // 迁移时outputBuffer_中待发送的字节数
+
     Buffer inputBuffer_;
     Buffer outputBuffer_;
 };
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include "TcpRelay.h"
+#include "TcpConnection.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+TcpRelay::TcpRelay(const TcpConnectionPtr &first, const TcpConnectionPtr &second, int pipeSize)
+    : loop_(first->getLoop())
+    , pipeSize_(pipeSize)
+    , spliced_(false)
+    , closing_(false)
+{
+    conns_[0] = first;
+    conns_[1] = second;
+    for (int i = 0; i < 2; ++i)
+    {
+        dirs_[i].pipefd[0] = -1;
+        dirs_[i].pipefd[1] = -1;
+        dirs_[i].pending = 0;
+        dirs_[i].eof = false;
+        dirs_[i].shutdown = false;
+        bytes_[i] = 0;
+    }
+}
+
+TcpRelay::~TcpRelay()
+{
+    for (Direction &d : dirs_)
+    {
+        for (int fd : d.pipefd)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+    }
+}
+
+void TcpRelay::start()
+{
+    loop_->runInLoop(std::bind(&TcpRelay::startInLoop, shared_from_this()));
+}
+
+// 创建pipe，接管两个连接的读写事件，再把连接上已经读入Buffer的数据转发出去
+void TcpRelay::startInLoop()
+{
+    TcpConnectionPtr conns[2] = {conns_[0].lock(), conns_[1].lock()};
+    if (!conns[0] || !conns[1] || !conns[0]->connected() || !conns[1]->connected()
+        || conns[0]->getLoop() != loop_ || conns[1]->getLoop() != loop_)
+    {
+        LOG_ERROR("TcpRelay::startInLoop - connections must be connected and on the same loop");
+        closeBoth();
+        return;
+    }
+
+    spliced_ = true;
+    for (Direction &d : dirs_)
+    {
+        if (::pipe2(d.pipefd, O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            LOG_ERROR("TcpRelay::startInLoop pipe2 error:%d, fall back to copying", errno);
+            spliced_ = false;
+            break;
+        }
+        ::fcntl(d.pipefd[1], F_SETPIPE_SZ, pipeSize_);
+    }
+
+    std::shared_ptr<TcpRelay> self(shared_from_this());
+    for (int i = 0; i < 2; ++i)
+    {
+        TcpConnection *conn = conns[i].get();
+        // conns[i]是方向i的源端，方向1 - i的目的端
+        conn->relayReadCallback_ = std::bind(&TcpRelay::handleReadable, self, i);
+        conn->relayWriteCallback_ = std::bind(&TcpRelay::handleWritable, self, 1 - i);
+        conn->closeCallback_ = std::bind(&TcpRelay::handleClose, self,
+                                         std::placeholders::_1, conn->closeCallback_);
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        TcpConnection *src = conns[i].get();
+        TcpConnection *dst = conns[1 - i].get();
+        size_t readable = src->inputBuffer_.readableBytes();
+        if (readable > 0)
+        {
+            dst->sendInLoop(src->inputBuffer_.peek(), readable);
+            src->inputBuffer_.retrieveAll();
+            bytes_[i] += readable;
+        }
+        if (!src->channel_->isReading())
+        {
+            src->channel_->enableReading();
+        }
+    }
+}
+
+void TcpRelay::handleReadable(int i)
+{
+    if (closing_)
+    {
+        return;
+    }
+    if (!spliced_)
+    {
+        copyReadable(i);
+        return;
+    }
+
+    TcpConnectionPtr src = conns_[i].lock();
+    Direction &d = dirs_[i];
+    if (src && d.pending == 0 && !d.eof)
+    {
+        ssize_t n = ::splice(src->channel_->fd(), nullptr, d.pipefd[1], nullptr, pipeSize_,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            d.pending += n;
+        }
+        else if (n == 0)
+        {
+            d.eof = true;
+        }
+        else if (errno == EINVAL && dirs_[1 - i].pending == 0)
+        {
+            // socket不支持splice，两个pipe中都没有积压数据时可以直接改为拷贝转发
+            LOG_ERROR("TcpRelay splice not supported, fall back to copying");
+            spliced_ = false;
+            copyReadable(i);
+            return;
+        }
+        else if (errno != EAGAIN && errno != EINTR)
+        {
+            LOG_ERROR("TcpRelay::handleReadable splice error:%d", errno);
+            closeBoth();
+            return;
+        }
+    }
+    flush(i);
+}
+
+// 目的端可写，或者目的端outputBuffer中的数据已经发送完
+void TcpRelay::handleWritable(int i)
+{
+    if (closing_)
+    {
+        return;
+    }
+    if (spliced_)
+    {
+        flush(i);
+        return;
+    }
+
+    // 拷贝转发时，目的端发送完之后恢复读源端
+    TcpConnectionPtr src = conns_[i].lock();
+    TcpConnectionPtr dst = conns_[1 - i].lock();
+    if (!src || !dst)
+    {
+        return;
+    }
+    if (dst->channel_->isWriting() && dst->outputBuffer_.readableBytes() == 0)
+    {
+        dst->channel_->disableWriting();
+    }
+    if (dirs_[i].eof)
+    {
+        finishDirection(i);
+    }
+    else if (!src->channel_->isReading())
+    {
+        src->channel_->enableReading();
+    }
+}
+
+void TcpRelay::flush(int i)
+{
+    TcpConnectionPtr src = conns_[i].lock();
+    TcpConnectionPtr dst = conns_[1 - i].lock();
+    if (!src || !dst)
+    {
+        return;
+    }
+
+    Direction &d = dirs_[i];
+    // 目的端outputBuffer中还有数据时先等它发送完，保证顺序
+    while (d.pending > 0 && dst->outputBuffer_.readableBytes() == 0)
+    {
+        ssize_t n = ::splice(d.pipefd[0], nullptr, dst->channel_->fd(), nullptr, d.pending,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            d.pending -= n;
+            bytes_[i] += n;
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            break;
+        }
+        else
+        {
+            LOG_ERROR("TcpRelay::flush splice error:%d", errno);
+            closeBoth();
+            return;
+        }
+    }
+
+    Channel *srcChannel = src->channel_.get();
+    Channel *dstChannel = dst->channel_.get();
+    if (d.pending > 0)
+    {
+        // 目的端写不动，停止读源端，让TCP的流量控制把压力传回源端的对端
+        if (!dstChannel->isWriting())
+        {
+            dstChannel->enableWriting();
+        }
+        if (srcChannel->isReading())
+        {
+            srcChannel->disableReading();
+        }
+    }
+    else
+    {
+        if (dstChannel->isWriting() && dst->outputBuffer_.readableBytes() == 0)
+        {
+            dstChannel->disableWriting();
+        }
+        if (d.eof)
+        {
+            finishDirection(i);
+        }
+        else if (!srcChannel->isReading())
+        {
+            srcChannel->enableReading();
+        }
+    }
+}
+
+// 拷贝转发：读入源端的Buffer，再追加到目的端
+void TcpRelay::copyReadable(int i)
+{
+    TcpConnectionPtr src = conns_[i].lock();
+    TcpConnectionPtr dst = conns_[1 - i].lock();
+    if (!src || !dst || dirs_[i].eof)
+    {
+        return;
+    }
+
+    int saveErrno = 0;
+    ssize_t n = src->inputBuffer_.readFd(src->channel_->fd(), &saveErrno);
+    if (n > 0)
+    {
+        bytes_[i] += n;
+        dst->sendInLoop(src->inputBuffer_.peek(), src->inputBuffer_.readableBytes());
+        src->inputBuffer_.retrieveAll();
+        if (dst->outputBuffer_.readableBytes() > static_cast<size_t>(pipeSize_))
+        {
+            src->channel_->disableReading();
+        }
+    }
+    else if (n == 0)
+    {
+        dirs_[i].eof = true;
+        finishDirection(i);
+    }
+    else if (saveErrno != EAGAIN && saveErrno != EINTR)
+    {
+        LOG_ERROR("TcpRelay::copyReadable read error:%d", saveErrno);
+        closeBoth();
+    }
+}
+
+// 源端读到EOF且数据都已转发，关闭目的端的写端；两个方向都结束且数据发送完之后关闭两个连接
+void TcpRelay::finishDirection(int i)
+{
+    TcpConnectionPtr src = conns_[i].lock();
+    TcpConnectionPtr dst = conns_[1 - i].lock();
+    if (!src || !dst)
+    {
+        return;
+    }
+
+    Direction &d = dirs_[i];
+    if (!d.shutdown)
+    {
+        d.shutdown = true;
+        if (src->channel_->isReading())
+        {
+            src->channel_->disableReading();
+        }
+        dst->shutdown();
+    }
+
+    if (dirs_[1 - i].shutdown
+        && src->outputBuffer_.readableBytes() == 0
+        && dst->outputBuffer_.readableBytes() == 0)
+    {
+        closeBoth();
+    }
+}
+
+// 一个连接断开，另一个连接也随之关闭
+void TcpRelay::handleClose(const TcpConnectionPtr &conn, const CloseCallback &original)
+{
+    conn->relayReadCallback_ = nullptr;
+    conn->relayWriteCallback_ = nullptr;
+    if (original)
+    {
+        original(conn);
+    }
+    closeBoth();
+}
+
+void TcpRelay::closeBoth()
+{
+    closing_ = true;
+    for (std::weak_ptr<TcpConnection> &weak : conns_)
+    {
+        TcpConnectionPtr conn = weak.lock();
+        if (conn)
+        {
+            conn->forceClose();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+
+class EventLoop;
+
+/*
+ * 在两个TcpConnection之间双向转发数据，用于四层代理
+ * 每个方向一对pipe，用splice(2)把数据从一个socket搬到pipe再搬到另一个socket，数据不经过用户态；
+ * pipe中有积压时停止读源端，实现背压；一端读到EOF后，积压的数据发送完再关闭另一端的写端(半关闭)，
+ * 两个方向都关闭之后关闭两个连接，其中一个连接断开时另一个连接也随之关闭
+ * 创建pipe失败或者socket不支持splice时，退化为经过Buffer的拷贝转发
+ *
+ * 两个连接必须属于同一个EventLoop，转发期间不会被负载均衡迁移
+ *
+ * std::make_shared<TcpRelay>(clientConn, upstreamConn)->start();
+ */
+class TcpRelay : noncopyable,
+                 public std::enable_shared_from_this<TcpRelay>
+{
+public:
+    TcpRelay(const TcpConnectionPtr &first, const TcpConnectionPtr &second, int pipeSize = 64 * 1024);
+    ~TcpRelay();
+
+    // 开始转发，可以在任意线程调用；连接上已经读入Buffer但还未处理的数据会先转发出去
+    void start();
+
+    // 是否在用splice转发，否则是拷贝转发
+    bool spliced() const { return spliced_; }
+    // 两个方向累计转发的字节数
+    uint64_t bytesRelayed() const { return bytes_[0] + bytes_[1]; }
+
+private:
+    // 一个方向：从conns_[i]读，写到conns_[1 - i]
+    struct Direction
+    {
+        int pipefd[2];
+        size_t pending; // pipe中积压的字节数
+        bool eof;       // 源端已经读到EOF
+        bool shutdown;  // 已经关闭目的端的写端
+    };
+
+    void startInLoop();
+    void handleReadable(int i);
+    void handleWritable(int i);
+    // 把pipe中积压的数据写到目的端，并根据积压情况开关源端的读事件
+    void flush(int i);
+    void copyReadable(int i);
+    void finishDirection(int i);
+    void handleClose(const TcpConnectionPtr &conn, const CloseCallback &original);
+    void closeBoth();
+
+    EventLoop *loop_;
+    std::weak_ptr<TcpConnection> conns_[2];
+    Direction dirs_[2];
+    const int pipeSize_;
+    bool spliced_;
+    bool closing_;
+    std::atomic<uint64_t> bytes_[2];
+};
@@ -2,8 +2,12 @@
 #include "Logger.h"
 #include "Socket.h"
 #include "TcpConnection.h"
+#include "Tracer.h"
 
 #include <functional>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
 
 static EventLoop* CheckLoopNotNull(EventLoop *loop)
 {
@@ -18,15 +22,47 @@ TcpServer::TcpServer(EventLoop *loop,
               const InetAddress &listenAddr,
               const std::string &nameArg,
               Option option)
-              : loop_(CheckLoopNotNull(loop))
-              , ipPort_(listenAddr.toIpPort())
+              : TcpServer(loop,
+                          new Acceptor(CheckLoopNotNull(loop), listenAddr, option == kReusePort),
+                          listenAddr.toIpPort(),
+                          nameArg,
+                          false)
+{
+}
+
+TcpServer::TcpServer(EventLoop *loop,
+              const UnixAddress &listenAddr,
+              const std::string &nameArg)
+              : TcpServer(loop,
+                          new Acceptor(CheckLoopNotNull(loop), listenAddr),
+                          listenAddr.toPath(),
+                          nameArg,
+                          true)
+{
+}
+
+TcpServer::TcpServer(EventLoop *loop,
+              Acceptor *acceptor,
+              const std::string &ipPort,
+              const std::string &nameArg,
+              bool unixDomain)
+              : loop_(loop)
+              , ipPort_(ipPort)
               , name_(nameArg)
-              , acceptor_(new Acceptor(loop, listenAddr, option == kReusePort))
+              , unixDomain_(unixDomain)
+              , acceptor_(acceptor)
               , threadPool_(new EventLoopThreadPool(loop, name_))
+              , computePool_(new ComputeThreadPool(name_ + "-compute"))
               , connetionCallback_()
               , messageCallback_()
-              , nextConnId_(1)
               , started_(0)
+              , nextConnId_(1)
+              , kernelTimestamp_(false)
+              , connectionStats_(false)
+              , rebalanceRunning_(false)
+              , rebalanceInterval_(0)
+              , rebalanceThreshold_(0)
+              , lifetimeToken_(std::make_shared<int>(0))
 {
     // 当有新用户连接时，会执行TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
@@ -35,6 +71,17 @@ TcpServer::TcpServer(EventLoop *loop,
 
 TcpServer::~TcpServer()
 {
+    if (rebalanceThread_)
+    {
+        {
+            std::unique_lock<std::mutex> lock(rebalanceMutex_);
+            rebalanceRunning_ = false;
+        }
+        rebalanceCond_.notify_one();
+        rebalanceThread_->join();
+    }
+    lifetimeToken_.reset();
+
     for (auto &item : connections_)
     {
         // 这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源了
@@ -51,7 +98,102 @@ TcpServer::~TcpServer()
 // 设置底层subLoop的个数
 void TcpServer::setThreadNum(int numThreads)
 {
-    threadPool_->setThreadNum(numThreads);
+    if (started_ > 0)
+    {
+        loop_->runInLoop(std::bind(&TcpServer::resizeThreadPoolInLoop, this, numThreads));
+    }
+    else
+    {
+        threadPool_->setThreadNum(numThreads);
+    }
+}
+
+// 运行时扩缩容
+void TcpServer::resizeThreadPoolInLoop(int numThreads)
+{
+    int current = threadPool_->numThreads();
+    LOG_INFO("TcpServer::resizeThreadPool [%s] - %d => %d loops\n", name_.c_str(), current, numThreads);
+    if (numThreads > current)
+    {
+        threadPool_->addThreads(numThreads - current);
+        return;
+    }
+
+    // 被摘下的loop不再分配新连接，其上已有的连接迁移到剩余的loop
+    for (auto &thread : threadPool_->retireThreads(current - numThreads))
+    {
+        EventLoop *retiredLoop = thread->loop();
+        retiringThreads_[retiredLoop] = std::move(thread);
+        lastBusyMicros_.erase(retiredLoop);
+        finishRetireInLoop(retiredLoop);
+    }
+}
+
+/*
+ * 迁出retiredLoop上所有的连接，再往retiredLoop排队一个回调，
+ * 该回调执行时，之前排队的迁出操作都已执行完，通知baseLoop再次检查
+ * 直到没有连接留在retiredLoop上，也没有正在进行中的迁移，才回收该loop线程
+ * 拒绝迁移的连接(被TcpRelay接管)无法离开retiredLoop，直接关闭，TcpRelay会随之关闭对端连接
+ */
+void TcpServer::finishRetireInLoop(EventLoop *retiredLoop)
+{
+    bool pending = false;
+    for (auto &item : connections_)
+    {
+        const TcpConnectionPtr &conn = item.second;
+        if (conn->getLoop() == retiredLoop)
+        {
+            if (conn->migrationRefused())
+            {
+                conn->forceClose();
+            }
+            else
+            {
+                conn->moveToLoop(threadPool_->getNextLoop());
+            }
+            pending = true;
+        }
+        else if (conn->migrating())
+        {
+            pending = true;
+        }
+    }
+
+    if (pending)
+    {
+        retiredLoop->queueInLoop(std::bind(&TcpServer::retireDrained, loop_,
+                                           std::weak_ptr<void>(lifetimeToken_), this, retiredLoop));
+    }
+    else
+    {
+        LOG_INFO("TcpServer::finishRetire [%s] - loop %p drained\n", name_.c_str(), retiredLoop);
+        retiringThreads_.erase(retiredLoop); // quit并join该loop线程
+    }
+}
+
+// 在retiredLoop中执行，回到baseLoop继续检查
+void TcpServer::retireDrained(EventLoop *baseLoop, const std::weak_ptr<void> &token,
+                              TcpServer *server, EventLoop *retiredLoop)
+{
+    baseLoop->queueInLoop([token, server, retiredLoop]() {
+        if (token.lock())
+        {
+            server->finishRetireInLoop(retiredLoop);
+        }
+    });
+}
+
+// 设置计算线程池的线程数量，0表示不启用
+void TcpServer::setComputeThreadNum(int numThreads)
+{
+    computePool_->setThreadNum(numThreads);
+}
+
+// 开启自动负载均衡，需在start之前调用
+void TcpServer::enableRebalance(double intervalSeconds, double imbalanceThreshold)
+{
+    rebalanceInterval_ = intervalSeconds;
+    rebalanceThreshold_ = imbalanceThreshold;
 }
 
 // 开启服务器监听   loop.loop()
@@ -62,7 +204,20 @@ void TcpServer::start()
     {
         
         threadPool_->start(threadInitCallback_);    // 启动底层的loop线程池
+        computePool_->start();                      // 启动计算线程池，线程数为0时不启动
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (metricsServer_)
+        {
+            metricsServer_->start();
+        }
+
+        if (rebalanceInterval_ > 0)
+        {
+            rebalanceRunning_ = true;
+            rebalanceThread_.reset(new Thread(std::bind(&TcpServer::rebalanceThreadFunc, this),
+                                              name_ + "-rebalance"));
+            rebalanceThread_->start();
+        }
     }
 }
 
@@ -72,7 +227,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 
     // 轮询算法，选择一个subLoop，来管理channel
     EventLoop* ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
+    char buf[160] = {0};
     snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
     ++nextConnId_;  // 由于限制了只存在一个loop运行TcpServer，所以不会出现多线程问题，不需要使用原子变量
     std::string connName = name_ + buf;
@@ -80,7 +235,8 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s"
             , name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
     
-    InetAddress localAddr(Socket::getLocalAddr(sockfd));
+    // Unix域socket没有IP地址，localAddr和peerAddr都保持默认值
+    InetAddress localAddr = unixDomain_ ? InetAddress() : InetAddress(Socket::getLocalAddr(sockfd));
 
     // 根据连接成功的sockfd，创建TcpConnection连接对象
     TcpConnectionPtr conn(new TcpConnection(
@@ -95,6 +251,18 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     conn->setConnectionCallback(connetionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (kernelTimestamp_)
+    {
+        conn->setKernelTimestamp(true);
+    }
+    if (unixDomain_)
+    {
+        conn->setPassFd(true);
+    }
+    if (connectionStats_)
+    {
+        conn->setStatsEnabled(true);
+    }
 
     // 设置了如何关闭连接的回调     conn->shutDown()
     conn->setCloseCallback(
@@ -119,4 +287,411 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn)
     );
-}
\ No newline at end of file
+}
+
+void TcpServer::collectConnectionStats(const ConnectionStatsCallback &cb)
+{
+    // 线程池可能正在扩缩容，loop列表只能在baseLoop中读取
+    loop_->runInLoop(std::bind(&TcpServer::collectConnectionStatsInLoop, this, cb));
+}
+
+namespace
+{
+struct StatsCollector
+{
+    std::mutex mutex;
+    ConnectionStats merged;
+    size_t remaining;
+};
+} // namespace
+
+void TcpServer::collectConnectionStatsInLoop(const ConnectionStatsCallback &cb)
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    std::shared_ptr<StatsCollector> collector = std::make_shared<StatsCollector>();
+    collector->remaining = loops.size();
+    EventLoop *baseLoop = loop_;
+    for (EventLoop *loop : loops)
+    {
+        loop->runInLoop([collector, loop, baseLoop, cb]() {
+            {
+                std::unique_lock<std::mutex> lock(collector->mutex);
+                collector->merged.merge(*loop->connectionStats());
+                if (--collector->remaining > 0)
+                {
+                    return;
+                }
+            }
+            baseLoop->runInLoop([collector, cb]() { cb(collector->merged); });
+        });
+    }
+}
+
+void TcpServer::enableMetrics(const InetAddress &listenAddr)
+{
+    metricsServer_.reset(new TcpServer(loop_, listenAddr, name_ + "-metrics"));
+    metricsServer_->setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        onMetricsRequest(conn, buf);
+    });
+}
+
+// 只处理"GET /metrics"和"GET /trace"，应答后关闭连接
+void TcpServer::onMetricsRequest(const TcpConnectionPtr &conn, Buffer *buf)
+{
+    static const char kCRLFCRLF[] = "\r\n\r\n";
+    const char *bufEnd = buf->peek() + buf->readableBytes();
+    if (std::search(buf->peek(), bufEnd, kCRLFCRLF, kCRLFCRLF + 4) == bufEnd)
+    {
+        if (buf->readableBytes() > 8192)
+        {
+            conn->forceClose();
+        }
+        return;
+    }
+    bool found = buf->readableBytes() > 12 && (strncmp(buf->peek(), "GET /metrics", 12) == 0)
+                 && (buf->peek()[12] == ' ' || buf->peek()[12] == '?');
+    bool trace = buf->readableBytes() > 10 && (strncmp(buf->peek(), "GET /trace", 10) == 0)
+                 && (buf->peek()[10] == ' ' || buf->peek()[10] == '?');
+    buf->retrieveAll();
+    if (trace)
+    {
+        // 事件较多时生成JSON需要较长时间，交给计算线程池，不阻塞baseLoop上的accept
+        // 各线程的环形缓冲区可以在任意线程中直接读取，结果回到baseLoop发送；没有计算线程时直接生成
+        auto done = [conn](const std::string &body) {
+            std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: ";
+            response += std::to_string(body.size());
+            response += "\r\nConnection: close\r\n\r\n";
+            response += body;
+            conn->send(response);
+            conn->shutdown();
+        };
+        if (computePool_->numThreads() == 0 || !computePool_->submit(loop_, &Tracer::toJson, done))
+        {
+            done(Tracer::toJson());
+        }
+        return;
+    }
+    if (!found)
+    {
+        conn->send("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        conn->shutdown();
+        return;
+    }
+    collectMetrics([conn](const std::string &body) {
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: ";
+        response += std::to_string(body.size());
+        response += "\r\nConnection: close\r\n\r\n";
+        response += body;
+        conn->send(response);
+        conn->shutdown();
+    });
+}
+
+void TcpServer::collectMetrics(const MetricsCallback &cb)
+{
+    loop_->runInLoop(std::bind(&TcpServer::collectMetricsInLoop, this, cb));
+}
+
+namespace
+{
+struct LoopSnapshot
+{
+    LoopMetrics metrics;
+    uint64_t iterations;
+    int64_t busyMicros;
+    size_t queueSize;
+};
+
+struct MetricsCollector
+{
+    std::mutex mutex;
+    std::vector<LoopSnapshot> loops;
+    ConnectionStats stats;
+    size_t remaining;
+};
+
+void appendHeader(std::string *out, const char *name, const char *type, const char *help)
+{
+    *out += "# HELP mymuduo_";
+    *out += name;
+    *out += " ";
+    *out += help;
+    *out += "\n# TYPE mymuduo_";
+    *out += name;
+    *out += " ";
+    *out += type;
+    *out += "\n";
+}
+
+void appendSample(std::string *out, const char *name, const std::string &labels, const std::string &value)
+{
+    *out += "mymuduo_";
+    *out += name;
+    *out += "{";
+    *out += labels;
+    *out += "} ";
+    *out += value;
+    *out += "\n";
+}
+
+std::string seconds(double nanos)
+{
+    char buf[32];
+    snprintf(buf, sizeof buf, "%.9f", nanos / 1e9);
+    return buf;
+}
+
+// 每个loop一行，标签为loop的序号
+template <typename Getter>
+void appendPerLoop(std::string *out, const std::string &serverLabel, const std::vector<LoopSnapshot> &loops,
+                   const char *name, const char *type, const char *help, Getter get)
+{
+    appendHeader(out, name, type, help);
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        appendSample(out, name, serverLabel + ",loop=\"" + std::to_string(i) + "\"", get(loops[i]));
+    }
+}
+
+void appendSummary(std::string *out, const std::string &serverLabel, const char *name, const char *help,
+                   const Histogram &h)
+{
+    appendHeader(out, name, "summary", help);
+    static const char *kQuantiles[] = { "0.5", "0.9", "0.99", "0.999" };
+    for (const char *q : kQuantiles)
+    {
+        appendSample(out, name, serverLabel + ",quantile=\"" + q + "\"", seconds(h.percentile(atof(q) * 100)));
+    }
+    *out += "mymuduo_" + std::string(name) + "_sum{" + serverLabel + "} " + seconds(h.mean() * h.count()) + "\n";
+    *out += "mymuduo_" + std::string(name) + "_count{" + serverLabel + "} " + std::to_string(h.count()) + "\n";
+}
+// baseLoop中的计数由调用者读取后传入
+std::string renderMetrics(const std::string &name, size_t activeConnections, int totalConnections,
+                          uint64_t acceptErrors, const std::vector<LoopSnapshot> &loops, const ConnectionStats *stats)
+{
+    std::string out;
+    std::string label = "server=\"" + name + "\"";
+
+    appendHeader(&out, "connections_active", "gauge", "Current number of connections.");
+    appendSample(&out, "connections_active", label, std::to_string(activeConnections));
+    appendHeader(&out, "connections_total", "counter", "Connections accepted since start.");
+    appendSample(&out, "connections_total", label, std::to_string(totalConnections));
+    appendHeader(&out, "accept_errors_total", "counter", "Failed accept calls.");
+    appendSample(&out, "accept_errors_total", label, std::to_string(acceptErrors));
+
+    appendPerLoop(&out, label, loops, "loop_iterations_total", "counter", "Event loop iterations.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.iterations); });
+    appendPerLoop(&out, label, loops, "loop_busy_seconds_total", "counter", "Time spent handling events and functors.",
+                  [](const LoopSnapshot &l) { return seconds(l.busyMicros * 1000.0); });
+    appendPerLoop(&out, label, loops, "loop_events_total", "counter", "Active channels returned by poll.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.events); });
+    appendPerLoop(&out, label, loops, "loop_poll_timeouts_total", "counter", "Polls that returned no events.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.pollTimeouts); });
+    appendPerLoop(&out, label, loops, "loop_functors_total", "counter", "Queued functors executed.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.functors); });
+    appendPerLoop(&out, label, loops, "loop_functor_batch_max", "gauge", "Largest number of functors run in one iteration.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.maxFunctorBatch); });
+    appendPerLoop(&out, label, loops, "loop_pending_functors", "gauge", "Functors waiting in the queue at scrape time.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.queueSize); });
+    appendPerLoop(&out, label, loops, "loop_wakeups_total", "counter", "wakeup() calls from other threads.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.wakeups); });
+    appendPerLoop(&out, label, loops, "loop_wakeup_reads_total", "counter", "Times the loop was woken by its eventfd.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.wakeupReads); });
+    appendPerLoop(&out, label, loops, "loop_slow_callbacks_total", "counter", "Callbacks over the LoopWatchdog budget.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.slowCallbacks); });
+    appendPerLoop(&out, label, loops, "bytes_read_total", "counter", "Bytes read from connections.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.io.bytesRead); });
+    appendPerLoop(&out, label, loops, "bytes_written_total", "counter", "Bytes written to connections.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.io.bytesWritten); });
+    appendPerLoop(&out, label, loops, "read_calls_total", "counter", "Read syscalls on connections.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.io.readCalls); });
+    appendPerLoop(&out, label, loops, "write_calls_total", "counter", "Write syscalls on connections.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.io.writeCalls); });
+    appendPerLoop(&out, label, loops, "output_backlog_bytes", "gauge", "Bytes waiting in connection output buffers.",
+                  [](const LoopSnapshot &l) { return std::to_string(l.metrics.outputBacklog); });
+
+    // 性能计数器只在开启了PerfCounters并且至少一个loop能打开时输出
+    bool hardware = false;
+    bool software = false;
+    for (const LoopSnapshot &l : loops)
+    {
+        hardware = hardware || l.metrics.perf.hardware;
+        software = software || l.metrics.perf.software;
+    }
+    if (hardware)
+    {
+        appendPerLoop(&out, label, loops, "loop_cpu_cycles_total", "counter", "CPU cycles spent by the loop thread.",
+                      [](const LoopSnapshot &l) { return std::to_string(l.metrics.perf.cycles); });
+        appendPerLoop(&out, label, loops, "loop_instructions_total", "counter", "Instructions retired by the loop thread.",
+                      [](const LoopSnapshot &l) { return std::to_string(l.metrics.perf.instructions); });
+        appendPerLoop(&out, label, loops, "loop_llc_misses_total", "counter", "Last level cache misses of the loop thread.",
+                      [](const LoopSnapshot &l) { return std::to_string(l.metrics.perf.llcMisses); });
+    }
+    if (software)
+    {
+        appendPerLoop(&out, label, loops, "loop_context_switches_total", "counter", "Context switches of the loop thread.",
+                      [](const LoopSnapshot &l) { return std::to_string(l.metrics.perf.contextSwitches); });
+        appendPerLoop(&out, label, loops, "loop_page_faults_total", "counter", "Page faults of the loop thread.",
+                      [](const LoopSnapshot &l) { return std::to_string(l.metrics.perf.pageFaults); });
+    }
+
+    if (stats != nullptr)
+    {
+        appendSummary(&out, label, "read_to_callback_seconds", "Delay from poll return to MessageCallback.",
+                      stats->readToCallback());
+        appendSummary(&out, label, "callback_seconds", "MessageCallback duration.", stats->callbackDuration());
+        appendSummary(&out, label, "enqueue_to_flush_seconds", "Time until a non-empty output buffer drained.",
+                      stats->enqueueToFlush());
+    }
+    return out;
+}
+} // namespace
+
+void TcpServer::collectMetricsInLoop(const MetricsCallback &cb)
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    std::shared_ptr<MetricsCollector> collector = std::make_shared<MetricsCollector>();
+    collector->loops.resize(loops.size());
+    collector->remaining = loops.size();
+    // subLoop中的回调可能在TcpServer析构之后才执行，只能使用这里拷贝出的值，拿到token之后才能访问server
+    std::weak_ptr<void> token(lifetimeToken_);
+    TcpServer *server = this;
+    EventLoop *baseLoop = loop_;
+    bool withStats = connectionStats_;
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        EventLoop *loop = loops[i];
+        loop->runInLoop([server, baseLoop, collector, loop, i, token, withStats, cb]() {
+            {
+                std::unique_lock<std::mutex> lock(collector->mutex);
+                LoopSnapshot &snapshot = collector->loops[i];
+                snapshot.metrics = loop->metrics();
+                snapshot.iterations = loop->iterations();
+                snapshot.busyMicros = loop->busyMicros();
+                snapshot.queueSize = loop->queueSize();
+                if (withStats)
+                {
+                    collector->stats.merge(*loop->connectionStats());
+                }
+                if (--collector->remaining > 0)
+                {
+                    return;
+                }
+            }
+            baseLoop->runInLoop([server, collector, token, withStats, cb]() {
+                if (token.lock())
+                {
+                    cb(renderMetrics(server->name_, server->connections_.size(), server->nextConnId_ - 1,
+                                     server->acceptor_->acceptErrors(),
+                                     collector->loops, withStats ? &collector->stats : nullptr));
+                }
+            });
+        });
+    }
+}
+
+// 定时把负载均衡的操作投递到baseLoop，connections_只能在baseLoop中访问
+void TcpServer::rebalanceThreadFunc()
+{
+    std::unique_lock<std::mutex> lock(rebalanceMutex_);
+    auto interval = std::chrono::microseconds(static_cast<int64_t>(rebalanceInterval_ * 1000 * 1000));
+    auto deadline = std::chrono::steady_clock::now() + interval;
+    while (rebalanceRunning_)
+    {
+        if (rebalanceCond_.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            loop_->queueInLoop(
+                std::bind(&TcpServer::rebalanceIfAlive, std::weak_ptr<void>(lifetimeToken_), this)
+            );
+            deadline += interval;
+        }
+    }
+}
+
+void TcpServer::rebalanceIfAlive(const std::weak_ptr<void> &token, TcpServer *server)
+{
+    if (token.lock())
+    {
+        server->rebalanceInLoop();
+    }
+}
+
+/*
+ * 比较各subLoop在上一个周期内的繁忙时间，找出最忙和最闲的loop
+ * 按最近收发的字节数估算最忙loop上每个连接所占的繁忙时间，从最活跃的连接开始迁移，
+ * 只迁移能够缩小差距的连接(占比小于当前差值)，差值降到阈值以下时停止
+ */
+void TcpServer::rebalanceInLoop()
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    if (loops.size() < 2)
+    {
+        return;
+    }
+
+    EventLoop *hot = nullptr;
+    EventLoop *cold = nullptr;
+    int64_t hotBusy = 0;
+    int64_t coldBusy = 0;
+    bool firstSample = false;
+    for (EventLoop *loop : loops)
+    {
+        int64_t busy = loop->busyMicros();
+        auto it = lastBusyMicros_.find(loop);
+        firstSample = firstSample || (it == lastBusyMicros_.end());
+        int64_t delta = (it == lastBusyMicros_.end()) ? 0 : busy - it->second;
+        lastBusyMicros_[loop] = busy;
+
+        if (hot == nullptr || delta > hotBusy)
+        {
+            hot = loop;
+            hotBusy = delta;
+        }
+        if (cold == nullptr || delta < coldBusy)
+        {
+            cold = loop;
+            coldBusy = delta;
+        }
+    }
+
+    // 统计最忙loop上各连接最近的活跃程度，所有连接的计数都在这里清零
+    using Candidate = std::pair<uint64_t, TcpConnectionPtr>;
+    std::vector<Candidate> candidates;
+    uint64_t hotBytes = 0;
+    for (auto &item : connections_)
+    {
+        uint64_t bytes = item.second->takeRecentBytes();
+        if (bytes > 0 && item.second->getLoop() == hot && !item.second->migrationRefused())
+        {
+            candidates.push_back(Candidate(bytes, item.second));
+            hotBytes += bytes;
+        }
+    }
+
+    const double intervalMicros = rebalanceInterval_ * 1000 * 1000;
+    double gap = (hotBusy - coldBusy) / intervalMicros;
+    if (firstSample || gap < rebalanceThreshold_ || hotBytes == 0)
+    {
+        return;
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) { return a.first > b.first; });
+
+    const double hotRatio = hotBusy / intervalMicros;
+    for (const Candidate &c : candidates)
+    {
+        double share = hotRatio * c.first / hotBytes;
+        if (share < gap)
+        {
+            LOG_INFO("TcpServer::rebalance [%s] - move connection %s, busy share %.3f, gap %.3f\n",
+                     name_.c_str(), c.second->name().c_str(), share, gap);
+            c.second->moveToLoop(cold);
+            gap -= 2 * share;
+            if (gap < rebalanceThreshold_)
+            {
+                break;
+            }
+        }
+    }
+}
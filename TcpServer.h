@@ -4,15 +4,21 @@
 #include "EventLoop.h"
 #include "EventLoopThreadPool.h"
 #include "InetAddress.h"
+#include "UnixAddress.h"
 #include "Acceptor.h"
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "ComputeThreadPool.h"
+#include "Thread.h"
+#include "EventLoopThread.h"
 
 #include <string>
 #include <functional>
 #include <unordered_map>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 // 对外的服务器编程使用的类
 class TcpServer : noncopyable
@@ -31,30 +37,92 @@ public:
               const InetAddress &listenAddr,
               const std::string &nameArg,
               Option option = kNoReusePort);
+    // 监听Unix域socket，本机进程间通信省去TCP协议栈的开销，连接同样是TcpConnection，并且可以传递fd
+    TcpServer(EventLoop *loop,
+              const UnixAddress &listenAddr,
+              const std::string &nameArg);
     ~TcpServer();
+    const std::string& name() const { return name_; }
+    const std::string& ipPort() const { return ipPort_; }
+    EventLoop* getLoop() const { return loop_; }
+
     void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
     void setConnectionCallback(const ConnectionCallback &cb)  { connetionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb)       { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
     
-    // 设置底层subLoop的个数
+    // 设置底层subLoop的个数，start之后调用会在运行时扩缩容，缩容时被摘下的loop上的连接会迁移到其余的loop
     void setThreadNum(int numThreads);
+    // 设置计算线程池的线程数量，0表示不启用，需在start之前调用
+    void setComputeThreadNum(int numThreads);
+    // MessageCallback中把CPU密集型的任务提交到计算线程池，结果通过queueInLoop回到连接所在的loop
+    ComputeThreadPool *computePool() const { return computePool_.get(); }
+
+    /*
+     * 开启自动负载均衡，需在start之前调用
+     * 每隔intervalSeconds秒比较各subLoop的繁忙时间占比，差值超过imbalanceThreshold时，
+     * 把最忙loop上的活跃连接迁移到最闲的loop上
+     */
+    void enableRebalance(double intervalSeconds, double imbalanceThreshold = 0.2);
+
+    // 新连接开启内核接收时间戳，MessageCallback的Timestamp改为内核收到本次读到的最后一个分段的时间，需在start之前调用
+    void setKernelTimestamp(bool on) { kernelTimestamp_ = on; }
+    // 新连接开启收发统计(见TcpConnection::setStatsEnabled)，需在start之前调用
+    void setConnectionStats(bool on) { connectionStats_ = on; }
+
+    using ConnectionStatsCallback = std::function<void(const ConnectionStats&)>;
+    // 在各subLoop中取一份ConnectionStats并合并，全部取完后在baseLoop中调用cb，可在任意线程调用
+    void collectConnectionStats(const ConnectionStatsCallback &cb);
+
+    /*
+     * 在另一个端口上提供Prometheus文本格式的指标(GET /metrics)，由baseLoop处理，需在start之前调用
+     * 包括连接数、accept错误、各loop的循环/事件/回调/唤醒次数、收发字节数和待发送的积压字节数，
+     * 开启了setConnectionStats时还包括读到回调的延迟、回调耗时和输出排队时间的分位数，
+     * 开启了PerfCounters时还包括各loop线程的cycles、instructions、LLC misses、上下文切换和缺页次数
+     * 各loop的计数平时只在本线程中自增，抓取时才到各loop中拷贝一份
+     * GET /trace 返回Tracer已记录的时间线(Chrome trace JSON)，需先调用Tracer::enable
+     */
+    void enableMetrics(const InetAddress &listenAddr);
+    using MetricsCallback = std::function<void(const std::string&)>;
+    // 生成一份指标文本，完成后在baseLoop中调用cb，可在任意线程调用，不开启enableMetrics也可以使用
+    void collectMetrics(const MetricsCallback &cb);
 
     // 开启服务器监听
     void start();
 private:
+    TcpServer(EventLoop *loop,
+              Acceptor *acceptor,
+              const std::string &ipPort,
+              const std::string &nameArg,
+              bool unixDomain);
+
     void newConnection(int sockfd, const InetAddress &peerAddr);
     void removeConnection(const TcpConnectionPtr &conn);
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
+    void resizeThreadPoolInLoop(int numThreads);
+    void finishRetireInLoop(EventLoop *retiredLoop);
+    static void retireDrained(EventLoop *baseLoop, const std::weak_ptr<void> &token,
+                              TcpServer *server, EventLoop *retiredLoop);
+
+    void collectConnectionStatsInLoop(const ConnectionStatsCallback &cb);
+    void collectMetricsInLoop(const MetricsCallback &cb);
+    void onMetricsRequest(const TcpConnectionPtr &conn, Buffer *buf);
+
+    void rebalanceThreadFunc();
+    void rebalanceInLoop();
+    static void rebalanceIfAlive(const std::weak_ptr<void> &token, TcpServer *server);
+
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
     
     EventLoop *loop_;   // baseLoop 用户定义的loop
-    const std::string ipPort_;
+    const std::string ipPort_;  // Unix域socket时为监听的路径
     const std::string name_;
+    const bool unixDomain_;
     
     std::unique_ptr<Acceptor> acceptor_;    // 运行在mainLoop，任务就是监听新连接事件
     std::shared_ptr<EventLoopThreadPool> threadPool_;   // one loop per thread
+    std::unique_ptr<ComputeThreadPool> computePool_;    // 声明在threadPool_之后，保证先于subLoop回收
 
     ConnectionCallback connetionCallback_;   // 有新连接时的回调
     MessageCallback messageCallback_;       // 有读写消息时的回调
@@ -64,5 +132,24 @@ private:
     std::atomic_int started_;
 
     int nextConnId_;
+    bool kernelTimestamp_;
+    bool connectionStats_;
     ConnectionMap connections_; // 保存所有的连接
+    // 缩容时已被摘下、正在迁出连接的loop线程，只在baseLoop中访问
+    std::unordered_map<EventLoop*, std::unique_ptr<EventLoopThread>> retiringThreads_;
+
+    // 负载均衡线程只负责定时，实际的统计和迁移都在baseLoop中执行
+    std::unique_ptr<Thread> rebalanceThread_;
+    std::mutex rebalanceMutex_;
+    std::condition_variable rebalanceCond_;
+    bool rebalanceRunning_;
+    double rebalanceInterval_;
+    double rebalanceThreshold_;
+    std::unordered_map<EventLoop*, int64_t> lastBusyMicros_;
+
+    // TcpServer的存活标记，析构时释放；排队到baseLoop或subLoop、持有this的回调
+    // (负载均衡、缩容检查、指标收集)执行前都要先lock成功，新增这类回调时同样使用它
+    std::shared_ptr<void> lifetimeToken_;
+
+    std::unique_ptr<TcpServer> metricsServer_; // 声明在最后，先于其他成员析构
 };
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+// 定时器，由TimerQueue管理，用户通过TimerId引用
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++s_numCreated_)
+    {
+    }
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复的定时器从now开始计算下一次到期的时间
+    void restart(Timestamp now);
+
+    static int64_t numCreated() { return s_numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;  // 到期时间
+    const double interval_; // 重复的间隔(秒)，不重复时为0
+    const bool repeat_;
+    const int64_t sequence_; // 全局唯一的序号，区分地址相同的新旧定时器
+
+    static std::atomic<int64_t> s_numCreated_;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+#include <set>
+#include <vector>
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/*
+ * 定时器队列，每个EventLoop一个
+ * 所有定时器共用一个timerfd，timerfd总是设置为最早到期的定时器的时间，
+ * 到期时和其他fd一样由Poller通知，在loop线程中执行定时器的回调
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 添加定时器，可以在任意线程调用，interval大于0时为重复的定时器
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    // 取消定时器，可以在任意线程调用
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读，执行到期的定时器
+    void handleRead();
+    // 取出所有已到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重复的定时器重新加入队列，其余的释放
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+    // 返回最早到期的定时器是否改变
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_; // 按到期时间排序
+
+    ActiveTimerSet activeTimers_;       // 和timers_保存相同的定时器，按地址排序，用于取消
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_;    // 在自己的回调中被取消的重复定时器，不再重新加入队列
+};
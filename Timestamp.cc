@@ -1,6 +1,90 @@
 #include "Timestamp.h"
 
 #include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace
+{
+// TSC时钟的校准参数：微秒 = baseMicros + ((tsc - baseTsc) * mult) >> kTscShift
+struct TscCalibration
+{
+    int64_t baseMicros;
+    uint64_t baseTsc;
+    uint64_t mult;
+};
+
+const int kTscShift = 40;
+
+// 当前的校准参数，为空表示未开启TSC时钟
+// 每次校准都新建一份不可变的参数再发布指针，读者拿到的总是完整的一份；
+// 旧的参数可能仍有读者在使用，不释放，重新校准的频率很低，泄漏的内存可以忽略
+std::atomic<const TscCalibration*> g_tscCalibration(nullptr);
+
+int64_t clockMicros(clockid_t clock)
+{
+    struct timespec ts;
+    ::clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
+int64_t clockNanos(clockid_t clock)
+{
+    struct timespec ts;
+    ::clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// CPU频率变化、深度睡眠时TSC仍然匀速递增，才能用来计时
+bool tscIsReliable()
+{
+    FILE *fp = ::fopen("/proc/cpuinfo", "r");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    bool constant = false;
+    bool nonstop = false;
+    char line[4096];
+    while (::fgets(line, sizeof line, fp) != nullptr)
+    {
+        if (strncmp(line, "flags", 5) == 0)
+        {
+            constant = strstr(line, " constant_tsc") != nullptr;
+            nonstop = strstr(line, " nonstop_tsc") != nullptr;
+            break;
+        }
+    }
+    ::fclose(fp);
+    return constant && nonstop;
+}
+
+// 同一时刻的系统时钟和TSC，取clock_gettime前后两次TSC的中点
+template <typename Clock>
+void sample(Clock clock, int64_t &value, uint64_t &tsc)
+{
+#if defined(__x86_64__)
+    uint64_t before = __rdtsc();
+    value = clock();
+    uint64_t after = __rdtsc();
+    tsc = before + (after - before) / 2;
+#else
+    value = clock();
+    tsc = 0;
+#endif
+}
+
+// 每个线程缓存最近一次格式化的日期，同一秒内的时间只需格式化微秒部分
+__thread time_t t_lastSecond = -1;
+__thread char t_datePrefix[32];
+__thread int t_datePrefixLen = 0;
+} // namespace
 
 Timestamp::Timestamp():microSecondsSinceEpoch_(0) {}
 
@@ -8,30 +92,116 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     : microSecondsSinceEpoch_(microSecondsSinceEpoch)
 {
 }
+
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+#if defined(__x86_64__)
+    const TscCalibration *c = g_tscCalibration.load(std::memory_order_acquire);
+    if (c != nullptr)
+    {
+        uint64_t ticks = __rdtsc() - c->baseTsc;
+        uint64_t micros = static_cast<uint64_t>((static_cast<unsigned __int128>(ticks) * c->mult) >> kTscShift);
+        return Timestamp(c->baseMicros + static_cast<int64_t>(micros));
+    }
+#endif
+    return Timestamp(clockMicros(CLOCK_REALTIME));
 }
+
+Timestamp Timestamp::monotonic()
+{
+    return Timestamp(clockMicros(CLOCK_MONOTONIC));
+}
+
+int64_t Timestamp::monotonicNanos()
+{
+    return clockNanos(CLOCK_MONOTONIC);
+}
+
+// 用单调时钟测出TSC的频率，再以当前的系统时间作为起点
+bool Timestamp::enableTscClock()
+{
+#if defined(__x86_64__)
+    if (!tscIsReliable())
+    {
+        return false;
+    }
+
+    int64_t mono0, mono1, real;
+    uint64_t tsc0, tsc1, tscReal;
+    sample([]() { return clockNanos(CLOCK_MONOTONIC); }, mono0, tsc0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    sample([]() { return clockNanos(CLOCK_MONOTONIC); }, mono1, tsc1);
+    sample([]() { return clockMicros(CLOCK_REALTIME); }, real, tscReal);
+    if (mono1 <= mono0 || tsc1 <= tsc0)
+    {
+        return false;
+    }
+
+    // mult = 每个tick的微秒数 * 2^kTscShift
+    double ticksPerMicro = static_cast<double>(tsc1 - tsc0) * 1000.0 / static_cast<double>(mono1 - mono0);
+    TscCalibration *c = new TscCalibration;
+    c->baseMicros = real;
+    c->baseTsc = tscReal;
+    c->mult = static_cast<uint64_t>(static_cast<double>(1ULL << kTscShift) / ticksPerMicro);
+    g_tscCalibration.store(c, std::memory_order_release);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Timestamp::disableTscClock()
+{
+    g_tscCalibration.store(nullptr, std::memory_order_release);
+}
+
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
-    return buf;
+    return toFormattedString(false);
 }
 
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64];
+    int len = formatTo(buf, sizeof buf, showMicroseconds);
+    return std::string(buf, len);
+}
 
-/*
-#include <iostream>
-int main()
+// 日期部分按线程缓存，秒数变化时才调用localtime_r
+int Timestamp::formatTo(char *buf, int size, bool showMicroseconds) const
 {
-    std::cout << Timestamp::now().toString() << std::endl;
-    return 0;
+    time_t seconds = secondsSinceEpoch();
+    if (seconds != t_lastSecond)
+    {
+        struct tm tm_time;
+        ::localtime_r(&seconds, &tm_time);
+        t_datePrefixLen = snprintf(t_datePrefix, sizeof t_datePrefix, "%4d/%02d/%02d %02d:%02d:%02d",
+                                   tm_time.tm_year + 1900,
+                                   tm_time.tm_mon + 1,
+                                   tm_time.tm_mday,
+                                   tm_time.tm_hour,
+                                   tm_time.tm_min,
+                                   tm_time.tm_sec);
+        t_lastSecond = seconds;
+    }
+
+    if (size <= t_datePrefixLen)
+    {
+        return 0;
+    }
+    memcpy(buf, t_datePrefix, t_datePrefixLen);
+    int len = t_datePrefixLen;
+    if (showMicroseconds && size - len > 7)
+    {
+        int micros = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        buf[len] = '.';
+        for (int i = 6; i > 0; --i)
+        {
+            buf[len + i] = static_cast<char>('0' + micros % 10);
+            micros /= 10;
+        }
+        len += 7;
+    }
+    buf[len] = '\0';
+    return len;
 }
-*/
\ No newline at end of file
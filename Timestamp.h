@@ -2,8 +2,13 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
 
-// 时间类
+/*
+ * 时间类，精确到微秒
+ * now()读取CLOCK_REALTIME(走vDSO，不陷入内核)；monotonic()读取CLOCK_MONOTONIC，只用于计算时间间隔
+ * 调用enableTscClock()之后now()改为读取校准过的TSC，省去clock_gettime的开销
+ */
 class Timestamp
 {
 
@@ -11,8 +16,64 @@ public:
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
     static Timestamp now();
+    // 单调时钟，不受系统时间调整的影响，起点不是1970年，不能用来格式化
+    static Timestamp monotonic();
+    // 单调时钟的纳秒数，用于测量微秒以下的短时间间隔
+    static int64_t monotonicNanos();
+    static Timestamp invalid() { return Timestamp(); }
+
+    // 用CPU的TSC计数器代替clock_gettime，需要CPU支持constant_tsc和nonstop_tsc
+    // 校准时在调用线程中sleep约100ms，不要在loop线程中调用；不支持时返回false，now()仍然使用clock_gettime
+    // 长时间运行会与NTP调整后的系统时间产生偏差，可以在后台线程中定期重新调用以重新校准，可与now()并发
+    static bool enableTscClock();
+    static void disableTscClock();
+
+    // 2026/10/19 03:01:42
     std::string toString() const;
+    // 2026/10/19 03:01:42.925686
+    std::string toFormattedString(bool showMicroseconds = true) const;
+    // 格式化到buf中，返回写入的长度；日期部分按线程缓存，同一秒内只重新格式化微秒
+    int formatTo(char *buf, int size, bool showMicroseconds = true) const;
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const
+    {
+        return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 两个时间点相差的微秒数
+inline int64_t microSecondsDifference(Timestamp high, Timestamp low)
+{
+    return high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+}
+
+// 在timestamp的基础上增加seconds秒
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,336 @@
+#include "Tracer.h"
+#include "CurrentThread.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct TraceEvent
+{
+    const char *name;
+    const char *argName;
+    int64_t arg;
+    int64_t startNanos;
+    int64_t durNanos;
+};
+
+// 单个线程的环形缓冲区，head是单调递增的写入序号，[head - capacity, head)之间是有效的记录
+// 线程退出后缓冲区交还，被新线程复用时head继续递增，firstSeq之前的记录属于之前的线程
+struct TraceRing
+{
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> firstSeq;
+    uint64_t mask;
+    // 以下由g_mutex保护
+    bool inUse;
+    int tid;
+    char threadName[16];
+    std::unique_ptr<TraceEvent[]> events;
+};
+
+// 导出时在g_mutex保护下拷贝出的缓冲区信息，释放锁之后再序列化
+struct RingInfo
+{
+    const TraceRing *ring;
+    uint64_t firstSeq;
+    int tid;
+    char threadName[16];
+};
+
+std::mutex g_mutex;                            // 保护缓冲区的登记和导出信号的设置
+std::vector<std::unique_ptr<TraceRing>> g_rings; // 缓冲区不释放，线程退出后留给事后导出，直到被新线程复用
+std::atomic<size_t> g_ringCapacity(64 * 1024);
+__thread TraceRing *t_ring = nullptr;
+
+// 线程退出时交还缓冲区，反复创建和退出的线程(缩容的loop、计算线程)不会让缓冲区无限增长
+struct RingOwner
+{
+    TraceRing *ring = nullptr;
+    ~RingOwner()
+    {
+        if (ring)
+        {
+            std::unique_lock<std::mutex> lock(g_mutex);
+            ring->inUse = false;
+            t_ring = nullptr;
+        }
+    }
+};
+thread_local RingOwner t_ringOwner;
+
+int g_signalPipe[2] = {-1, -1};
+std::string g_signalPath;
+
+TraceRing *acquireRing()
+{
+    size_t capacity = 1;
+    while (capacity < g_ringCapacity.load(std::memory_order_relaxed))
+    {
+        capacity <<= 1;
+    }
+
+    char threadName[16];
+    memset(threadName, 0, sizeof threadName);
+    ::prctl(PR_GET_NAME, threadName);
+
+    std::unique_lock<std::mutex> lock(g_mutex);
+    TraceRing *p = nullptr;
+    for (const std::unique_ptr<TraceRing> &ring : g_rings)
+    {
+        if (!ring->inUse && ring->mask == capacity - 1)
+        {
+            p = ring.get();
+            p->firstSeq.store(p->head.load(std::memory_order_relaxed), std::memory_order_release);
+            break;
+        }
+    }
+    if (p == nullptr)
+    {
+        std::unique_ptr<TraceRing> ring(new TraceRing);
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->firstSeq.store(0, std::memory_order_relaxed);
+        ring->mask = capacity - 1;
+        ring->events.reset(new TraceEvent[capacity]);
+        p = ring.get();
+        g_rings.push_back(std::move(ring));
+    }
+    p->inUse = true;
+    p->tid = CurrentThread::tid();
+    memcpy(p->threadName, threadName, sizeof threadName);
+    t_ringOwner.ring = p;
+    return p;
+}
+
+// 拷贝出一个缓冲区中属于info所记录的线程的完整记录，拷贝期间被覆盖的记录和缓冲区被复用之后的记录丢弃
+void snapshot(const RingInfo &info, std::vector<TraceEvent> *out)
+{
+    const TraceRing &ring = *info.ring;
+    uint64_t capacity = ring.mask + 1;
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    uint64_t begin = std::max(head > capacity ? head - capacity : 0, info.firstSeq);
+    if (head <= begin)
+    {
+        return;
+    }
+    size_t base = out->size();
+    for (uint64_t i = begin; i < head; ++i)
+    {
+        out->push_back(ring.events[i & ring.mask]);
+    }
+
+    // 写入线程正在写的是序号为newHead的记录，它占用的是序号newHead - capacity的位置
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t newHead = ring.head.load(std::memory_order_relaxed);
+    uint64_t firstSeq = ring.firstSeq.load(std::memory_order_relaxed);
+    if (firstSeq != info.firstSeq && firstSeq < head)
+    {
+        // 拷贝期间缓冲区被新线程复用，firstSeq之后的记录不属于这个线程
+        out->resize(base + static_cast<size_t>(std::max(firstSeq, begin) - begin));
+    }
+    if (newHead + 1 > begin + capacity)
+    {
+        size_t copied = out->size() - base;
+        size_t overwritten = static_cast<size_t>(std::min<uint64_t>(newHead + 1 - capacity - begin, copied));
+        out->erase(out->begin() + base, out->begin() + base + overwritten);
+    }
+}
+
+// 线程名来自prctl，可能包含需要转义的字符，直接替换掉
+std::string sanitize(const char *s)
+{
+    std::string name(s);
+    for (char &c : name)
+    {
+        if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20)
+        {
+            c = '_';
+        }
+    }
+    return name;
+}
+
+void appendEvent(std::string *json, int pid, int tid, const TraceEvent &e)
+{
+    char buf[256];
+    // Chrome trace的时间单位是微秒，保留到纳秒精度
+    int n = snprintf(buf, sizeof buf,
+                     ",\n{\"name\":\"%s\",\"cat\":\"mymuduo\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                     "\"ts\":%lld.%03lld,\"dur\":%lld.%03lld",
+                     e.name, pid, tid,
+                     static_cast<long long>(e.startNanos / 1000), static_cast<long long>(e.startNanos % 1000),
+                     static_cast<long long>(e.durNanos / 1000), static_cast<long long>(e.durNanos % 1000));
+    json->append(buf, n);
+    if (e.argName)
+    {
+        n = snprintf(buf, sizeof buf, ",\"args\":{\"%s\":%lld}", e.argName, static_cast<long long>(e.arg));
+        json->append(buf, n);
+    }
+    json->append("}");
+}
+
+void signalHandler(int)
+{
+    int savedErrno = errno;
+    char c = 1;
+    ssize_t n = ::write(g_signalPipe[1], &c, 1);
+    (void)n;
+    errno = savedErrno;
+}
+
+// 后台线程等待信号处理函数写入管道，然后导出
+void signalThread()
+{
+    char c;
+    for (;;)
+    {
+        ssize_t n = ::read(g_signalPipe[0], &c, 1);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return;
+        }
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(g_mutex);
+            path = g_signalPath;
+        }
+        Tracer::dump(path);
+    }
+}
+} // namespace
+
+std::atomic<bool> Tracer::enabled_(false);
+
+void Tracer::enable(size_t eventsPerThread)
+{
+    g_ringCapacity.store(eventsPerThread > 0 ? eventsPerThread : 1, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char *name, const char *argName, int64_t arg, int64_t startNanos, int64_t endNanos)
+{
+    TraceRing *ring = t_ring;
+    if (ring == nullptr)
+    {
+        ring = t_ring = acquireRing();
+    }
+    // 只有本线程写入head，不需要原子的读改写
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent &e = ring->events[head & ring->mask];
+    e.name = name;
+    e.argName = argName;
+    e.arg = arg;
+    e.startNanos = startNanos;
+    e.durNanos = endNanos - startNanos;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+std::string Tracer::toJson()
+{
+    int pid = static_cast<int>(::getpid());
+    std::string json;
+    char buf[160];
+    int n = snprintf(buf, sizeof buf,
+                     "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"mymuduo\"}}", pid);
+    json.append(buf, n);
+
+    // 只在锁内拷贝缓冲区的信息，序列化期间不阻塞第一次记录的线程领取缓冲区
+    std::vector<RingInfo> rings;
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        rings.resize(g_rings.size());
+        for (size_t i = 0; i < g_rings.size(); ++i)
+        {
+            rings[i].ring = g_rings[i].get();
+            rings[i].firstSeq = g_rings[i]->firstSeq.load(std::memory_order_relaxed);
+            rings[i].tid = g_rings[i]->tid;
+            memcpy(rings[i].threadName, g_rings[i]->threadName, sizeof rings[i].threadName);
+        }
+    }
+
+    std::vector<TraceEvent> events;
+    for (const RingInfo &ring : rings)
+    {
+        n = snprintf(buf, sizeof buf,
+                     ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                     pid, ring.tid, sanitize(ring.threadName).c_str(), ring.tid);
+        json.append(buf, n);
+
+        events.clear();
+        snapshot(ring, &events);
+        for (const TraceEvent &e : events)
+        {
+            appendEvent(&json, pid, ring.tid, e);
+        }
+    }
+    json.append("\n]}\n");
+    return json;
+}
+
+bool Tracer::dump(const std::string &path)
+{
+    std::string json = toJson();
+    FILE *fp = ::fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        LOG_ERROR("Tracer::dump open %s failed: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = ::fwrite(json.data(), 1, json.size(), fp) == json.size();
+    ok = ::fclose(fp) == 0 && ok;
+    if (!ok)
+    {
+        LOG_ERROR("Tracer::dump write %s failed: %s", path.c_str(), strerror(errno));
+    }
+    return ok;
+}
+
+bool Tracer::dumpOnSignal(int sig, const std::string &path)
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_signalPath = path;
+    if (g_signalPipe[0] < 0)
+    {
+        if (::pipe2(g_signalPipe, O_CLOEXEC) < 0)
+        {
+            LOG_ERROR("Tracer::dumpOnSignal pipe failed: %s", strerror(errno));
+            return false;
+        }
+        // 写端非阻塞，管道写满时信号处理函数不会阻塞
+        ::fcntl(g_signalPipe[1], F_SETFL, O_NONBLOCK);
+        std::thread(signalThread).detach();
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = signalHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (::sigaction(sig, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("Tracer::dumpOnSignal sigaction failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <atomic>
+
+/*
+ * 事件循环的时间线追踪，默认关闭，关闭时每个埋点只有一次原子读和一次分支
+ * 每个线程第一次记录时领取一个固定大小的环形缓冲区，只有本线程写入，写满后覆盖最旧的记录，不加锁
+ * 线程退出后缓冲区中的记录仍可导出，直到缓冲区被之后第一次记录的线程复用
+ * 记录的是完整的span：名字、开始时间、持续时间和一个整数参数(fd、字节数等)
+ * 可以在任意线程随时导出，或者收到信号时导出为Chrome trace JSON，用chrome://tracing或ui.perfetto.dev打开
+ *
+ * Tracer::enable();
+ * Tracer::dumpOnSignal(SIGUSR1, "/tmp/server.trace.json");
+ *
+ * void f() { TraceSpan span("decode", "bytes", len); ... }
+ */
+class Tracer : noncopyable
+{
+public:
+    // 开始记录，eventsPerThread为每个线程环形缓冲区能保存的span数，向上取整为2的幂
+    // 只对之后第一次记录的线程生效，已经领取了缓冲区的线程保持原来的大小
+    static void enable(size_t eventsPerThread = 64 * 1024);
+    // 停止记录，已有的记录保留，仍然可以导出
+    static void disable();
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // 记录一个span，name和argName必须是静态字符串，argName为空表示没有参数
+    static void record(const char *name, const char *argName, int64_t arg, int64_t startNanos, int64_t endNanos);
+
+    // 把所有线程的记录导出为Chrome trace JSON，可在任意线程调用，不影响正在记录的线程
+    static std::string toJson();
+    // 导出到文件，覆盖已有的文件
+    static bool dump(const std::string &path);
+    // 收到sig信号时导出到path，信号处理函数只写一个字节到管道，由后台线程完成导出
+    static bool dumpOnSignal(int sig, const std::string &path);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// 作用域内的span，构造时记录开始时间，析构时写入当前线程的环形缓冲区
+class TraceSpan : noncopyable
+{
+public:
+    explicit TraceSpan(const char *name, const char *argName = nullptr, int64_t arg = 0)
+        : name_(Tracer::enabled() ? name : nullptr)
+        , argName_(argName)
+        , arg_(arg)
+        , startNanos_(name_ ? Timestamp::monotonicNanos() : 0)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (name_)
+        {
+            Tracer::record(name_, argName_, arg_, startNanos_, Timestamp::monotonicNanos());
+        }
+    }
+
+    // 参数在span结束时才知道，比如poll返回的事件数、实际写入的字节数
+    void setArg(int64_t arg) { arg_ = arg; }
+
+private:
+    const char *name_; // 为空表示构造时追踪未开启
+    const char *argName_;
+    int64_t arg_;
+    int64_t startNanos_;
+};
@@ -0,0 +1,372 @@
+#include "UdpChannel.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <netinet/udp.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+// 旧版本的头文件中没有GSO/GRO的定义，数值来自linux/udp.h
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+static int createUdpSocket()
+{
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d udp sockfd create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+// 容纳bytes字节的控制消息需要的cmsghdr个数
+static size_t controlElements(size_t bytes)
+{
+    return (bytes + sizeof(cmsghdr) - 1) / sizeof(cmsghdr);
+}
+
+// 控制消息缓冲区中偏移offset字节处的地址，offset是CMSG_SPACE的整数倍，仍然按cmsghdr对齐
+static void *controlBuffer(std::vector<cmsghdr> *control, size_t offset)
+{
+    return reinterpret_cast<char*>(control->data()) + offset;
+}
+
+UdpChannel::UdpChannel(EventLoop *loop,
+                       const InetAddress &bindAddr,
+                       bool reusePort,
+                       int batchSize,
+                       size_t maxDatagramSize)
+    : loop_(loop)
+    , socket_(createUdpSocket())
+    , channel_(new Channel(loop, socket_.fd()))
+    , batchSize_(batchSize)
+    , maxDatagramSize_(maxDatagramSize)
+    , gro_(false)
+    , outBegin_(0)
+    , outEnd_(0)
+    , inReadBatch_(false)
+    , flushQueued_(false)
+    , token_(std::make_shared<int>(0))
+    , packetsReceived_(0)
+    , packetsSent_(0)
+    , packetsDropped_(0)
+    , recvCalls_(0)
+    , sendCalls_(0)
+{
+    socket_.setReuseAddr(true);
+    // 多个loop各自绑定同一个端口，由内核按四元组的哈希把数据报分散到各个socket
+    socket_.setReusePort(reusePort);
+    socket_.bindAddress(bindAddr);
+
+    // 发送用的数组在构造时分配，start之前也可以发送
+    sendMsgs_.resize(batchSize_);
+    sendIovecs_.resize(batchSize_);
+    sendControl_.resize(controlElements(batchSize_ * CMSG_SPACE(sizeof(uint16_t))));
+
+    channel_->setReadCallback(std::bind(&UdpChannel::handleRead, this, std::placeholders::_1));
+    channel_->setWriteCallback(std::bind(&UdpChannel::handleWrite, this));
+}
+
+UdpChannel::~UdpChannel()
+{
+    token_.reset();
+    channel_->disableAll();
+    channel_->remove();
+}
+
+bool UdpChannel::enableGro(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(socket_.fd(), IPPROTO_UDP, UDP_GRO, &optval, sizeof optval) < 0)
+    {
+        LOG_ERROR("UdpChannel::enableGro setsockopt error:%d", errno);
+        return false;
+    }
+    gro_ = on;
+    return true;
+}
+
+void UdpChannel::start()
+{
+    std::weak_ptr<void> token(token_);
+    loop_->runInLoop([token, this]() {
+        if (token.lock())
+        {
+            startInLoop();
+        }
+    });
+}
+
+// 预先分配一批消息的数组和缓冲区，recvmmsg每次直接收到这些缓冲区中
+void UdpChannel::startInLoop()
+{
+    // 开启GRO后内核合并上交的数据最大64KB
+    if (gro_)
+    {
+        maxDatagramSize_ = std::max<size_t>(maxDatagramSize_, 65536);
+    }
+    const size_t controlSize = CMSG_SPACE(sizeof(int));
+
+    recvBuffer_.resize(batchSize_ * maxDatagramSize_);
+    recvMsgs_.resize(batchSize_);
+    recvIovecs_.resize(batchSize_);
+    recvAddrs_.resize(batchSize_);
+    recvControl_.resize(controlElements(batchSize_ * controlSize));
+    for (int i = 0; i < batchSize_; ++i)
+    {
+        recvIovecs_[i].iov_base = &recvBuffer_[i * maxDatagramSize_];
+        recvIovecs_[i].iov_len = maxDatagramSize_;
+        msghdr &hdr = recvMsgs_[i].msg_hdr;
+        memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = &recvAddrs_[i];
+        hdr.msg_iov = &recvIovecs_[i];
+        hdr.msg_iovlen = 1;
+    }
+
+    channel_->enableReading();
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime)
+{
+    const size_t controlSize = CMSG_SPACE(sizeof(int));
+    inReadBatch_ = true;
+    for (int round = 0; round < kMaxRoundsPerEvent; ++round)
+    {
+        for (int i = 0; i < batchSize_; ++i)
+        {
+            msghdr &hdr = recvMsgs_[i].msg_hdr;
+            hdr.msg_namelen = sizeof(sockaddr_in);
+            hdr.msg_control = gro_ ? controlBuffer(&recvControl_, i * controlSize) : nullptr;
+            hdr.msg_controllen = gro_ ? controlSize : 0;
+            hdr.msg_flags = 0;
+        }
+
+        int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), batchSize_, MSG_DONTWAIT, nullptr);
+        recvCalls_.store(recvCalls() + 1, std::memory_order_relaxed);
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR_RATELIMIT(1, "UdpChannel::handleRead recvmmsg error:%d", errno);
+            }
+            break;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            deliver(static_cast<const char *>(recvIovecs_[i].iov_base), recvMsgs_[i].msg_len,
+                    recvMsgs_[i].msg_hdr, receiveTime);
+        }
+        if (n < batchSize_)
+        {
+            break; // socket已经读空
+        }
+    }
+    inReadBatch_ = false;
+
+    // 回调中产生的回复一起发出
+    flush();
+}
+
+// 交给回调，开启GRO时按段长把合并的数据拆回原来的数据报
+void UdpChannel::deliver(const char *data, size_t len, const msghdr &hdr, Timestamp receiveTime)
+{
+    if (hdr.msg_flags & MSG_TRUNC)
+    {
+        packetsDropped_.store(packetsDropped() + 1, std::memory_order_relaxed);
+        LOG_ERROR_RATELIMIT(1, "UdpChannel::deliver datagram larger than %zu bytes truncated", maxDatagramSize_);
+        return;
+    }
+
+    size_t segmentSize = len;
+    if (gro_)
+    {
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+            {
+                int size;
+                memcpy(&size, CMSG_DATA(cmsg), sizeof size);
+                if (size > 0)
+                {
+                    segmentSize = static_cast<size_t>(size);
+                }
+            }
+        }
+    }
+
+    InetAddress peer(*static_cast<const sockaddr_in *>(hdr.msg_name));
+    size_t offset = 0;
+    do
+    {
+        size_t chunk = std::min(segmentSize, len - offset);
+        packetsReceived_.store(packetsReceived() + 1, std::memory_order_relaxed);
+        if (messageCallback_)
+        {
+            messageCallback_(this, data + offset, chunk, peer, receiveTime);
+        }
+        offset += chunk;
+    } while (offset < len);
+}
+
+void UdpChannel::send(const void *data, size_t len, const InetAddress &peer)
+{
+    queueSend(data, len, peer, 0);
+}
+
+bool UdpChannel::sendSegments(const void *data, size_t len, size_t segmentSize, const InetAddress &peer)
+{
+    // UDP_SEGMENT的控制消息只有16位
+    if (segmentSize == 0 || segmentSize > 65535 || segmentSize > len)
+    {
+        LOG_ERROR("UdpChannel::sendSegments invalid segment size %zu for %zu bytes", segmentSize, len);
+        return false;
+    }
+    // 只有一段时就是普通的数据报
+    queueSend(data, len, peer, segmentSize < len ? static_cast<uint16_t>(segmentSize) : 0);
+    return true;
+}
+
+// 其他线程的发送拷贝一份数据排队到loop中，执行前UdpChannel已经析构则丢弃
+void UdpChannel::queueSend(const void *data, size_t len, const InetAddress &peer, uint16_t segmentSize)
+{
+    if (loop_->isInLoopThread())
+    {
+        enqueue(static_cast<const char *>(data), len, *peer.getSockAddr(), segmentSize);
+        return;
+    }
+    std::weak_ptr<void> token(token_);
+    std::string message(static_cast<const char *>(data), len);
+    sockaddr_in addr = *peer.getSockAddr();
+    loop_->runInLoop([token, this, message, addr, segmentSize]() {
+        if (token.lock())
+        {
+            enqueue(message.data(), message.size(), addr, segmentSize);
+        }
+    });
+}
+
+// 追加到发送队列，攒满一批立即发送，否则在本批数据报处理完或者本轮loop结束时发送
+void UdpChannel::enqueue(const char *data, size_t len, const sockaddr_in &peer, uint16_t segmentSize)
+{
+    if (outEnd_ - outBegin_ >= kMaxQueuedMessages)
+    {
+        packetsDropped_.store(packetsDropped() + 1, std::memory_order_relaxed);
+        return;
+    }
+    if (outEnd_ == outQueue_.size())
+    {
+        outQueue_.push_back(OutMessage());
+    }
+    OutMessage &message = outQueue_[outEnd_++];
+    message.data.assign(data, len);
+    message.peer = peer;
+    message.segmentSize = segmentSize;
+
+    if (channel_->isWriting())
+    {
+        return; // socket发送缓冲区已满，等可写时再发
+    }
+    if (outEnd_ - outBegin_ >= static_cast<size_t>(batchSize_))
+    {
+        flush();
+    }
+    else if (!inReadBatch_ && !flushQueued_)
+    {
+        flushQueued_ = true;
+        std::weak_ptr<void> token(token_);
+        loop_->queueInLoop([token, this]() {
+            if (token.lock())
+            {
+                flush();
+            }
+        });
+    }
+}
+
+void UdpChannel::flush()
+{
+    flushQueued_ = false;
+    const size_t controlSize = CMSG_SPACE(sizeof(uint16_t));
+    while (outBegin_ < outEnd_)
+    {
+        int count = static_cast<int>(std::min<size_t>(batchSize_, outEnd_ - outBegin_));
+        for (int i = 0; i < count; ++i)
+        {
+            OutMessage &message = outQueue_[outBegin_ + i];
+            sendIovecs_[i].iov_base = &message.data[0];
+            sendIovecs_[i].iov_len = message.data.size();
+            msghdr &hdr = sendMsgs_[i].msg_hdr;
+            memset(&hdr, 0, sizeof hdr);
+            hdr.msg_name = &message.peer;
+            hdr.msg_namelen = sizeof message.peer;
+            hdr.msg_iov = &sendIovecs_[i];
+            hdr.msg_iovlen = 1;
+            if (message.segmentSize > 0)
+            {
+                hdr.msg_control = controlBuffer(&sendControl_, i * controlSize);
+                hdr.msg_controllen = controlSize;
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                memcpy(CMSG_DATA(cmsg), &message.segmentSize, sizeof(uint16_t));
+            }
+        }
+
+        int n = ::sendmmsg(socket_.fd(), sendMsgs_.data(), count, 0);
+        sendCalls_.store(sendCalls() + 1, std::memory_order_relaxed);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            {
+                if (!channel_->isWriting())
+                {
+                    channel_->enableWriting();
+                }
+                break;
+            }
+            // 队首的数据报出错(比如对端不可达)，丢弃之后继续发送后面的
+            LOG_ERROR_RATELIMIT(1, "UdpChannel::flush sendmmsg error:%d", errno);
+            ++outBegin_;
+            packetsDropped_.store(packetsDropped() + 1, std::memory_order_relaxed);
+            continue;
+        }
+        outBegin_ += n;
+        packetsSent_.store(packetsSent() + n, std::memory_order_relaxed);
+    }
+
+    if (outBegin_ == outEnd_)
+    {
+        outBegin_ = outEnd_ = 0;
+        if (channel_->isWriting())
+        {
+            channel_->disableWriting();
+        }
+    }
+    else if (outBegin_ > outQueue_.size() / 2)
+    {
+        // 把未发送的数据报挪到队首，交换string以保留已分配的容量
+        size_t remain = outEnd_ - outBegin_;
+        for (size_t i = 0; i < remain; ++i)
+        {
+            std::swap(outQueue_[i], outQueue_[outBegin_ + i]);
+        }
+        outBegin_ = 0;
+        outEnd_ = remain;
+    }
+}
+
+void UdpChannel::handleWrite()
+{
+    flush();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+#include "Socket.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <atomic>
+
+class Channel;
+class EventLoop;
+
+/*
+ * 一个EventLoop上的UDP socket
+ * 收：socket可读时用recvmmsg一次收取一批数据报，消息数组和缓冲区预先分配，逐个交给回调
+ * 发：loop线程中的send只是追加到发送队列，本批数据报处理完(或者队列攒满一批)时用sendmmsg一次发出
+ * 可选开启UDP GRO(内核把同一对端的多个数据报合并上交，这里再拆开)和GSO(sendSegments)
+ * 必须在所属的loop中析构，析构之后，之前从其他线程排队的发送和flush不再执行
+ */
+class UdpChannel : noncopyable
+{
+public:
+    using MessageCallback = std::function<void(UdpChannel *channel,
+                                               const char *data,
+                                               size_t len,
+                                               const InetAddress &peer,
+                                               Timestamp receiveTime)>;
+
+    UdpChannel(EventLoop *loop,
+               const InetAddress &bindAddr,
+               bool reusePort,
+               int batchSize = 64,
+               size_t maxDatagramSize = 2048);
+    ~UdpChannel();
+
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+    // 开启UDP GRO，需在start之前调用，内核不支持时返回false
+    bool enableGro(bool on);
+
+    // 开始接收，可以在任意线程调用
+    void start();
+
+    // 发送一个数据报，可以在任意线程调用；loop线程中的调用攒到本轮事件处理完后统一发出
+    void send(const void *data, size_t len, const InetAddress &peer);
+    // GSO：把data按segmentSize切分成多个数据报发给同一个peer，切分由内核完成
+    // segmentSize为0、超过65535或超过len时不发送，返回false
+    bool sendSegments(const void *data, size_t len, size_t segmentSize, const InetAddress &peer);
+    // 立即把发送队列中的数据报发出，需在loop线程调用
+    void flush();
+
+    EventLoop *getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+
+    // 统计，其他线程可以随时读取
+    uint64_t packetsReceived() const { return packetsReceived_.load(std::memory_order_relaxed); }
+    uint64_t packetsSent() const { return packetsSent_.load(std::memory_order_relaxed); }
+    uint64_t packetsDropped() const { return packetsDropped_.load(std::memory_order_relaxed); }
+    uint64_t recvCalls() const { return recvCalls_.load(std::memory_order_relaxed); }
+    uint64_t sendCalls() const { return sendCalls_.load(std::memory_order_relaxed); }
+
+private:
+    // 发送队列中的一个数据报，data的容量在复用时保留，稳定后不再分配内存
+    struct OutMessage
+    {
+        std::string data;
+        sockaddr_in peer;
+        uint16_t segmentSize; // 大于0时使用GSO
+    };
+
+    // 每批最多处理的轮数，避免一个繁忙的socket饿死loop上的其他fd
+    static const int kMaxRoundsPerEvent = 8;
+    // 发送队列的上限，超过时丢弃新的数据报
+    static const size_t kMaxQueuedMessages = 64 * 1024;
+
+    void startInLoop();
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void queueSend(const void *data, size_t len, const InetAddress &peer, uint16_t segmentSize);
+    void enqueue(const char *data, size_t len, const sockaddr_in &peer, uint16_t segmentSize);
+    void deliver(const char *data, size_t len, const msghdr &hdr, Timestamp receiveTime);
+
+    EventLoop *loop_;
+    Socket socket_;
+    std::unique_ptr<Channel> channel_;
+    const int batchSize_;
+    size_t maxDatagramSize_;
+    bool gro_;
+    MessageCallback messageCallback_;
+
+    // recvmmsg使用的预分配数组
+    std::vector<char> recvBuffer_;
+    std::vector<mmsghdr> recvMsgs_;
+    std::vector<iovec> recvIovecs_;
+    std::vector<sockaddr_in> recvAddrs_;
+    std::vector<cmsghdr> recvControl_;  // 元素类型只用来保证按cmsghdr对齐，实际按字节偏移分给各条消息
+
+    // sendmmsg使用的预分配数组，[outBegin_, outEnd_)为待发送的数据报
+    std::vector<OutMessage> outQueue_;
+    size_t outBegin_;
+    size_t outEnd_;
+    std::vector<mmsghdr> sendMsgs_;
+    std::vector<iovec> sendIovecs_;
+    std::vector<cmsghdr> sendControl_;
+    bool inReadBatch_;  // 正在处理一批收到的数据报，处理完统一flush
+    bool flushQueued_;  // 已经排队了一次flush
+    std::shared_ptr<void> token_; // 析构时释放，排队的回调据此判断UdpChannel是否还存在
+
+    std::atomic<uint64_t> packetsReceived_;
+    std::atomic<uint64_t> packetsSent_;
+    std::atomic<uint64_t> packetsDropped_;
+    std::atomic<uint64_t> recvCalls_;
+    std::atomic<uint64_t> sendCalls_;
+};
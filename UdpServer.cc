@@ -0,0 +1,78 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+#include <future>
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop)
+{
+    if (loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d mainLoop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+UdpServer::UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg)
+    : loop_(CheckLoopNotNull(loop))
+    , listenAddr_(listenAddr)
+    , name_(nameArg)
+    , threadPool_(new EventLoopThreadPool(loop, name_))
+    , batchSize_(64)
+    , maxDatagramSize_(2048)
+    , gro_(false)
+    , started_(0)
+{
+}
+
+UdpServer::~UdpServer()
+{
+    // UdpChannel必须在所属的loop中析构，等析构完成之后才能让loop线程退出
+    for (std::unique_ptr<UdpChannel> &channel : channels_)
+    {
+        EventLoop *ioLoop = channel->getLoop();
+        if (ioLoop->isInLoopThread())
+        {
+            channel.reset();
+            continue;
+        }
+        std::promise<void> done;
+        UdpChannel *ch = channel.release();
+        ioLoop->runInLoop([ch, &done]() {
+            delete ch;
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+// 每个loop创建一个绑定同一端口的UdpChannel
+void UdpServer::start()
+{
+    if (started_++ == 0)
+    {
+        threadPool_->start(threadInitCallback_);
+        std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+        bool reusePort = true;
+        for (EventLoop *ioLoop : loops)
+        {
+            std::unique_ptr<UdpChannel> channel(
+                new UdpChannel(ioLoop, listenAddr_, reusePort, batchSize_, maxDatagramSize_));
+            if (gro_)
+            {
+                channel->enableGro(true);
+            }
+            channel->setMessageCallback(messageCallback_);
+            channel->start();
+            channels_.push_back(std::move(channel));
+        }
+        LOG_INFO("UdpServer::start [%s] %s on %zu loops", name_.c_str(),
+                 listenAddr_.toIpPort().c_str(), loops.size());
+    }
+}
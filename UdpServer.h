@@ -0,0 +1,61 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "UdpChannel.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/*
+ * UDP服务器
+ * 每个loop各有一个绑定同一端口的UdpChannel(SO_REUSEPORT)，内核按对端地址的哈希把数据报分散到各个loop，
+ * 同一个对端的数据报总是落在同一个loop上，回调中用UdpChannel::send回复即可
+ *
+ * UdpServer server(&loop, InetAddress(9000), "dns");
+ * server.setMessageCallback([](UdpChannel *ch, const char *data, size_t len,
+ *                              const InetAddress &peer, Timestamp) { ch->send(data, len, peer); });
+ * server.setThreadNum(4);
+ * server.start();
+ */
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+    UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg);
+    ~UdpServer();
+
+    // 以下设置需在start之前调用
+    void setThreadNum(int numThreads);
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setMessageCallback(const UdpChannel::MessageCallback &cb) { messageCallback_ = cb; }
+    // 每次recvmmsg/sendmmsg处理的数据报个数，以及单个数据报的最大长度
+    void setBatchSize(int batchSize) { batchSize_ = batchSize; }
+    void setMaxDatagramSize(size_t size) { maxDatagramSize_ = size; }
+    // 开启UDP GRO
+    void enableGro(bool on) { gro_ = on; }
+
+    void start();
+
+    const std::string &name() const { return name_; }
+    // 各loop上的UdpChannel，start之后可以读取统计
+    const std::vector<std::unique_ptr<UdpChannel>> &channels() const { return channels_; }
+
+private:
+    EventLoop *loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::unique_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    UdpChannel::MessageCallback messageCallback_;
+    int batchSize_;
+    size_t maxDatagramSize_;
+    bool gro_;
+    std::atomic_int started_;
+    std::vector<std::unique_ptr<UdpChannel>> channels_;
+};
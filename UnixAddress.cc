@@ -0,0 +1,55 @@
+#include "UnixAddress.h"
+#include "Logger.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+UnixAddress::UnixAddress(const std::string &path)
+{
+    bzero(&addr_, sizeof(addr_));
+    addr_.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr_.sun_path))
+    {
+        LOG_FATAL("%s:%s:%d unix socket path too long:%s \n", __FILE__, __FUNCTION__, __LINE__, path.c_str());
+    }
+    memcpy(addr_.sun_path, path.data(), path.size());
+    if (path.empty())
+    {
+        len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path));
+    }
+    else if (path[0] == '@')
+    {
+        // 抽象地址按长度区分，不以'\0'结尾
+        addr_.sun_path[0] = '\0';
+        len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size());
+    }
+    else
+    {
+        len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+    }
+}
+
+std::string UnixAddress::toPath() const
+{
+    size_t offset = offsetof(sockaddr_un, sun_path);
+    if (len_ <= offset)
+    {
+        return std::string(); // 未绑定地址的socket
+    }
+    if (isAbstract())
+    {
+        return "@" + std::string(addr_.sun_path + 1, len_ - offset - 1);
+    }
+    return std::string(addr_.sun_path, strnlen(addr_.sun_path, len_ - offset));
+}
+
+bool UnixAddress::isAbstract() const
+{
+    return len_ > offsetof(sockaddr_un, sun_path) && addr_.sun_path[0] == '\0';
+}
+
+bool UnixAddress::valid() const
+{
+    return len_ > offsetof(sockaddr_un, sun_path);
+}
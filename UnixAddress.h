@@ -0,0 +1,31 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+
+/*
+ * 封装Unix域socket地址
+ * 以'@'开头的路径表示Linux的抽象命名空间(sun_path[0]为'\0')，不在文件系统中创建文件，进程退出后自动消失
+ */
+class UnixAddress
+{
+public:
+    explicit UnixAddress(const std::string &path = "");
+    UnixAddress(const sockaddr_un &addr, socklen_t len)
+        : addr_(addr)
+        , len_(len)
+    {}
+
+    // 文件系统路径，抽象地址以'@'开头
+    std::string toPath() const;
+    bool isAbstract() const;
+    // 空路径构造的地址无效，不能用来bind或connect
+    bool valid() const;
+
+    const sockaddr_un* getSockAddr() const { return &addr_; }
+    socklen_t length() const { return len_; }
+private:
+    sockaddr_un addr_;
+    socklen_t len_;
+};
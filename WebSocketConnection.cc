@@ -0,0 +1,426 @@
+#include "WebSocketConnection.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// 单个消息默认的上限，与HttpParser的请求体上限一致
+const size_t kDefaultMaxMessageSize = 64 * 1024 * 1024;
+// 控制帧的负载不能超过125字节
+const size_t kMaxControlPayload = 125;
+
+void unmaskScalar(char *dst, const char *src, size_t len, const uint8_t key[4])
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        dst[i] = static_cast<char>(src[i] ^ key[i & 3]);
+    }
+}
+
+#if defined(__x86_64__)
+// 4字节的掩码重复成一个向量，负载的起点与向量对齐，所以每个向量用同一个掩码
+// 先load再store，dst不在src之后时前面的store不会覆盖还没读取的数据
+void unmaskSse2(char *dst, const char *src, size_t len, const uint8_t key[4])
+{
+    uint32_t k;
+    memcpy(&k, key, 4);
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(k));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(v, mask));
+    }
+    unmaskScalar(dst + i, src + i, len - i, key);
+}
+
+__attribute__((target("avx2")))
+void unmaskAvx2(char *dst, const char *src, size_t len, const uint8_t key[4])
+{
+    uint32_t k;
+    memcpy(&k, key, 4);
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(k));
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(v0, mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_xor_si256(v1, mask));
+    }
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(v, mask));
+    }
+    unmaskScalar(dst + i, src + i, len - i, key);
+}
+#endif
+
+using UnmaskFunc = void (*)(char*, const char*, size_t, const uint8_t*);
+
+// 启动时按CPU支持的指令集选择一次
+UnmaskFunc selectUnmask()
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return unmaskAvx2;
+    }
+    return unmaskSse2;
+#else
+    return unmaskScalar;
+#endif
+}
+
+const UnmaskFunc g_unmask = selectUnmask();
+
+uint64_t readBigEndian(const char *p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+        value = (value << 8) | static_cast<uint8_t>(p[i]);
+    }
+    return value;
+}
+} // namespace
+
+WebSocketConnection::WebSocketConnection(const TcpConnectionPtr &conn)
+    : conn_(conn)
+    , messageBytes_(0)
+    , scanned_(0)
+    , messageOpcode_(kContinuation)
+    , maxMessageSize_(kDefaultMaxMessageSize)
+    , opened_(false)
+    , closeSent_(false)
+    , closed_(false)
+    , batching_(false)
+{
+}
+
+WebSocketConnection::~WebSocketConnection()
+{
+}
+
+bool WebSocketConnection::connected() const
+{
+    TcpConnectionPtr conn = conn_.lock();
+    return !closed_ && conn && conn->connected();
+}
+
+void WebSocketConnection::unmask(char *dst, const char *src, size_t len, const uint8_t key[4])
+{
+    g_unmask(dst, src, len, key);
+}
+
+size_t WebSocketConnection::encodeHeader(char *header, Opcode opcode, size_t payloadLen)
+{
+    header[0] = static_cast<char>(0x80 | opcode);
+    if (payloadLen < 126)
+    {
+        header[1] = static_cast<char>(payloadLen);
+        return 2;
+    }
+    else if (payloadLen <= 0xFFFF)
+    {
+        header[1] = 126;
+        header[2] = static_cast<char>(payloadLen >> 8);
+        header[3] = static_cast<char>(payloadLen);
+        return 4;
+    }
+    header[1] = 127;
+    for (int i = 0; i < 8; ++i)
+    {
+        header[2 + i] = static_cast<char>(static_cast<uint64_t>(payloadLen) >> (56 - 8 * i));
+    }
+    return 10;
+}
+
+// loop线程中拼在frameBuffer_里，解析过程中产生的帧等本次onMessage结束时一起发出
+// 其他线程用临时的Buffer，每个帧都只调用一次conn->send
+void WebSocketConnection::sendFrame(Opcode opcode, const char *data, size_t len)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        return;
+    }
+    char header[10];
+    size_t headerLen = encodeHeader(header, opcode, len);
+    if (conn->getLoop()->isInLoopThread())
+    {
+        frameBuffer_.append(header, headerLen);
+        frameBuffer_.append(data, len);
+        if (!batching_)
+        {
+            conn->send(&frameBuffer_);
+        }
+    }
+    else
+    {
+        Buffer frame(headerLen + len);
+        frame.append(header, headerLen);
+        frame.append(data, len);
+        conn->send(&frame);
+    }
+}
+
+void WebSocketConnection::send(Buffer *payload, Opcode opcode)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        payload->retrieveAll();
+        return;
+    }
+    char header[10];
+    size_t headerLen = encodeHeader(header, opcode, payload->readableBytes());
+    // 解析过程中frameBuffer_里可能还有没发出的帧，为了保持顺序只能拷贝过去
+    bool batching = conn->getLoop()->isInLoopThread() && batching_;
+    if (!batching && payload->prependableBytes() >= headerLen)
+    {
+        payload->prepend(header, headerLen);
+        conn->send(payload);
+    }
+    else
+    {
+        sendFrame(opcode, payload->peek(), payload->readableBytes());
+        payload->retrieveAll();
+    }
+}
+
+void WebSocketConnection::close(uint16_t code, const std::string &reason)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        return;
+    }
+    std::shared_ptr<WebSocketConnection> self(shared_from_this());
+    conn->getLoop()->runInLoop([self, code, reason]() {
+        if (self->closeSent_ || self->closed_)
+        {
+            return;
+        }
+        std::string payload;
+        payload.reserve(2 + reason.size());
+        payload.push_back(static_cast<char>(code >> 8));
+        payload.push_back(static_cast<char>(code));
+        payload.append(reason, 0, kMaxControlPayload - 2);
+        self->sendFrame(kClose, payload.data(), payload.size());
+        self->closeSent_ = true;
+    });
+}
+
+// 协议错误：发出带错误码的close帧并关闭连接，之后收到的数据全部丢弃
+void WebSocketConnection::fail(const TcpConnectionPtr &conn, uint16_t code)
+{
+    LOG_ERROR("WebSocketConnection [%s] protocol error, close code = %d", conn->name().c_str(), code);
+    if (!closeSent_)
+    {
+        char payload[2] = { static_cast<char>(code >> 8), static_cast<char>(code) };
+        sendFrame(kClose, payload, sizeof payload);
+        closeSent_ = true;
+    }
+    closed_ = true;
+    flush(conn);
+    conn->shutdown();
+}
+
+void WebSocketConnection::handleControl(const TcpConnectionPtr &conn, Opcode opcode, const char *data, size_t len)
+{
+    switch (opcode)
+    {
+    case kPing:
+        sendFrame(kPong, data, len);
+        break;
+    case kPong:
+        break;
+    case kClose:
+        // 对方先发close时原样回复状态码，我们先发的close则这里是对方的确认
+        if (!closeSent_)
+        {
+            sendFrame(kClose, data, len < 2 ? 0 : 2);
+            closeSent_ = true;
+        }
+        closed_ = true;
+        flush(conn);
+        conn->shutdown();
+        break;
+    default:
+        break;
+    }
+}
+
+void WebSocketConnection::flush(const TcpConnectionPtr &conn)
+{
+    if (frameBuffer_.readableBytes() > 0)
+    {
+        conn->send(&frameBuffer_);
+    }
+}
+
+// 回调中发送的帧(例如echo)和pong都先攒在frameBuffer_中，处理完一次读到的所有帧后合并成一次写，
+// 避免许多小帧各自一次write，也避免Nagle算法和延迟确认造成的停顿
+void WebSocketConnection::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    // 跟在握手请求后面的数据可能先于排队的onOpen到达，保证打开的回调在第一个消息之前
+    onOpen();
+    batching_ = true;
+    parseFrames(conn, buf);
+    batching_ = false;
+    flush(conn);
+}
+
+/*
+ * 每个帧等完整收到后才处理，帧头声明的长度先和上限比较，不会为超大的帧无限制地缓存
+ * 数据帧的负载从scanned_之后解掩码并搬到messageBytes_处，最后一个分片到达时
+ * [peek(), peek() + messageBytes_)就是完整的消息，回调之后一次retrieve掉所有已处理的帧
+ */
+void WebSocketConnection::parseFrames(const TcpConnectionPtr &conn, Buffer *buf)
+{
+    while (!closed_)
+    {
+        const size_t readable = buf->readableBytes();
+        if (readable - scanned_ < 2)
+        {
+            return;
+        }
+        char *frame = buf->beginRead() + scanned_;
+        const uint8_t b0 = static_cast<uint8_t>(frame[0]);
+        const uint8_t b1 = static_cast<uint8_t>(frame[1]);
+        const bool fin = (b0 & 0x80) != 0;
+        const Opcode opcode = static_cast<Opcode>(b0 & 0x0F);
+        // 没有协商扩展，RSV必须为0；客户端发来的帧必须带掩码
+        if ((b0 & 0x70) != 0 || (b1 & 0x80) == 0)
+        {
+            fail(conn, 1002);
+            break;
+        }
+
+        size_t headerLen = 2;
+        uint64_t payloadLen = b1 & 0x7F;
+        if (payloadLen == 126)
+        {
+            headerLen += 2;
+        }
+        else if (payloadLen == 127)
+        {
+            headerLen += 8;
+        }
+        if (readable - scanned_ < headerLen + 4)
+        {
+            return;
+        }
+        if (headerLen > 2)
+        {
+            payloadLen = readBigEndian(frame + 2, static_cast<int>(headerLen - 2));
+        }
+        uint8_t key[4];
+        memcpy(key, frame + headerLen, 4);
+        headerLen += 4;
+
+        const bool control = (opcode & 0x08) != 0;
+        if (control)
+        {
+            if (!fin || payloadLen > kMaxControlPayload || opcode > kPong)
+            {
+                fail(conn, 1002);
+                break;
+            }
+        }
+        else
+        {
+            // 分片消息中间只能是continuation，消息开头不能是continuation
+            bool inMessage = messageOpcode_ != kContinuation;
+            if (opcode > kBinary || (opcode == kContinuation) != inMessage)
+            {
+                fail(conn, 1002);
+                break;
+            }
+            if (payloadLen > maxMessageSize_ - messageBytes_)
+            {
+                fail(conn, 1009);
+                break;
+            }
+        }
+
+        if (readable - scanned_ - headerLen < payloadLen)
+        {
+            // 帧还不完整，提前为剩下的部分留出空间
+            buf->ensureWritableBytes(headerLen + payloadLen - (readable - scanned_));
+            return;
+        }
+
+        const size_t len = static_cast<size_t>(payloadLen);
+        char *payload = frame + headerLen;
+        scanned_ += headerLen + len;
+        if (control)
+        {
+            unmask(payload, payload, len, key);
+            handleControl(conn, opcode, payload, len);
+            // 不在分片消息中时，处理过的控制帧可以直接丢弃
+            if (messageOpcode_ == kContinuation)
+            {
+                buf->retrieve(scanned_);
+                scanned_ = 0;
+            }
+            continue;
+        }
+
+        unmask(buf->beginRead() + messageBytes_, payload, len, key);
+        messageBytes_ += len;
+        if (opcode != kContinuation)
+        {
+            messageOpcode_ = opcode;
+        }
+        if (fin)
+        {
+            bool binary = messageOpcode_ == kBinary;
+            size_t messageBytes = messageBytes_;
+            size_t consumed = scanned_;
+            messageBytes_ = 0;
+            scanned_ = 0;
+            messageOpcode_ = kContinuation;
+            if (messageCallback_)
+            {
+                messageCallback_(shared_from_this(), buf->peek(), messageBytes, binary);
+            }
+            buf->retrieve(consumed);
+        }
+    }
+    // 连接已经关闭，之后的数据不再解析
+    buf->retrieveAll();
+    messageBytes_ = 0;
+    scanned_ = 0;
+}
+
+void WebSocketConnection::onOpen()
+{
+    if (opened_)
+    {
+        return;
+    }
+    opened_ = true;
+    if (connectionCallback_)
+    {
+        connectionCallback_(shared_from_this());
+    }
+}
+
+void WebSocketConnection::onDisconnected()
+{
+    closed_ = true;
+    if (opened_ && connectionCallback_)
+    {
+        connectionCallback_(shared_from_this());
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+class TcpConnection;
+
+/*
+ * 升级之后的一个WebSocket连接(服务端)，由WebSocketServer创建，随TcpConnection的MessageCallback存活
+ *
+ * 收：在连接的inputBuffer_中增量解析帧，客户端的帧必须带掩码
+ * 数据帧的负载用SIMD解掩码，同时向前搬移到上一个分片的末尾，分片消息在原缓冲区中拼成连续的一段，
+ * 不经过额外的拼接缓冲区；控制帧(ping/pong/close)可以夹在分片之间，处理后被后续的分片覆盖
+ * 发：服务端的帧不带掩码，send(Buffer*)把帧头直接写进payload前面的预留空间
+ * 解析一次读到的数据期间(包括消息回调中)发送的帧先攒起来，解析完合并成一次写
+ */
+class WebSocketConnection : noncopyable,
+                            public std::enable_shared_from_this<WebSocketConnection>
+{
+public:
+    enum Opcode
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xA,
+    };
+
+    explicit WebSocketConnection(const TcpConnectionPtr &conn);
+    ~WebSocketConnection();
+
+    // 底层的TCP连接已经断开时返回空
+    TcpConnectionPtr connection() const { return conn_.lock(); }
+    bool connected() const;
+
+    void sendText(const std::string &text) { sendFrame(kText, text.data(), text.size()); }
+    void sendBinary(const void *data, size_t len) { sendFrame(kBinary, static_cast<const char*>(data), len); }
+    // payload已经写在buf中，帧头写进buf的预留空间，不再拷贝payload，发送之后buf被清空
+    void send(Buffer *payload, Opcode opcode = kBinary);
+    void ping(const std::string &data = std::string()) { sendFrame(kPing, data.data(), data.size()); }
+    // 发送close帧，对方回复close后关闭TCP连接
+    void close(uint16_t code = 1000, const std::string &reason = std::string());
+
+    // 单个消息(所有分片合计)的上限，超过时以1009关闭连接
+    void setMaxMessageSize(size_t bytes) { maxMessageSize_ = bytes; }
+
+    // 由WebSocketServer设置
+    void setMessageCallback(const WebSocketMessageCallback &cb) { messageCallback_ = cb; }
+    void setConnectionCallback(const WebSocketConnectionCallback &cb) { connectionCallback_ = cb; }
+
+    // 握手应答发出后调用，只有第一次调用有效
+    void onOpen();
+    // 接管TcpConnection的MessageCallback，解析buf中的帧
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    // TcpConnection断开时调用，打开过的连接才会回调
+    void onDisconnected();
+
+    // dst[i] = src[i] ^ key[i % 4]，dst可以和src相同或者在src之前(重叠时向前搬移)
+    // 运行时选择AVX2、SSE2或者逐字节的实现
+    static void unmask(char *dst, const char *src, size_t len, const uint8_t key[4]);
+
+private:
+    void sendFrame(Opcode opcode, const char *data, size_t len);
+    void handleControl(const TcpConnectionPtr &conn, Opcode opcode, const char *data, size_t len);
+    void parseFrames(const TcpConnectionPtr &conn, Buffer *buf);
+    void fail(const TcpConnectionPtr &conn, uint16_t code);
+    void flush(const TcpConnectionPtr &conn);
+    // 帧头的长度，payloadLen按长度选择7位、16位或64位的编码
+    static size_t encodeHeader(char *header, Opcode opcode, size_t payloadLen);
+
+    std::weak_ptr<TcpConnection> conn_;
+    WebSocketMessageCallback messageCallback_;
+    WebSocketConnectionCallback connectionCallback_;
+
+    // 相对buf->peek()的偏移：[0, messageBytes_)是当前消息已经解掩码拼好的部分，scanned_是下一个帧头的位置
+    size_t messageBytes_;
+    size_t scanned_;
+    Opcode messageOpcode_;  // 当前分片消息的类型，kContinuation表示不在分片消息中
+    size_t maxMessageSize_;
+    bool opened_;
+    bool closeSent_;
+    bool closed_;
+    bool batching_;         // 正在onMessage中解析，loop线程中发送的帧先攒在frameBuffer_里
+    Buffer frameBuffer_;    // loop线程中待发送的帧
+};
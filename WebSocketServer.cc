@@ -0,0 +1,207 @@
+#include "WebSocketServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace
+{
+const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+uint32_t rotateLeft(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+// 握手只需要对几十字节算一次SHA1，不值得为此引入OpenSSL
+void sha1(const std::string &message, uint8_t digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    std::string data(message);
+    uint64_t bitLen = static_cast<uint64_t>(message.size()) * 8;
+    data.push_back(static_cast<char>(0x80));
+    while (data.size() % 64 != 56)
+    {
+        data.push_back('\0');
+    }
+    for (int i = 7; i >= 0; --i)
+    {
+        data.push_back(static_cast<char>(bitLen >> (i * 8)));
+    }
+
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+        {
+            const uint8_t *p = reinterpret_cast<const uint8_t*>(data.data() + chunk + i * 4);
+            w[i] = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+                 | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i)
+        {
+            w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+    }
+}
+
+std::string base64Encode(const uint8_t *data, size_t len)
+{
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    result.reserve((len + 2) / 3 * 4);
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t n = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < len) n |= static_cast<uint32_t>(data[i + 1]) << 8;
+        if (i + 2 < len) n |= data[i + 2];
+        result.push_back(kAlphabet[(n >> 18) & 0x3F]);
+        result.push_back(kAlphabet[(n >> 12) & 0x3F]);
+        result.push_back(i + 1 < len ? kAlphabet[(n >> 6) & 0x3F] : '=');
+        result.push_back(i + 2 < len ? kAlphabet[n & 0x3F] : '=');
+    }
+    return result;
+}
+
+// Connection头部可能是逗号分隔的列表，例如"keep-alive, Upgrade"
+bool containsToken(const StringPiece &value, const StringPiece &token)
+{
+    size_t i = 0;
+    while (i < value.size())
+    {
+        while (i < value.size() && (value[i] == ' ' || value[i] == '\t' || value[i] == ','))
+        {
+            ++i;
+        }
+        size_t start = i;
+        while (i < value.size() && value[i] != ',')
+        {
+            ++i;
+        }
+        size_t end = i;
+        while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t'))
+        {
+            --end;
+        }
+        if (StringPiece(value.data() + start, end - start).equalsIgnoreCase(token))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+WebSocketServer::WebSocketServer(EventLoop *loop,
+                                 const InetAddress &listenAddr,
+                                 const std::string &name,
+                                 TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , maxMessageSize_(0)
+{
+    server_.setUpgradeCallback(std::bind(&WebSocketServer::onUpgrade, this, std::placeholders::_1,
+                                         std::placeholders::_2, std::placeholders::_3));
+}
+
+std::string WebSocketServer::acceptKey(const StringPiece &key)
+{
+    uint8_t digest[20];
+    sha1(key.toString() + kWebSocketGuid, digest);
+    return base64Encode(digest, sizeof digest);
+}
+
+/*
+ * 校验握手请求，不合法时返回空的MessageCallback，请求按普通HTTP处理
+ * 通过时填写101应答，返回的MessageCallback持有WebSocketConnection，之后由它解析帧
+ */
+MessageCallback WebSocketServer::onUpgrade(const TcpConnectionPtr &conn, const HttpRequest &req, HttpResponse *resp)
+{
+    StringPiece key = req.getHeader("Sec-WebSocket-Key");
+    if (req.method() != HttpRequest::kGet
+        || req.version() != HttpRequest::kHttp11
+        || !req.getHeader("Upgrade").equalsIgnoreCase("websocket")
+        || !containsToken(req.getHeader("Connection"), "Upgrade")
+        || req.getHeader("Sec-WebSocket-Version") != "13"
+        || key.empty())
+    {
+        LOG_INFO("WebSocketServer - bad handshake from %s", conn->peerAddress().toIpPort().c_str());
+        return MessageCallback();
+    }
+
+    resp->setStatusCode(HttpResponse::k101SwitchingProtocols);
+    resp->addHeader("Upgrade", "websocket");
+    resp->addHeader("Connection", "Upgrade");
+    resp->addHeader("Sec-WebSocket-Accept", acceptKey(key));
+
+    WebSocketConnectionPtr ws = std::make_shared<WebSocketConnection>(conn);
+    ws->setMessageCallback(messageCallback_);
+    ws->setConnectionCallback(connectionCallback_);
+    if (maxMessageSize_ > 0)
+    {
+        ws->setMaxMessageSize(maxMessageSize_);
+    }
+    // TcpConnection断开时通知ws，ws只持有TcpConnection的weak_ptr，不会形成循环引用
+    conn->setConnectionCallback([ws](const TcpConnectionPtr &c) {
+        if (!c->connected())
+        {
+            ws->onDisconnected();
+        }
+    });
+    // 101应答在本回调返回后才写入连接，打开的回调排到之后执行，回调中发送的数据在101之后
+    conn->getLoop()->queueInLoop([ws]() {
+        if (ws->connected())
+        {
+            ws->onOpen();
+        }
+    });
+    return std::bind(&WebSocketConnection::onMessage, ws, std::placeholders::_1,
+                     std::placeholders::_2, std::placeholders::_3);
+}
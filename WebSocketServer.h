@@ -0,0 +1,49 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "HttpServer.h"
+#include "Callbacks.h"
+#include "WebSocketConnection.h"
+
+#include <string>
+
+/*
+ * 基于HttpServer的WebSocket服务器(RFC 6455)
+ * 带Upgrade: websocket的请求完成握手后，连接的MessageCallback换成WebSocketConnection的帧解析，
+ * 其余请求仍然交给HttpCallback，同一个端口可以同时提供普通HTTP服务
+ *
+ * WebSocketServer server(&loop, InetAddress(8000), "ws");
+ * server.setMessageCallback([](const WebSocketConnectionPtr &ws, const char *data, size_t len, bool binary) {
+ *     ws->sendBinary(data, len);
+ * });
+ * server.start();
+ */
+class WebSocketServer : noncopyable
+{
+public:
+    WebSocketServer(EventLoop *loop,
+                    const InetAddress &listenAddr,
+                    const std::string &name,
+                    TcpServer::Option option = TcpServer::kNoReusePort);
+
+    // 以下需在start之前设置
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setHttpCallback(const HttpServer::HttpCallback &cb) { server_.setHttpCallback(cb); }
+    // 握手完成(101已经发出)和连接断开时调用，用connected()区分
+    void setConnectionCallback(const WebSocketConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const WebSocketMessageCallback &cb) { messageCallback_ = cb; }
+    void setMaxMessageSize(size_t bytes) { maxMessageSize_ = bytes; }
+
+    void start() { server_.start(); }
+
+    // Sec-WebSocket-Accept = base64(SHA1(key + GUID))
+    static std::string acceptKey(const StringPiece &key);
+
+private:
+    MessageCallback onUpgrade(const TcpConnectionPtr &conn, const HttpRequest &req, HttpResponse *resp);
+
+    HttpServer server_;
+    WebSocketConnectionCallback connectionCallback_;
+    WebSocketMessageCallback messageCallback_;
+    size_t maxMessageSize_;
+};
@@ -0,0 +1,364 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/Channel.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Buffer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Histogram.h>
+#include <mymuduo/Logger.h>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 连接规模测试：空闲连接的内存占用和TcpServer接受连接的速度
+ * ./conn_scale [connections] [sourceIps] [serverThreads] [port]
+ *
+ * fork出的子进程运行TcpServer，父进程用非阻塞connect从127.0.0.1 ~ 127.0.0.<sourceIps>
+ * 这些源地址建立连接(每个源地址最多约6.4万个端口)，之后全部关闭，输出一行JSON：
+ *   accept_rate               从第一个connect到最后一个ConnectionCallback的平均速度
+ *   connect_latency_ns        connect()调用到服务器ConnectionCallback执行的时间分布
+ *   rss_per_conn              服务器进程RssAnon的增量/连接数，不含内核中的socket缓冲区
+ *   heap_per_conn             服务器进程operator new分配且仍未释放的字节数增量/连接数
+ *   breakdown                 按组件估算的每连接堆内存，other为实测值与各项之和的差(回调对象等)
+ *   teardown_ms               客户端全部关闭到服务器处理完所有断开的时间
+ * 两个进程各自受RLIMIT_NOFILE限制，连接数会被截到fd上限以内
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static const int kMaxSourceIps = 16;
+static const int kInFlight = 512;  // 已发起connect但服务器还没回调的连接数上限，防止超过listen的backlog
+
+// 统计operator new分配、尚未释放的字节数(按malloc_usable_size计)
+static std::atomic<int64_t> g_liveHeapBytes(0);
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    g_liveHeapBytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p != nullptr)
+    {
+        g_liveHeapBytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+        free(p);
+    }
+}
+
+static int64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// 父子进程共享的状态，放在fork之前mmap的MAP_SHARED内存中
+struct Shared
+{
+    std::atomic<int> ready;
+    std::atomic<int64_t> established;   // 累计的连接建立回调次数
+    std::atomic<int64_t> connected;     // 当前的连接数
+    std::atomic<int64_t> lastEventNs;   // 最近一次连接建立或断开的时刻
+    std::atomic<int64_t> liveHeapBytes;
+    std::mutex mutex;                   // 只在子进程的多个loop之间使用
+    Histogram latency;
+    int64_t connectNs[kMaxSourceIps * 65536];   // 按(源地址序号, 源端口)记录connect()的时刻
+};
+
+static int slotOf(const sockaddr_in &addr)
+{
+    int ipIndex = (ntohl(addr.sin_addr.s_addr) & 0xff) - 1;
+    return ipIndex * 65536 + ntohs(addr.sin_port);
+}
+
+static void runServer(Shared *shared, uint16_t port, int threads)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "0.0.0.0"), "conn-scale");
+    server.setThreadNum(threads);
+    server.setConnectionCallback([shared](const TcpConnectionPtr &conn) {
+        int64_t now = nowNanos();
+        if (conn->connected())
+        {
+            int64_t start = shared->connectNs[slotOf(*conn->peerAddress().getSockAddr())];
+            {
+                std::unique_lock<std::mutex> lock(shared->mutex);
+                shared->latency.record(now > start ? now - start : 0);
+            }
+            ++shared->connected;
+            ++shared->established;
+        }
+        else
+        {
+            --shared->connected;
+        }
+        shared->lastEventNs = now;
+        shared->liveHeapBytes = g_liveHeapBytes.load(std::memory_order_relaxed);
+    });
+    server.start();
+    loop.runInLoop([shared]() {
+        shared->liveHeapBytes = g_liveHeapBytes.load(std::memory_order_relaxed);
+        shared->ready = 1;
+    });
+    loop.loop();
+}
+
+// /proc/<pid>/status中的RssAnon，字节
+static int64_t rssAnon(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof path, "/proc/%d/status", static_cast<int>(pid));
+    FILE *fp = ::fopen(path, "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    char line[256];
+    int64_t kb = 0;
+    while (::fgets(line, sizeof line, fp) != nullptr)
+    {
+        if (strncmp(line, "RssAnon:", 8) == 0)
+        {
+            kb = atoll(line + 8);
+            break;
+        }
+    }
+    ::fclose(fp);
+    return kb * 1024;
+}
+
+static int raiseFdLimit()
+{
+    rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+    return static_cast<int>(rl.rlim_cur);
+}
+
+// func执行前后存活的堆内存的增量，func创建的对象需由调用者持有到返回之后
+static int64_t heapBytes(const std::function<void()> &func)
+{
+    int64_t before = g_liveHeapBytes.load();
+    func();
+    return g_liveHeapBytes.load() - before;
+}
+
+static int64_t mallocSize(size_t size)
+{
+    void *p = malloc(size);
+    int64_t usable = malloc_usable_size(p);
+    free(p);
+    return usable;
+}
+
+// 按组件估算每个连接占用的堆内存，连接名与TcpServer::newConnection的格式一致
+static std::string breakdown(int64_t measuredPerConn)
+{
+    std::vector<std::pair<const char*, int64_t>> items;
+    items.push_back({ "tcp_connection", mallocSize(sizeof(TcpConnection)) });
+    items.push_back({ "shared_ptr_control", mallocSize(sizeof(std::shared_ptr<int>) + sizeof(void*)) });
+    items.push_back({ "socket", mallocSize(sizeof(Socket)) });
+    items.push_back({ "channel", mallocSize(sizeof(Channel)) });
+
+    std::unique_ptr<Buffer> buffer;
+    items.push_back({ "buffers", 2 * heapBytes([&buffer]() { buffer.reset(new Buffer); }) - 2 * mallocSize(sizeof(Buffer)) });
+    buffer.reset();
+
+    std::unique_ptr<std::deque<int>> fds;
+    std::unique_ptr<std::deque<std::pair<size_t, int>>> pendingFds;
+    items.push_back({ "fd_deques", heapBytes([&]() {
+        fds.reset(new std::deque<int>);
+        pendingFds.reset(new std::deque<std::pair<size_t, int>>);
+    }) - mallocSize(sizeof(std::deque<int>)) - mallocSize(sizeof(std::deque<std::pair<size_t, int>>)) });
+    fds.reset();
+    pendingFds.reset();
+
+    std::string name;
+    items.push_back({ "name", heapBytes([&name]() { name = "conn-scale-0.0.0.0:9030#1000000"; }) });
+
+    // 连接名在TcpConnection和connections_的key中各有一份
+    std::unordered_map<std::string, std::shared_ptr<int>> map;
+    map.reserve(16);
+    items.push_back({ "map_entry", heapBytes([&map, &name]() { map[name]; }) });
+
+    std::string json = "{";
+    int64_t sum = 0;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        json += "\"" + std::string(items[i].first) + "\":" + std::to_string(items[i].second) + ",";
+        sum += items[i].second;
+    }
+    json += "\"other\":" + std::to_string(measuredPerConn - sum) + "}";
+    return json;
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 100000;
+    int sourceIps = std::max(1, std::min(kMaxSourceIps, argc > 2 ? atoi(argv[2]) : 4));
+    int serverThreads = argc > 3 ? atoi(argv[3]) : 0;
+    uint16_t port = static_cast<uint16_t>(argc > 4 ? atoi(argv[4]) : 9030);
+
+    Logger::setLogLevel(ERROR);
+    ::signal(SIGPIPE, SIG_IGN);
+    int fdLimit = raiseFdLimit();
+    int maxConnections = std::min(fdLimit - 64, sourceIps * (65535 - 1024));
+    if (connections > maxConnections)
+    {
+        fprintf(stderr, "connections limited to %d by RLIMIT_NOFILE=%d and %d source ips\n",
+                maxConnections, fdLimit, sourceIps);
+        connections = maxConnections;
+    }
+
+    void *mem = ::mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    Shared *shared = new (mem) Shared;
+    shared->ready = 0;
+    shared->established = 0;
+    shared->connected = 0;
+    shared->lastEventNs = 0;
+    shared->liveHeapBytes = 0;
+
+    pid_t server = ::fork();
+    if (server == 0)
+    {
+        runServer(shared, port, serverThreads);
+        return 0;
+    }
+    while (shared->ready == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int64_t rssBefore = rssAnon(server);
+    int64_t heapBefore = shared->liveHeapBytes;
+
+    sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof serverAddr);
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // 显式绑定源端口，connect之前就知道服务器看到的对端地址，可以先记下connect的时刻
+    std::vector<int> fds;
+    fds.reserve(connections);
+    std::vector<int> nextPort(sourceIps, 1024);
+    int64_t start = nowNanos();
+    int failures = 0;
+    for (int i = 0; i < connections && failures < 1000; ++i)
+    {
+        while (static_cast<int64_t>(fds.size()) - shared->established.load() >= kInFlight)
+        {
+            std::this_thread::yield();
+        }
+        int ipIndex = i % sourceIps;
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_in local;
+        memset(&local, 0, sizeof local);
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + ipIndex);
+        // 上次运行留下的TIME_WAIT不妨碍绑定同一个源端口
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+        bool bound = false;
+        while (!bound && nextPort[ipIndex] <= 65535)
+        {
+            uint16_t p = static_cast<uint16_t>(nextPort[ipIndex]++);
+            if (p == port)
+            {
+                continue;
+            }
+            local.sin_port = htons(p);
+            bound = ::bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof local) == 0;
+        }
+        if (!bound)
+        {
+            ::close(fd);
+            ++failures;
+            continue;
+        }
+        shared->connectNs[slotOf(local)] = nowNanos();
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&serverAddr), sizeof serverAddr) < 0 && errno != EINPROGRESS)
+        {
+            ::close(fd);
+            ++failures;
+            continue;
+        }
+        fds.push_back(fd);
+    }
+
+    int opened = static_cast<int>(fds.size());
+    int64_t deadline = nowNanos() + 30LL * 1000 * 1000 * 1000;
+    while (shared->established.load() < opened && nowNanos() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    int64_t established = shared->established.load();
+    double acceptSeconds = (shared->lastEventNs.load() - start) / 1e9;
+
+    // 等服务器的内存稳定下来
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    int64_t rssConnected = rssAnon(server);
+    int64_t heapConnected = shared->liveHeapBytes;
+
+    int64_t teardownStart = nowNanos();
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    deadline = nowNanos() + 30LL * 1000 * 1000 * 1000;
+    while (shared->connected.load() > 0 && nowNanos() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double teardownMs = (shared->lastEventNs.load() - teardownStart) / 1e6;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int64_t rssAfter = rssAnon(server);
+
+    ::kill(server, SIGTERM);
+    ::waitpid(server, nullptr, 0);
+
+    int64_t n = std::max<int64_t>(1, established);
+    int64_t heapPerConn = (heapConnected - heapBefore) / n;
+    printf("{\"bench\":\"conn_scale\",\"connections\":%lld,\"requested\":%d,\"source_ips\":%d,\"server_threads\":%d,"
+           "\"accept_rate\":%.0f,\"connect_latency_ns\":%s,"
+           "\"rss_before\":%lld,\"rss_connected\":%lld,\"rss_after_teardown\":%lld,\"rss_per_conn\":%lld,"
+           "\"heap_per_conn\":%lld,\"breakdown\":%s,\"teardown_ms\":%.1f}\n",
+           static_cast<long long>(established), connections, sourceIps, serverThreads,
+           established / acceptSeconds, shared->latency.toJson().c_str(),
+           static_cast<long long>(rssBefore), static_cast<long long>(rssConnected), static_cast<long long>(rssAfter),
+           static_cast<long long>((rssConnected - rssBefore) / n),
+           static_cast<long long>(heapPerConn), breakdown(heapPerConn).c_str(), teardownMs);
+    return established == opened ? 0 : 1;
+}
@@ -0,0 +1,361 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Histogram.h>
+#include <mymuduo/Logger.h>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * 开环(open-loop)的定速echo延迟测试
+ *   ./echo_openloop server <port> <threads>
+ *   ./echo_openloop client <ip> <port> <threads> <seconds> <rates> [connections] [size]
+ *   ./echo_openloop [seconds] [rates] [connections] [size]   fork出本机的echo服务器，再跑客户端
+ *
+ * 闭环的压测工具收到应答才发下一个请求，服务器一卡顿客户端就跟着少发，卡顿期间本该发出的请求
+ * 根本没有被测量(coordinated omission)，测出来的高分位延迟偏低
+ * 这里每个连接按固定的间隔排好发送时刻，消息中带着"本该发出的时刻"，延迟从这个时刻算起，
+ * 客户端或服务器卡住时，积压的消息一旦发出，等待的时间也计入延迟
+ * rates是逗号分隔的每秒消息数列表，逐个测试，每个输出一行JSON，延迟单位为纳秒
+ */
+
+static const uint16_t kLocalPort = 9021;
+static const double kTickInterval = 0.0002;    // 发送定时器的间隔，秒
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void runServer(uint16_t port, int threads)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "0.0.0.0"), "echo-openloop", TcpServer::kReusePort);
+    server.setThreadNum(threads);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+    loop.loop();
+}
+
+struct Session
+{
+    std::unique_ptr<TcpClient> client;
+    TcpConnectionPtr conn;      // 只在所属loop中访问
+    int64_t nextSend;           // 下一个消息本该发出的时刻
+};
+
+// 每个loop一份，除了原子计数外只在该loop中访问
+struct LoopState
+{
+    EventLoop *loop;
+    std::vector<Session*> sessions;
+    TimerId timer;
+    Histogram latency;
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> received;
+    std::atomic<int> connected;
+
+    LoopState() : loop(nullptr), sent(0), received(0), connected(0) {}
+};
+
+struct Run
+{
+    size_t size;
+    int64_t interval;           // 每个连接相邻两个消息的间隔，纳秒
+    int64_t recordFrom;         // 预热结束的时刻，之前发出的消息不计入直方图
+    int64_t stopAt;             // 此后不再发送
+    std::string padding;
+};
+
+template <typename Func>
+static void runInAllLoops(std::vector<std::unique_ptr<LoopState>> &states, Func func)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t remaining = states.size();
+    for (std::unique_ptr<LoopState> &s : states)
+    {
+        LoopState *state = s.get();
+        state->loop->runInLoop([&, state]() {
+            func(state);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (--remaining == 0)
+            {
+                cond.notify_one();
+            }
+        });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return remaining == 0; });
+}
+
+// 把到期的消息一次性追加到连接的输出，定时器被推迟时也会按原定时刻补发
+static void sendDue(LoopState *state, const Run *run)
+{
+    int64_t now = nowNanos();
+    for (Session *session : state->sessions)
+    {
+        if (!session->conn)
+        {
+            continue;
+        }
+        Buffer out;
+        while (session->nextSend <= now && session->nextSend < run->stopAt)
+        {
+            int64_t intended = session->nextSend;
+            out.append(reinterpret_cast<const char*>(&intended), sizeof intended);
+            out.append(run->padding.data(), run->padding.size());
+            session->nextSend += run->interval;
+            state->sent.store(state->sent.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        if (out.readableBytes() > 0)
+        {
+            session->conn->send(&out);
+        }
+    }
+}
+
+static void onEcho(LoopState *state, const Run *run, Buffer *buf)
+{
+    int64_t now = nowNanos();
+    uint64_t count = 0;
+    while (buf->readableBytes() >= run->size)
+    {
+        int64_t intended;
+        memcpy(&intended, buf->peek(), sizeof intended);
+        buf->retrieve(run->size);
+        if (intended >= run->recordFrom)
+        {
+            state->latency.record(static_cast<uint64_t>(now - intended));
+        }
+        ++count;
+    }
+    state->received.store(state->received.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+static std::string runRate(std::vector<std::unique_ptr<LoopState>> &states, const InetAddress &serverAddr,
+                           int seconds, int rate, int connections, size_t size)
+{
+    Run run;
+    run.size = size;
+    run.interval = static_cast<int64_t>(1e9 * connections / rate);
+    run.recordFrom = INT64_MAX;
+    run.stopAt = INT64_MAX;
+    run.padding.assign(size - sizeof(int64_t), 'o');
+
+    std::vector<std::unique_ptr<Session>> sessions;
+    for (int i = 0; i < connections; ++i)
+    {
+        sessions.emplace_back(new Session);
+        sessions.back()->nextSend = INT64_MAX;
+    }
+
+    runInAllLoops(states, [&](LoopState *state) {
+        size_t index = 0;
+        while (states[index].get() != state)
+        {
+            ++index;
+        }
+        state->sessions.clear();
+        state->latency.reset();
+        state->sent = 0;
+        state->received = 0;
+        state->connected = 0;
+        for (size_t i = index; i < sessions.size(); i += states.size())
+        {
+            Session *session = sessions[i].get();
+            state->sessions.push_back(session);
+            session->client.reset(new TcpClient(state->loop, serverAddr, "echo-openloop-client"));
+            session->client->setConnectionCallback([state, session](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    session->conn = conn;
+                    ++state->connected;
+                }
+                else
+                {
+                    session->conn.reset();
+                }
+            });
+            session->client->setMessageCallback([state, &run](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+                onEcho(state, &run, buf);
+            });
+            session->client->connect();
+        }
+    });
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        int connected = 0;
+        for (std::unique_ptr<LoopState> &s : states)
+        {
+            connected += s->connected;
+        }
+        if (connected == connections)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // 各连接的发送时刻错开，避免所有连接在同一时刻突发；前1/5的时间(最多1秒)用于预热
+    int64_t start = nowNanos() + 10 * 1000 * 1000;
+    int64_t warmup = std::min<int64_t>(1000LL * 1000 * 1000, seconds * 200LL * 1000 * 1000);
+    run.recordFrom = start + warmup;
+    run.stopAt = start + warmup + seconds * 1000LL * 1000 * 1000;
+    runInAllLoops(states, [&](LoopState *state) {
+        for (size_t i = 0; i < state->sessions.size(); ++i)
+        {
+            state->sessions[i]->nextSend = start + run.interval * static_cast<int64_t>(i) / state->sessions.size();
+        }
+        state->timer = state->loop->runEvery(kTickInterval, [state, &run]() { sendDue(state, &run); });
+    });
+
+    // 多等10毫秒，保证stopAt之前到期的消息都已由定时器发出，再最多等2秒收齐应答
+    std::this_thread::sleep_for(std::chrono::nanoseconds(run.stopAt + 10 * 1000 * 1000 - nowNanos()));
+    for (int i = 0; i < 200; ++i)
+    {
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        for (std::unique_ptr<LoopState> &s : states)
+        {
+            sent += s->sent;
+            received += s->received;
+        }
+        if (received == sent)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    Histogram latency;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    std::mutex mutex;
+    runInAllLoops(states, [&](LoopState *state) {
+        state->loop->cancel(state->timer);
+        std::unique_lock<std::mutex> lock(mutex);
+        latency.merge(state->latency);
+        sent += state->sent;
+        received += state->received;
+    });
+    runInAllLoops(states, [](LoopState *state) {
+        for (Session *session : state->sessions)
+        {
+            session->conn.reset();
+            session->client.reset();
+        }
+        state->sessions.clear();
+    });
+    // 析构TcpClient时排队的关闭操作执行完之后，连接不再引用run和state
+    runInAllLoops(states, [](LoopState *) {});
+
+    double measured = (run.stopAt - start) / 1e9;
+    std::ostringstream os;
+    os << "{\"bench\":\"echo_openloop\",\"rate\":" << rate
+       << ",\"connections\":" << connections
+       << ",\"size\":" << size
+       << ",\"client_threads\":" << states.size()
+       << ",\"sent\":" << sent
+       << ",\"received\":" << received
+       << ",\"achieved_rate\":" << static_cast<uint64_t>(sent / measured)
+       << ",\"latency_ns\":" << latency.toJson() << "}";
+    return os.str();
+}
+
+static std::vector<int> parseList(const char *arg)
+{
+    std::vector<int> values;
+    std::istringstream is(arg);
+    std::string item;
+    while (std::getline(is, item, ','))
+    {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+static void runSweep(const InetAddress &serverAddr, int threads, int seconds,
+                     const std::vector<int> &rates, int connections, size_t size)
+{
+    std::vector<std::unique_ptr<EventLoopThread>> threadObjects;
+    std::vector<std::unique_ptr<LoopState>> states;
+    for (int i = 0; i < threads; ++i)
+    {
+        threadObjects.emplace_back(new EventLoopThread);
+        states.emplace_back(new LoopState);
+        states.back()->loop = threadObjects.back()->startLoop();
+    }
+    for (int rate : rates)
+    {
+        printf("%s\n", runRate(states, serverAddr, seconds, rate, connections, size).c_str());
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    if (argc > 1 && strcmp(argv[1], "server") == 0)
+    {
+        runServer(static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : kLocalPort), argc > 3 ? atoi(argv[3]) : 1);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "client") == 0)
+    {
+        if (argc < 7)
+        {
+            fprintf(stderr, "usage: echo_openloop client <ip> <port> <threads> <seconds> <rates> [connections] [size]\n");
+            return 1;
+        }
+        InetAddress serverAddr(static_cast<uint16_t>(atoi(argv[3])), argv[2]);
+        size_t size = std::max<size_t>(sizeof(int64_t), argc > 8 ? atoi(argv[8]) : 64);
+        runSweep(serverAddr, atoi(argv[4]), atoi(argv[5]), parseList(argv[6]), argc > 7 ? atoi(argv[7]) : 10, size);
+        return 0;
+    }
+
+    int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    std::vector<int> rates = parseList(argc > 2 ? argv[2] : "10000,50000,100000");
+    int connections = argc > 3 ? atoi(argv[3]) : 10;
+    size_t size = std::max<size_t>(sizeof(int64_t), argc > 4 ? atoi(argv[4]) : 64);
+    pid_t server = ::fork();
+    if (server == 0)
+    {
+        runServer(kLocalPort, 1);
+        return 0;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    runSweep(InetAddress(kLocalPort, "127.0.0.1"), 1, seconds, rates, connections, size);
+    ::kill(server, SIGTERM);
+    ::waitpid(server, nullptr, 0);
+    return 0;
+}
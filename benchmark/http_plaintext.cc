@@ -0,0 +1,156 @@
+#include <mymuduo/HttpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * HTTP plaintext吞吐测试，服务器和压测线程在同一个进程中
+ * ./http_plaintext [loops] [connections] [pipeline] [seconds]
+ * 服务器开loops个subLoop，每个压测线程持有一个连接，一次发出pipeline个请求，收齐应答后再发下一批
+ * 结果按服务器loop数折算为每个核的请求数，压测线程和服务器共用CPU时数字偏低
+ */
+
+static const uint16_t kPort = 8090;
+static const char kRequest[] = "GET /plaintext HTTP/1.1\r\nHost: localhost\r\nAccept: text/plain\r\n\r\n";
+static std::atomic_bool g_running(true);
+
+static bool readResponses(int fd, size_t bytes, std::vector<char> &buf)
+{
+    size_t got = 0;
+    while (got < bytes)
+    {
+        ssize_t n = ::read(fd, buf.data(), std::min(buf.size(), bytes - got));
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+// 读一个应答得到它的长度，plaintext的应答长度固定(Date头部的长度不变)
+static size_t probeResponseSize(int fd)
+{
+    ::write(fd, kRequest, sizeof kRequest - 1);
+    char buf[4096];
+    size_t got = 0;
+    while (got < sizeof buf)
+    {
+        ssize_t n = ::read(fd, buf + got, sizeof buf - got);
+        if (n <= 0)
+        {
+            return 0;
+        }
+        got += n;
+        buf[got] = '\0';
+        const char *end = strstr(buf, "\r\n\r\n");
+        const char *length = strstr(buf, "Content-Length: ");
+        if (end && length)
+        {
+            size_t size = end + 4 - buf + atoi(length + 16);
+            if (got >= size)
+            {
+                return size;
+            }
+        }
+    }
+    return 0;
+}
+
+static void clientThread(int pipeline, std::atomic<uint64_t> *requests)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+    {
+        perror("connect");
+        ::close(fd);
+        return;
+    }
+
+    size_t responseSize = probeResponseSize(fd);
+    std::string batch;
+    for (int i = 0; i < pipeline; ++i)
+    {
+        batch.append(kRequest, sizeof kRequest - 1);
+    }
+    std::vector<char> buf(256 * 1024);
+    while (responseSize > 0 && g_running)
+    {
+        if (::write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size())
+            || !readResponses(fd, responseSize * pipeline, buf))
+        {
+            break;
+        }
+        *requests += pipeline;
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 1;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int pipeline = argc > 3 ? atoi(argv[3]) : 16;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+    Logger::setLogLevel(ERROR);
+
+    // 服务器的baseLoop运行在主线程，计时和统计也由它的定时器完成
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(kPort), "plaintext");
+    server.setThreadNum(loops);
+    server.setHttpCallback([](const HttpRequest &, HttpResponse *resp) {
+        resp->addHeader("Server", "mymuduo");
+        resp->setContentType("text/plain");
+        resp->setBody("Hello, World!", 13);
+    });
+    server.start();
+
+    std::atomic<uint64_t> requests(0);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(clientThread, pipeline, &requests);
+    }
+
+    uint64_t last = 0;
+    loop.runEvery(1.0, [&]() {
+        uint64_t now = requests.load();
+        printf("%llu req/s\n", static_cast<unsigned long long>(now - last));
+        fflush(stdout);
+        last = now;
+    });
+    uint64_t total = 0;
+    loop.runAfter(seconds + 0.01, [&]() {
+        total = requests.load();
+        // 压测线程发完手上这一批就退出，再给服务器一点时间应答
+        g_running = false;
+        loop.runAfter(0.5, [&]() { loop.quit(); });
+    });
+    loop.loop();
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+
+    printf("loops=%d connections=%d pipeline=%d: %.0f req/s, %.0f req/s per loop\n",
+           loops, connections, pipeline, total / static_cast<double>(seconds),
+           total / static_cast<double>(seconds) / loops);
+    return 0;
+}
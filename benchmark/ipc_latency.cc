@@ -0,0 +1,125 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/ShmServer.h>
+#include <mymuduo/ShmClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/*
+ * 本机往返延迟测试：loopback TCP、Unix域socket和共享内存环各跑一遍
+ * ./ipc_latency [rounds] [payload]
+ * 服务器和客户端在同一个loop中，客户端发出payload字节，服务器原样回复，收齐后再发下一个
+ * 共享内存连接在同一个loop中时对方总是处于等待状态，每次发送都要写eventfd，测到的是通知路径的开销
+ */
+
+static int g_rounds = 100000;
+static size_t g_payload = 64;
+
+// ConnectionPtr为TcpConnectionPtr或者ShmConnectionPtr
+template <typename ConnectionPtr>
+struct PingPong
+{
+    EventLoop *loop;
+    std::string message;
+    std::vector<int64_t> samples;
+    Timestamp sentAt;
+
+    void onConnection(const ConnectionPtr &conn)
+    {
+        if (conn->connected())
+        {
+            ping(conn);
+        }
+    }
+
+    void ping(const ConnectionPtr &conn)
+    {
+        sentAt = Timestamp::monotonic();
+        conn->send(message);
+    }
+
+    void onMessage(const ConnectionPtr &conn, Buffer *buf, Timestamp)
+    {
+        if (buf->readableBytes() < message.size())
+        {
+            return;
+        }
+        buf->retrieve(message.size());
+        samples.push_back(microSecondsDifference(Timestamp::monotonic(), sentAt));
+        if (static_cast<int>(samples.size()) == g_rounds)
+        {
+            conn->shutdown();
+            loop->quit();
+            return;
+        }
+        ping(conn);
+    }
+};
+
+template <typename ConnectionPtr>
+static void onEcho(const ConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void report(const char *name, std::vector<int64_t> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (int64_t s : samples)
+    {
+        sum += s;
+    }
+    printf("%-5s rounds=%zu avg=%.2fus p50=%lldus p99=%lldus max=%lldus\n",
+           name, samples.size(), sum / samples.size(),
+           static_cast<long long>(samples[samples.size() / 2]),
+           static_cast<long long>(samples[samples.size() * 99 / 100]),
+           static_cast<long long>(samples.back()));
+}
+
+template <typename Server, typename Client, typename ConnectionPtr, typename Address>
+static void run(const char *name, const Address &addr)
+{
+    EventLoop loop;
+    Server server(&loop, addr, std::string(name) + "-server");
+    server.setMessageCallback(onEcho<ConnectionPtr>);
+    server.start();
+
+    PingPong<ConnectionPtr> pingpong;
+    pingpong.loop = &loop;
+    pingpong.message.assign(g_payload, 'p');
+    pingpong.samples.reserve(g_rounds);
+
+    Client client(&loop, addr, std::string(name) + "-client");
+    client.setConnectionCallback(std::bind(&PingPong<ConnectionPtr>::onConnection, &pingpong,
+                                           std::placeholders::_1));
+    client.setMessageCallback(std::bind(&PingPong<ConnectionPtr>::onMessage, &pingpong, std::placeholders::_1,
+                                        std::placeholders::_2, std::placeholders::_3));
+    client.connect();
+    loop.loop();
+    report(name, pingpong.samples);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        g_rounds = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        g_payload = static_cast<size_t>(atoi(argv[2]));
+    }
+    Logger::setLogLevel(ERROR);
+
+    run<TcpServer, TcpClient, TcpConnectionPtr>("tcp", InetAddress(9981));
+    run<TcpServer, TcpClient, TcpConnectionPtr>("unix", UnixAddress("@mymuduo-ipc-latency"));
+    run<ShmServer, ShmClient, ShmConnectionPtr>("shm", UnixAddress("@mymuduo-ipc-latency-shm"));
+    return 0;
+}
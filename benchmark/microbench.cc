@@ -0,0 +1,423 @@
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Channel.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * 核心组件的微基准测试
+ * ./microbench [--filter 子串] [--save 文件] [--compare 文件] [--samples N]
+ * 每个用例先校准每批的迭代次数(一批至少约1ms)，再跑samples批，每批得到一个ns/op，
+ * 输出中位数和p90/p99/最大值，以及平均每次操作的内存分配次数(替换了全局operator new来计数)
+ * --save把结果按每行一个JSON写入文件；--compare读取之前保存的文件，输出与基线的差异百分比
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> g_allocs(0);
+
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+// 防止编译器把没有用到的计算结果优化掉
+template <typename T>
+static void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result
+{
+    std::string name;
+    double nsPerOp;     // 各批的中位数
+    double p90;
+    double p99;
+    double max;
+    double allocsPerOp;
+};
+
+// 用例：run(n)执行n次被测操作
+struct Case
+{
+    std::string name;
+    std::function<void(int)> run;
+};
+
+static int64_t elapsedNanos(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+static Result measure(const Case &c, int samples)
+{
+    // 翻倍迭代次数直到一批耗时超过1ms
+    int iterations = 1;
+    for (;;)
+    {
+        Clock::time_point start = Clock::now();
+        c.run(iterations);
+        if (elapsedNanos(start) > 1000 * 1000 || iterations >= (1 << 24))
+        {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> perOp;
+    perOp.reserve(samples);
+    uint64_t allocsBefore = g_allocs.load(std::memory_order_relaxed);
+    for (int i = 0; i < samples; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        c.run(iterations);
+        perOp.push_back(static_cast<double>(elapsedNanos(start)) / iterations);
+    }
+    uint64_t allocs = g_allocs.load(std::memory_order_relaxed) - allocsBefore;
+
+    std::sort(perOp.begin(), perOp.end());
+    auto at = [&perOp](double p) {
+        return perOp[std::min(perOp.size() - 1, static_cast<size_t>(p * perOp.size()))];
+    };
+    Result r;
+    r.name = c.name;
+    r.nsPerOp = at(0.5);
+    r.p90 = at(0.9);
+    r.p99 = at(0.99);
+    r.max = perOp.back();
+    r.allocsPerOp = static_cast<double>(allocs) / (static_cast<double>(iterations) * samples);
+    return r;
+}
+
+static std::string toJson(const Result &r)
+{
+    char buf[256];
+    snprintf(buf, sizeof buf,
+             "{\"name\":\"%s\",\"ns_per_op\":%.2f,\"p90\":%.2f,\"p99\":%.2f,\"max\":%.2f,\"allocs_per_op\":%.3f}",
+             r.name.c_str(), r.nsPerOp, r.p90, r.p99, r.max, r.allocsPerOp);
+    return buf;
+}
+
+// 读取--save写出的文件，只取name和ns_per_op
+static std::map<std::string, double> loadBaseline(const char *path)
+{
+    std::map<std::string, double> baseline;
+    FILE *fp = ::fopen(path, "r");
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "cannot open baseline %s\n", path);
+        return baseline;
+    }
+    char line[512];
+    while (::fgets(line, sizeof line, fp) != nullptr)
+    {
+        const char *name = strstr(line, "\"name\":\"");
+        const char *ns = strstr(line, "\"ns_per_op\":");
+        if (name == nullptr || ns == nullptr)
+        {
+            continue;
+        }
+        name += 8;
+        const char *end = strchr(name, '"');
+        if (end != nullptr)
+        {
+            baseline[std::string(name, end)] = atof(ns + 12);
+        }
+    }
+    ::fclose(fp);
+    return baseline;
+}
+
+static std::vector<Case> makeCases(EventLoop *mainLoop, EventLoop *otherLoop)
+{
+    std::vector<Case> cases;
+
+    // Buffer
+    static const std::string small(64, 'b');
+    static const std::string large(4096, 'b');
+    cases.push_back({ "buffer_append_retrieve_64", [](int n) {
+        Buffer buf;
+        for (int i = 0; i < n; ++i)
+        {
+            buf.append(small.data(), small.size());
+            buf.retrieve(small.size());
+        }
+        doNotOptimize(buf.peek());
+    }});
+    cases.push_back({ "buffer_append_retrieve_4k", [](int n) {
+        Buffer buf;
+        for (int i = 0; i < n; ++i)
+        {
+            buf.append(large.data(), large.size());
+            buf.retrieve(large.size());
+        }
+        doNotOptimize(buf.peek());
+    }});
+    // 读指针靠后、剩余空间不够时makeSpace把数据挪回头部，不重新分配
+    cases.push_back({ "buffer_makespace_compact", [](int n) {
+        Buffer buf;
+        for (int i = 0; i < n; ++i)
+        {
+            buf.append(large.data(), 1000);
+            buf.retrieve(990);
+            buf.makeSpace(100);
+            buf.retrieveAll();
+        }
+        doNotOptimize(buf.peek());
+    }});
+    // 每次都从空Buffer开始追加到64KB，测量扩容的开销
+    cases.push_back({ "buffer_grow_to_64k", [](int n) {
+        for (int i = 0; i < n; ++i)
+        {
+            Buffer buf;
+            for (int j = 0; j < 16; ++j)
+            {
+                buf.append(large.data(), large.size());
+            }
+            doNotOptimize(buf.peek());
+        }
+    }});
+    // 包括向管道write的系统调用
+    cases.push_back({ "buffer_readfd_pipe_1k", [](int n) {
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK) < 0)
+        {
+            return;
+        }
+        Buffer buf;
+        int savedErrno = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            ssize_t written = ::write(fds[1], large.data(), 1024);
+            doNotOptimize(written);
+            buf.readFd(fds[0], &savedErrno);
+            buf.retrieveAll();
+        }
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }});
+
+    // 从主线程投递到另一个loop，等待回调执行完毕，即一次跨线程唤醒的往返
+    auto crossThread = [otherLoop](bool queue, int n) {
+        std::atomic<int> done(0);
+        for (int i = 0; i < n; ++i)
+        {
+            auto cb = [&done]() { done.fetch_add(1, std::memory_order_release); };
+            if (queue)
+            {
+                otherLoop->queueInLoop(cb);
+            }
+            else
+            {
+                otherLoop->runInLoop(cb);
+            }
+            while (done.load(std::memory_order_acquire) <= i)
+            {
+                std::this_thread::yield();
+            }
+        }
+    };
+    cases.push_back({ "eventloop_runinloop_cross_thread", std::bind(crossThread, false, std::placeholders::_1) });
+    cases.push_back({ "eventloop_queueinloop_cross_thread", std::bind(crossThread, true, std::placeholders::_1) });
+    // 不等待回调，连续投递n个后再等全部执行完，测量投递一侧的吞吐
+    cases.push_back({ "eventloop_queueinloop_burst", [otherLoop](int n) {
+        std::atomic<int> done(0);
+        for (int i = 0; i < n; ++i)
+        {
+            otherLoop->queueInLoop([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (done.load(std::memory_order_relaxed) < n)
+        {
+            std::this_thread::yield();
+        }
+    }});
+
+    // Timestamp
+    cases.push_back({ "timestamp_now", [](int n) {
+        for (int i = 0; i < n; ++i)
+        {
+            doNotOptimize(Timestamp::now());
+        }
+    }});
+    cases.push_back({ "timestamp_monotonic", [](int n) {
+        for (int i = 0; i < n; ++i)
+        {
+            doNotOptimize(Timestamp::monotonic());
+        }
+    }});
+    cases.push_back({ "timestamp_tostring", [](int n) {
+        Timestamp ts = Timestamp::now();
+        for (int i = 0; i < n; ++i)
+        {
+            std::string s = ts.toString();
+            doNotOptimize(s.data());
+        }
+    }});
+    cases.push_back({ "timestamp_formatto", [](int n) {
+        Timestamp ts = Timestamp::now();
+        char buf[64];
+        for (int i = 0; i < n; ++i)
+        {
+            doNotOptimize(ts.formatTo(buf, sizeof buf));
+        }
+    }});
+
+    // Logger，输出目的地在main中换成了空函数，只测量格式化和分发
+    cases.push_back({ "logger_info_filtered", [](int n) {
+        Logger::setLogLevel(ERROR);
+        for (int i = 0; i < n; ++i)
+        {
+            LOG_INFO("microbench %d %s", i, "filtered");
+        }
+    }});
+    cases.push_back({ "logger_info_formatted", [](int n) {
+        Logger::setLogLevel(INFO);
+        for (int i = 0; i < n; ++i)
+        {
+            LOG_INFO("microbench %d %s", i, "formatted");
+        }
+        Logger::setLogLevel(ERROR);
+    }});
+
+    // Channel和EPollPoller，在主线程的loop上操作一个eventfd
+    cases.push_back({ "epoll_update_channel", [mainLoop](int n) {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        Channel channel(mainLoop, fd);
+        channel.enableReading();
+        // 每次在读和读写之间切换，都是一次epoll_ctl(EPOLL_CTL_MOD)
+        for (int i = 0; i < n; ++i)
+        {
+            if (i % 2 == 0)
+            {
+                channel.enableWriting();
+            }
+            else
+            {
+                channel.disableWriting();
+            }
+        }
+        channel.disableAll();
+        channel.remove();
+        ::close(fd);
+    }});
+    cases.push_back({ "channel_handle_event", [mainLoop](int n) {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        Channel channel(mainLoop, fd);
+        uint64_t reads = 0;
+        channel.setReadCallback([&reads](Timestamp) { ++reads; });
+        Timestamp now = Timestamp::now();
+        for (int i = 0; i < n; ++i)
+        {
+            channel.set_revents(EPOLLIN);
+            channel.handleEvent(now);
+        }
+        doNotOptimize(reads);
+        ::close(fd);
+    }});
+
+    return cases;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filter = nullptr;
+    const char *savePath = nullptr;
+    const char *comparePath = nullptr;
+    int samples = 50;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--filter") == 0) filter = argv[i + 1];
+        else if (strcmp(argv[i], "--save") == 0) savePath = argv[i + 1];
+        else if (strcmp(argv[i], "--compare") == 0) comparePath = argv[i + 1];
+        else if (strcmp(argv[i], "--samples") == 0) samples = std::max(1, atoi(argv[i + 1]));
+        else
+        {
+            fprintf(stderr, "usage: microbench [--filter substr] [--save file] [--compare file] [--samples N]\n");
+            return 1;
+        }
+    }
+
+    Logger::setLogLevel(ERROR);
+    Logger::instance().setOutput([](const char *msg, int len) { doNotOptimize(msg); doNotOptimize(len); });
+
+    // 主线程的loop只用来注册Channel，不运行loop()
+    EventLoop mainLoop;
+    EventLoopThread thread;
+    EventLoop *otherLoop = thread.startLoop();
+
+    std::map<std::string, double> baseline;
+    if (comparePath != nullptr)
+    {
+        baseline = loadBaseline(comparePath);
+    }
+    FILE *saveFile = nullptr;
+    if (savePath != nullptr && (saveFile = ::fopen(savePath, "w")) == nullptr)
+    {
+        fprintf(stderr, "cannot open %s\n", savePath);
+        return 1;
+    }
+
+    printf("%-36s %10s %10s %10s %10s %10s", "name", "ns/op", "p90", "p99", "max", "allocs/op");
+    if (comparePath != nullptr)
+    {
+        printf(" %10s %8s", "baseline", "change");
+    }
+    printf("\n");
+
+    for (const Case &c : makeCases(&mainLoop, otherLoop))
+    {
+        if (filter != nullptr && c.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        Result r = measure(c, samples);
+        printf("%-36s %10.2f %10.2f %10.2f %10.2f %10.3f", r.name.c_str(), r.nsPerOp, r.p90, r.p99, r.max,
+               r.allocsPerOp);
+        auto it = baseline.find(r.name);
+        if (it != baseline.end() && it->second > 0)
+        {
+            printf(" %10.2f %+7.1f%%", it->second, (r.nsPerOp - it->second) / it->second * 100);
+        }
+        printf("\n");
+        fflush(stdout);
+        if (saveFile != nullptr)
+        {
+            fprintf(saveFile, "%s\n", toJson(r).c_str());
+        }
+    }
+    if (saveFile != nullptr)
+    {
+        ::fclose(saveFile);
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * ping-pong吞吐测试，客户端和服务器都使用mymuduo
+ * 每个连接建立后客户端发出一个size字节的消息，之后双方收到什么就原样发回去，统计客户端每秒收到的字节数
+ *   ./pingpong server <port> <threads>
+ *   ./pingpong client <ip> <port> <threads> <seconds> [sizes] [connections]
+ *   ./pingpong [threads] [seconds] [sizes] [connections]   fork出本机的服务器，再跑客户端
+ * sizes和connections是逗号分隔的列表，按组合逐一测试，每个组合输出一行JSON
+ * 设置环境变量MUDUO_PERF_COUNTERS=1时，JSON中附带测量期间客户端loop线程的性能计数器(每条消息的cycles、IPC等)
+ */
+
+static const uint16_t kLocalPort = 9020;
+
+static void runServer(uint16_t port, int threads)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "0.0.0.0"), "pingpong", TcpServer::kReusePort);
+    server.setThreadNum(threads);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+    loop.loop();
+}
+
+// 一个客户端连接，bytesRead只在它的loop中写，主线程读取时用relaxed原子操作
+struct Session
+{
+    std::unique_ptr<TcpClient> client;
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<bool> connected;
+
+    Session() : bytesRead(0), connected(false) {}
+};
+
+// 在每个loop中执行一次func并等待全部完成
+template <typename Func>
+static void runInAllLoops(const std::vector<EventLoop*> &loops, Func func)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t remaining = loops.size();
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        loops[i]->runInLoop([&, i]() {
+            func(i);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (--remaining == 0)
+            {
+                cond.notify_one();
+            }
+        });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() { return remaining == 0; });
+}
+
+// 各loop在测量期间的计数器增量之和，计数器不可用时不输出
+static void appendPerf(std::ostringstream &os, const std::vector<PerfValues> &before,
+                       const std::vector<PerfValues> &after, uint64_t messages)
+{
+    PerfValues delta;
+    delta.hardware = delta.software = true;
+    for (size_t i = 0; i < before.size(); ++i)
+    {
+        delta.hardware = delta.hardware && before[i].hardware && after[i].hardware;
+        delta.software = delta.software && before[i].software && after[i].software;
+        delta.cycles += after[i].cycles - before[i].cycles;
+        delta.instructions += after[i].instructions - before[i].instructions;
+        delta.llcMisses += after[i].llcMisses - before[i].llcMisses;
+        delta.contextSwitches += after[i].contextSwitches - before[i].contextSwitches;
+        delta.pageFaults += after[i].pageFaults - before[i].pageFaults;
+    }
+    double msgs = messages > 0 ? static_cast<double>(messages) : 1.0;
+    if (delta.hardware)
+    {
+        os << ",\"cycles\":" << delta.cycles
+           << ",\"instructions\":" << delta.instructions
+           << ",\"ipc\":" << (delta.cycles ? static_cast<double>(delta.instructions) / delta.cycles : 0.0)
+           << ",\"llc_misses\":" << delta.llcMisses
+           << ",\"cycles_per_msg\":" << delta.cycles / msgs
+           << ",\"llc_misses_per_msg\":" << delta.llcMisses / msgs;
+    }
+    if (delta.software)
+    {
+        os << ",\"context_switches\":" << delta.contextSwitches
+           << ",\"page_faults\":" << delta.pageFaults;
+    }
+}
+
+static std::string runClient(const std::vector<EventLoop*> &loops, const InetAddress &serverAddr,
+                             size_t size, int connections, int seconds)
+{
+    std::vector<std::unique_ptr<Session>> sessions;
+    for (int i = 0; i < connections; ++i)
+    {
+        sessions.emplace_back(new Session);
+    }
+    std::string message(size, 'p');
+
+    // TcpClient在自己的loop中创建和销毁
+    runInAllLoops(loops, [&](size_t index) {
+        for (int i = static_cast<int>(index); i < connections; i += static_cast<int>(loops.size()))
+        {
+            Session *session = sessions[i].get();
+            session->client.reset(new TcpClient(loops[index], serverAddr, "pingpong-client"));
+            session->client->setConnectionCallback([session, &message](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    session->connected = true;
+                    conn->send(message);
+                }
+            });
+            session->client->setMessageCallback([session](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                session->bytesRead.store(session->bytesRead.load(std::memory_order_relaxed) + buf->readableBytes(),
+                                         std::memory_order_relaxed);
+                conn->send(buf);
+            });
+            session->client->connect();
+        }
+    });
+
+    // 等全部连接建立后再开始计时
+    for (int i = 0; i < 1000; ++i)
+    {
+        bool all = true;
+        for (const std::unique_ptr<Session> &s : sessions)
+        {
+            all = all && s->connected;
+        }
+        if (all)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    auto total = [&sessions]() {
+        uint64_t bytes = 0;
+        for (const std::unique_ptr<Session> &s : sessions)
+        {
+            bytes += s->bytesRead.load(std::memory_order_relaxed);
+        }
+        return bytes;
+    };
+    // 测量开始和结束时各loop的性能计数器，只能在loop线程中读取
+    std::vector<PerfValues> perfBefore(loops.size());
+    std::vector<PerfValues> perfAfter(loops.size());
+    runInAllLoops(loops, [&](size_t index) { perfBefore[index] = loops[index]->metrics().perf; });
+
+    uint64_t startBytes = total();
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    uint64_t bytes = total() - startBytes;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    runInAllLoops(loops, [&](size_t index) { perfAfter[index] = loops[index]->metrics().perf; });
+
+    runInAllLoops(loops, [&](size_t index) {
+        for (int i = static_cast<int>(index); i < connections; i += static_cast<int>(loops.size()))
+        {
+            sessions[i]->client.reset();
+        }
+    });
+    // 析构TcpClient时排队的关闭操作执行完之后，连接不再引用session
+    runInAllLoops(loops, [](size_t) {});
+
+    std::ostringstream os;
+    os << "{\"bench\":\"pingpong\",\"size\":" << size
+       << ",\"connections\":" << connections
+       << ",\"client_threads\":" << loops.size()
+       << ",\"seconds\":" << elapsed
+       << ",\"bytes_per_sec\":" << static_cast<uint64_t>(bytes / elapsed)
+       << ",\"msgs_per_sec\":" << static_cast<uint64_t>(bytes / elapsed / size);
+    appendPerf(os, perfBefore, perfAfter, bytes / size);
+    os << "}";
+    return os.str();
+}
+
+static std::vector<int> parseList(const char *arg)
+{
+    std::vector<int> values;
+    std::istringstream is(arg);
+    std::string item;
+    while (std::getline(is, item, ','))
+    {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+static void runSweep(const InetAddress &serverAddr, int threads, int seconds,
+                     const std::vector<int> &sizes, const std::vector<int> &connections)
+{
+    std::vector<std::unique_ptr<EventLoopThread>> threadObjects;
+    std::vector<EventLoop*> loops;
+    for (int i = 0; i < threads; ++i)
+    {
+        threadObjects.emplace_back(new EventLoopThread);
+        loops.push_back(threadObjects.back()->startLoop());
+    }
+    for (int size : sizes)
+    {
+        for (int conns : connections)
+        {
+            printf("%s\n", runClient(loops, serverAddr, size, conns, seconds).c_str());
+            fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(ERROR);
+    ::signal(SIGPIPE, SIG_IGN);
+
+    if (argc > 1 && strcmp(argv[1], "server") == 0)
+    {
+        runServer(static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : kLocalPort), argc > 3 ? atoi(argv[3]) : 1);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "client") == 0)
+    {
+        if (argc < 6)
+        {
+            fprintf(stderr, "usage: pingpong client <ip> <port> <threads> <seconds> [sizes] [connections]\n");
+            return 1;
+        }
+        InetAddress serverAddr(static_cast<uint16_t>(atoi(argv[3])), argv[2]);
+        runSweep(serverAddr, atoi(argv[4]), atoi(argv[5]),
+                 parseList(argc > 6 ? argv[6] : "16,1024,16384"), parseList(argc > 7 ? argv[7] : "1,10,100"));
+        return 0;
+    }
+
+    int threads = argc > 1 ? atoi(argv[1]) : 1;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    pid_t server = ::fork();
+    if (server == 0)
+    {
+        runServer(kLocalPort, threads);
+        return 0;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    runSweep(InetAddress(kLocalPort, "127.0.0.1"), threads, seconds,
+             parseList(argc > 3 ? argv[3] : "16,1024,16384"), parseList(argc > 4 ? argv[4] : "1,10,100"));
+    ::kill(server, SIGTERM);
+    ::waitpid(server, nullptr, 0);
+    return 0;
+}
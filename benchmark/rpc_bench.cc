@@ -0,0 +1,179 @@
+#include <mymuduo/RpcServer.h>
+#include <mymuduo/RpcClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * RPC吞吐和延迟测试，服务器和客户端在同一个进程中，只有一个连接
+ * ./rpc_bench [seconds] [payloadSize]
+ * 分别测试kInline和kOffload两种方法在管线深度1、16、256下的调用数和延迟：
+ * 客户端始终保持depth个未完成的调用，每收到一个应答就在回调中发起下一个
+ */
+
+static const uint16_t kPort = 9010;
+static const uint16_t kEchoInline = 1;
+static const uint16_t kEchoOffload = 2;
+
+using Clock = std::chrono::steady_clock;
+
+struct Phase
+{
+    uint16_t method;
+    int depth;
+    bool running;
+    uint64_t calls;
+    uint64_t errors;
+    std::vector<int64_t> latencies; // 纳秒
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done;
+};
+
+static RpcClient *g_client = nullptr;
+static std::string g_payload;
+
+static void issue(Phase *phase)
+{
+    Clock::time_point start = Clock::now();
+    g_client->call(phase->method, g_payload, [phase, start](RpcStatus status, const char *, size_t len) {
+        if (status != kRpcOk || len != g_payload.size())
+        {
+            ++phase->errors;
+        }
+        ++phase->calls;
+        phase->latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        if (phase->running)
+        {
+            issue(phase);
+        }
+        else if (g_client->inFlight() == 0)
+        {
+            std::unique_lock<std::mutex> lock(phase->mutex);
+            phase->done = true;
+            phase->cond.notify_one();
+        }
+    });
+}
+
+static double percentile(std::vector<int64_t> &values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index] / 1000.0;
+}
+
+static void runPhase(EventLoop *clientLoop, uint16_t method, int depth, int seconds)
+{
+    Phase phase;
+    phase.method = method;
+    phase.depth = depth;
+    phase.running = true;
+    phase.calls = 0;
+    phase.errors = 0;
+    phase.done = false;
+    phase.latencies.reserve(1 << 20);
+
+    clientLoop->runInLoop([&phase]() {
+        for (int i = 0; i < phase.depth; ++i)
+        {
+            issue(&phase);
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    clientLoop->runInLoop([&phase]() { phase.running = false; });
+    {
+        std::unique_lock<std::mutex> lock(phase.mutex);
+        phase.cond.wait(lock, [&phase]() { return phase.done; });
+    }
+
+    printf("%-8s depth=%-4d %10.0f calls/s  p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  errors %llu\n",
+           method == kEchoInline ? "inline" : "offload", depth, phase.calls / static_cast<double>(seconds),
+           percentile(phase.latencies, 0.5), percentile(phase.latencies, 0.99),
+           percentile(phase.latencies, 0.999), static_cast<unsigned long long>(phase.errors));
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    size_t payloadSize = argc > 2 ? atoi(argv[2]) : 64;
+    Logger::setLogLevel(ERROR);
+    g_payload.assign(payloadSize, 'r');
+
+    // 服务器的baseLoop运行在主线程，测试流程在单独的线程中推进，结束时退出主线程的loop
+    EventLoop loop;
+    RpcServer server(&loop, InetAddress(kPort), "rpc-bench");
+    server.setThreadNum(1);
+    server.setComputeThreadNum(1);
+    auto echo = [](const StringPiece &request, Buffer *response) {
+        response->append(request.data(), request.size());
+    };
+    server.registerMethod(kEchoInline, echo, RpcServer::kInline);
+    server.registerMethod(kEchoOffload, echo, RpcServer::kOffload);
+    server.start();
+
+    EventLoopThread clientThread;
+    EventLoop *clientLoop = clientThread.startLoop();
+    std::unique_ptr<RpcClient> client;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool connected = false;
+    bool destroyed = false;
+    clientLoop->runInLoop([&]() {
+        client.reset(new RpcClient(clientLoop, InetAddress(kPort, "127.0.0.1"), "rpc-bench-client"));
+        client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            std::unique_lock<std::mutex> lock(mutex);
+            connected = conn->connected();
+            cond.notify_one();
+        });
+        g_client = client.get();
+        client->connect();
+    });
+
+    std::thread driver([&]() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return connected; });
+        }
+        const int depths[] = { 1, 16, 256 };
+        for (uint16_t method : { kEchoInline, kEchoOffload })
+        {
+            for (int depth : depths)
+            {
+                runPhase(clientLoop, method, depth, seconds);
+            }
+        }
+        // RpcClient需在自己的loop线程中析构
+        clientLoop->runInLoop([&]() {
+            client.reset();
+            std::unique_lock<std::mutex> lock(mutex);
+            destroyed = true;
+            cond.notify_one();
+        });
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return destroyed; });
+        }
+        loop.runAfter(0.2, [&]() { loop.quit(); });
+    });
+    loop.loop();
+    driver.join();
+    return 0;
+}
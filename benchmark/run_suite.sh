@@ -0,0 +1,16 @@
+#!/bin/bash
+
+set -e
+
+# 依次运行ping-pong吞吐和开环延迟测试，每个测试点一行JSON，汇总写到bench_result.json
+# ./run_suite.sh [seconds]
+seconds=${1:-3}
+output=`pwd`/bench_result.json
+
+# 压测程序由根目录的CMakeLists.txt编译，构建目录为benchmark/build，程序输出到benchmark目录
+cmake -S .. -B build
+cmake --build build --target pingpong echo_openloop -j`nproc`
+
+: > $output
+./pingpong 1 $seconds 16,1024,16384,65536 1,10,100 | tee -a $output
+./echo_openloop $seconds 10000,50000,100000,200000 10 64 | tee -a $output
@@ -0,0 +1,159 @@
+#include <mymuduo/UdpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/*
+ * UDP收发包速率测试
+ * ./udp_pps [loops] [clients] [seconds] [payload] [echo]
+ * 服务器在loops个loop上各绑定一个SO_REUSEPORT的UdpChannel；
+ * clients个发送线程用sendmmsg以64个一批向服务器发包，echo为1时服务器原样回复，发送线程同时收取回复
+ */
+
+static const int kBatch = 64;
+static std::atomic_bool g_running(true);
+
+static void clientThread(int index, uint16_t port, size_t payload, bool echo,
+                         std::atomic<uint64_t> *sent, std::atomic<uint64_t> *echoed)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in server;
+    memset(&server, 0, sizeof server);
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // 每个线程一个源端口，SO_REUSEPORT按源地址把各线程分散到不同的loop
+    ::connect(fd, reinterpret_cast<sockaddr *>(&server), sizeof server);
+    timeval tv = {0, 1000};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+
+    std::vector<char> buf(payload * kBatch, static_cast<char>('a' + index % 26));
+    std::vector<char> rbuf(2048 * kBatch);
+    mmsghdr msgs[kBatch];
+    iovec iovs[kBatch];
+    mmsghdr rmsgs[kBatch];
+    iovec riovs[kBatch];
+    for (int i = 0; i < kBatch; ++i)
+    {
+        iovs[i].iov_base = &buf[i * payload];
+        iovs[i].iov_len = payload;
+        memset(&msgs[i], 0, sizeof msgs[i]);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        riovs[i].iov_base = &rbuf[i * 2048];
+        riovs[i].iov_len = 2048;
+        memset(&rmsgs[i], 0, sizeof rmsgs[i]);
+        rmsgs[i].msg_hdr.msg_iov = &riovs[i];
+        rmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (g_running)
+    {
+        int n = ::sendmmsg(fd, msgs, kBatch, 0);
+        if (n > 0)
+        {
+            *sent += n;
+        }
+        if (echo)
+        {
+            int r = ::recvmmsg(fd, rmsgs, kBatch, MSG_DONTWAIT, nullptr);
+            if (r > 0)
+            {
+                *echoed += r;
+            }
+        }
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 2;
+    int clients = argc > 2 ? atoi(argv[2]) : 4;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    size_t payload = argc > 4 ? static_cast<size_t>(atoi(argv[4])) : 64;
+    bool echo = argc > 5 ? atoi(argv[5]) != 0 : false;
+    const uint16_t port = 9977;
+
+    Logger::setLogLevel(ERROR);
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+
+    std::unique_ptr<UdpServer> server;
+    baseLoop->runInLoop([&]() {
+        server.reset(new UdpServer(baseLoop, InetAddress(port), "udp_pps"));
+        server->setThreadNum(loops);
+        if (echo)
+        {
+            server->setMessageCallback([](UdpChannel *ch, const char *data, size_t len,
+                                          const InetAddress &peer, Timestamp) { ch->send(data, len, peer); });
+        }
+        server->start();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::atomic<uint64_t> sent(0), echoed(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i)
+    {
+        threads.emplace_back(clientThread, i, port, payload, echo, &sent, &echoed);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t lastReceived = 0;
+    for (int s = 0; s < seconds; ++s)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t received = 0;
+        for (const std::unique_ptr<UdpChannel> &ch : server->channels())
+        {
+            received += ch->packetsReceived();
+        }
+        printf("second %d: server received %.0f pps\n", s + 1, static_cast<double>(received - lastReceived));
+        lastReceived = received;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    g_running = false;
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+
+    uint64_t received = 0, replied = 0, recvCalls = 0, sendCalls = 0, dropped = 0;
+    int index = 0;
+    for (const std::unique_ptr<UdpChannel> &ch : server->channels())
+    {
+        printf("loop %d: received %lu, sent %lu, %.1f datagrams per recvmmsg\n", index++,
+               static_cast<unsigned long>(ch->packetsReceived()), static_cast<unsigned long>(ch->packetsSent()),
+               ch->recvCalls() ? static_cast<double>(ch->packetsReceived()) / ch->recvCalls() : 0.0);
+        received += ch->packetsReceived();
+        replied += ch->packetsSent();
+        recvCalls += ch->recvCalls();
+        sendCalls += ch->sendCalls();
+        dropped += ch->packetsDropped();
+    }
+    printf("loops=%d clients=%d payload=%zu echo=%d\n", loops, clients, payload, echo);
+    printf("client sent %.0f pps, server received %.0f pps (%.1f%% delivered)\n",
+           sent / elapsed, received / elapsed, sent ? 100.0 * received / sent : 0.0);
+    if (echo)
+    {
+        printf("server replied %.0f pps in %.1f datagrams per sendmmsg, clients got %.0f pps, dropped %lu\n",
+               replied / elapsed, sendCalls ? static_cast<double>(replied) / sendCalls : 0.0,
+               echoed / elapsed, static_cast<unsigned long>(dropped));
+    }
+
+    baseLoop->runInLoop([&]() { server.reset(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return 0;
+}
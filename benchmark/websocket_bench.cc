@@ -0,0 +1,232 @@
+#include <mymuduo/WebSocketServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * WebSocket测试，服务器和压测线程在同一个进程中
+ * ./websocket_bench [messageSize] [fragments] [connections] [batch] [seconds]
+ * 先比较解掩码的速度(库的SIMD实现和逐字节的循环)，再做echo测试：
+ * 每个压测线程完成握手后一次发出batch个带掩码的消息(每个消息拆成fragments个分片)，收齐echo后再发下一批
+ */
+
+static const uint16_t kPort = 8091;
+static std::atomic_bool g_running(true);
+
+static void naiveUnmask(char *dst, const char *src, size_t len, const uint8_t key[4])
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        dst[i] = static_cast<char>(src[i] ^ key[i % 4]);
+    }
+}
+
+template <typename Func>
+static double measureUnmask(Func func, size_t len)
+{
+    std::vector<char> src(len, 'x');
+    std::vector<char> dst(len);
+    const uint8_t key[4] = { 0x12, 0x34, 0x56, 0x78 };
+    size_t rounds = std::max<size_t>(1, (size_t(1) << 30) / len);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i)
+    {
+        func(dst.data(), src.data(), len, key);
+        src[i % len] = dst[(i * 7) % len]; // 防止编译器把循环优化掉
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(rounds) * len / seconds / 1e9;
+}
+
+static size_t serverHeaderSize(size_t len)
+{
+    return len < 126 ? 2 : (len <= 0xFFFF ? 4 : 10);
+}
+
+// 客户端的帧：FIN/opcode、带掩码的长度、4字节掩码、掩码后的负载
+static void appendFrame(std::string &out, bool fin, int opcode, const char *data, size_t len)
+{
+    const uint8_t key[4] = { 0xA1, 0xB2, 0xC3, 0xD4 };
+    out.push_back(static_cast<char>((fin ? 0x80 : 0) | opcode));
+    if (len < 126)
+    {
+        out.push_back(static_cast<char>(0x80 | len));
+    }
+    else if (len <= 0xFFFF)
+    {
+        out.push_back(static_cast<char>(0x80 | 126));
+        out.push_back(static_cast<char>(len >> 8));
+        out.push_back(static_cast<char>(len));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0x80 | 127));
+        for (int i = 7; i >= 0; --i)
+        {
+            out.push_back(static_cast<char>(static_cast<uint64_t>(len) >> (i * 8)));
+        }
+    }
+    out.append(reinterpret_cast<const char*>(key), 4);
+    for (size_t i = 0; i < len; ++i)
+    {
+        out.push_back(static_cast<char>(data[i] ^ key[i % 4]));
+    }
+}
+
+static bool readFully(int fd, char *buf, size_t bytes)
+{
+    size_t got = 0;
+    while (got < bytes)
+    {
+        ssize_t n = ::read(fd, buf + got, bytes - got);
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static bool handshake(int fd)
+{
+    const char request[] = "GET /echo HTTP/1.1\r\n"
+                           "Host: localhost\r\n"
+                           "Upgrade: websocket\r\n"
+                           "Connection: Upgrade\r\n"
+                           "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                           "Sec-WebSocket-Version: 13\r\n\r\n";
+    ::write(fd, request, sizeof request - 1);
+    // 逐字节读到空行，避免把之后的帧读进来
+    std::string response;
+    char c;
+    while (response.size() < 4 || response.compare(response.size() - 4, 4, "\r\n\r\n") != 0)
+    {
+        if (::read(fd, &c, 1) != 1)
+        {
+            return false;
+        }
+        response.push_back(c);
+    }
+    // RFC 6455中的示例key对应的accept
+    return response.compare(0, 12, "HTTP/1.1 101") == 0
+        && response.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos;
+}
+
+static void clientThread(size_t messageSize, int fragments, int batch, std::atomic<uint64_t> *messages)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0 || !handshake(fd))
+    {
+        perror("connect");
+        ::close(fd);
+        return;
+    }
+
+    std::string payload(messageSize, 'm');
+    std::string frames;
+    size_t fragmentSize = (messageSize + fragments - 1) / fragments;
+    for (int i = 0; i < batch; ++i)
+    {
+        size_t offset = 0;
+        int opcode = 2;
+        do
+        {
+            size_t len = std::min(fragmentSize, messageSize - offset);
+            bool fin = offset + len == messageSize;
+            appendFrame(frames, fin, opcode, payload.data() + offset, len);
+            offset += len;
+            opcode = 0;
+        } while (offset < messageSize);
+    }
+
+    size_t responseSize = (serverHeaderSize(messageSize) + messageSize) * batch;
+    std::vector<char> buf(responseSize);
+    while (g_running)
+    {
+        if (::write(fd, frames.data(), frames.size()) != static_cast<ssize_t>(frames.size())
+            || !readFully(fd, buf.data(), responseSize))
+        {
+            break;
+        }
+        if (buf[serverHeaderSize(messageSize)] != 'm')
+        {
+            fprintf(stderr, "bad echo\n");
+            break;
+        }
+        *messages += batch;
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t messageSize = argc > 1 ? atoi(argv[1]) : 64;
+    int fragments = argc > 2 ? atoi(argv[2]) : 1;
+    int connections = argc > 3 ? atoi(argv[3]) : 4;
+    int batch = argc > 4 ? atoi(argv[4]) : 16;
+    int seconds = argc > 5 ? atoi(argv[5]) : 5;
+    Logger::setLogLevel(ERROR);
+
+    const size_t sizes[] = { 64, 1024, 64 * 1024 };
+    for (size_t len : sizes)
+    {
+        printf("unmask %6zu bytes: library %.2f GB/s, naive %.2f GB/s\n", len,
+               measureUnmask(WebSocketConnection::unmask, len), measureUnmask(naiveUnmask, len));
+    }
+
+    EventLoop loop;
+    WebSocketServer server(&loop, InetAddress(kPort), "ws-echo");
+    server.setThreadNum(1);
+    server.setMessageCallback([](const WebSocketConnectionPtr &ws, const char *data, size_t len, bool) {
+        ws->sendBinary(data, len);
+    });
+    server.start();
+
+    std::atomic<uint64_t> messages(0);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(clientThread, messageSize, fragments, batch, &messages);
+    }
+
+    uint64_t last = 0;
+    loop.runEvery(1.0, [&]() {
+        uint64_t now = messages.load();
+        printf("%llu msg/s\n", static_cast<unsigned long long>(now - last));
+        fflush(stdout);
+        last = now;
+    });
+    uint64_t total = 0;
+    loop.runAfter(seconds + 0.01, [&]() {
+        total = messages.load();
+        g_running = false;
+        loop.runAfter(0.5, [&]() { loop.quit(); });
+    });
+    loop.loop();
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+
+    double rate = total / static_cast<double>(seconds);
+    printf("size=%zu fragments=%d connections=%d batch=%d: %.0f msg/s, %.1f MB/s\n",
+           messageSize, fragments, connections, batch, rate, rate * messageSize / 1e6);
+    return 0;
+}
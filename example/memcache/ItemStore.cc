@@ -0,0 +1,242 @@
+#include "ItemStore.h"
+
+#include <string.h>
+
+namespace
+{
+const size_t kInitialBuckets = 1 << 16;
+// 同一级别淘汰一个条目就能空出一个chunk，多试几次只是保险
+const int kMaxEvictTries = 8;
+} // namespace
+
+ItemStore::ItemStore(size_t memoryLimit)
+    : slabs_(memoryLimit)
+    , buckets_(kInitialBuckets, nullptr)
+    , lruHeads_(slabs_.numClasses(), nullptr)
+    , lruTails_(slabs_.numClasses(), nullptr)
+    , items_(0)
+    , gets_(0)
+    , hits_(0)
+    , sets_(0)
+    , evictions_(0)
+{
+}
+
+ItemStore::~ItemStore()
+{
+}
+
+uint64_t ItemStore::hashKey(const StringPiece &key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size(); ++i)
+    {
+        hash ^= static_cast<uint8_t>(key[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// 返回匹配的条目，slot指向链表中指向它的指针，删除时直接修改
+ItemStore::Item *ItemStore::find(const StringPiece &key, uint64_t hash, Item ***slot)
+{
+    Item **p = &buckets_[hash & (buckets_.size() - 1)];
+    while (*p != nullptr)
+    {
+        Item *item = *p;
+        if (item->hash == hash && item->nkey == key.size() && memcmp(item->key(), key.data(), key.size()) == 0)
+        {
+            *slot = p;
+            return item;
+        }
+        p = &item->hnext;
+    }
+    *slot = p;
+    return nullptr;
+}
+
+void ItemStore::linkLru(Item *item)
+{
+    item->prev = nullptr;
+    item->next = lruHeads_[item->cls];
+    if (item->next != nullptr)
+    {
+        item->next->prev = item;
+    }
+    else
+    {
+        lruTails_[item->cls] = item;
+    }
+    lruHeads_[item->cls] = item;
+}
+
+void ItemStore::unlinkLru(Item *item)
+{
+    if (item->prev != nullptr)
+    {
+        item->prev->next = item->next;
+    }
+    else
+    {
+        lruHeads_[item->cls] = item->next;
+    }
+    if (item->next != nullptr)
+    {
+        item->next->prev = item->prev;
+    }
+    else
+    {
+        lruTails_[item->cls] = item->prev;
+    }
+}
+
+void ItemStore::unlink(Item *item, Item **slot)
+{
+    *slot = item->hnext;
+    unlinkLru(item);
+    slabs_.deallocate(item, item->cls);
+    --items_;
+}
+
+// 分配失败时淘汰同一级别最久没有访问的条目
+ItemStore::Item *ItemStore::allocate(int cls)
+{
+    void *chunk = slabs_.allocate(cls);
+    for (int i = 0; chunk == nullptr && i < kMaxEvictTries && lruTails_[cls] != nullptr; ++i)
+    {
+        Item *victim = lruTails_[cls];
+        Item **slot;
+        find(StringPiece(victim->key(), victim->nkey), victim->hash, &slot);
+        unlink(victim, slot);
+        ++evictions_;
+        chunk = slabs_.allocate(cls);
+    }
+    return static_cast<Item*>(chunk);
+}
+
+// 平均每个桶超过1.5个条目时桶数翻倍
+void ItemStore::grow()
+{
+    std::vector<Item*> buckets(buckets_.size() * 2, nullptr);
+    size_t mask = buckets.size() - 1;
+    for (Item *head : buckets_)
+    {
+        while (head != nullptr)
+        {
+            Item *next = head->hnext;
+            Item *&bucket = buckets[head->hash & mask];
+            head->hnext = bucket;
+            bucket = head;
+            head = next;
+        }
+    }
+    buckets_.swap(buckets);
+}
+
+const ItemStore::Item *ItemStore::get(const StringPiece &key, uint64_t hash, time_t now)
+{
+    ++gets_;
+    Item **slot;
+    Item *item = find(key, hash, &slot);
+    if (item == nullptr)
+    {
+        return nullptr;
+    }
+    if (item->exptime != 0 && item->exptime <= now)
+    {
+        unlink(item, slot);
+        return nullptr;
+    }
+    ++hits_;
+    unlinkLru(item);
+    linkLru(item);
+    return item;
+}
+
+ItemStore::Result ItemStore::store(Mode mode, const StringPiece &key, uint64_t hash, uint32_t flags,
+                                   time_t exptime, const char *data, size_t len, time_t now)
+{
+    ++sets_;
+    Item **slot;
+    Item *old = find(key, hash, &slot);
+    if (old != nullptr && old->exptime != 0 && old->exptime <= now)
+    {
+        unlink(old, slot);
+        old = nullptr;
+    }
+    if ((mode == kAdd && old != nullptr) || (mode == kReplace && old == nullptr))
+    {
+        return kNotStored;
+    }
+
+    int cls = slabs_.classFor(sizeof(Item) + key.size() + len);
+    if (cls < 0)
+    {
+        return kTooLarge;
+    }
+    // 先删除旧值，它的chunk可以直接被新值复用
+    if (old != nullptr)
+    {
+        unlink(old, slot);
+    }
+    Item *item = allocate(cls);
+    if (item == nullptr)
+    {
+        return kOutOfMemory;
+    }
+    item->hash = hash;
+    item->exptime = exptime;
+    item->flags = flags;
+    item->nbytes = static_cast<uint32_t>(len);
+    item->nkey = static_cast<uint8_t>(key.size());
+    item->cls = static_cast<uint8_t>(cls);
+    memcpy(const_cast<char*>(item->key()), key.data(), key.size());
+    memcpy(const_cast<char*>(item->value()), data, len);
+
+    // 淘汰可能改变了桶中的链表，重新定位插入点
+    Item *&bucket = buckets_[hash & (buckets_.size() - 1)];
+    item->hnext = bucket;
+    bucket = item;
+    linkLru(item);
+    if (++items_ > buckets_.size() + buckets_.size() / 2)
+    {
+        grow();
+    }
+    return kStored;
+}
+
+bool ItemStore::remove(const StringPiece &key, uint64_t hash)
+{
+    Item **slot;
+    Item *item = find(key, hash, &slot);
+    if (item == nullptr)
+    {
+        return false;
+    }
+    unlink(item, slot);
+    return true;
+}
+
+void ItemStore::flushAll()
+{
+    for (Item *&head : buckets_)
+    {
+        while (head != nullptr)
+        {
+            Item *item = head;
+            unlink(item, &head);
+        }
+    }
+}
+
+ItemStore::Stats ItemStore::stats() const
+{
+    Stats s;
+    s.items = items_;
+    s.bytes = slabs_.allocatedBytes();
+    s.gets = gets_;
+    s.hits = hits_;
+    s.sets = sets_;
+    s.evictions = evictions_;
+    return s;
+}
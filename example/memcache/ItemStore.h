@@ -0,0 +1,82 @@
+#pragma once
+
+#include "SlabAllocator.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/StringPiece.h>
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+/*
+ * 缓存的一个分片：链式哈希表 + 每个slab级别一条LRU链表
+ * 条目的头部、key和value放在同一个slab chunk中，一次分配
+ * 内存用满时从同一级别的LRU尾部淘汰，过期的条目在访问时惰性删除
+ * 只由所属的EventLoop线程访问，不加锁
+ */
+class ItemStore : noncopyable
+{
+public:
+    struct Item
+    {
+        Item *prev;     // LRU链表，表头是最近访问的
+        Item *next;
+        Item *hnext;    // 哈希桶中的下一个
+        uint64_t hash;
+        time_t exptime; // 绝对时间，0表示不过期
+        uint32_t flags;
+        uint32_t nbytes;
+        uint8_t nkey;
+        uint8_t cls;
+
+        const char *key() const { return reinterpret_cast<const char*>(this + 1); }
+        const char *value() const { return key() + nkey; }
+    };
+
+    enum Mode { kSet, kAdd, kReplace };
+    enum Result { kStored, kNotStored, kTooLarge, kOutOfMemory };
+
+    struct Stats
+    {
+        size_t items;
+        size_t bytes;       // 已经从系统申请的slab页
+        uint64_t gets;
+        uint64_t hits;
+        uint64_t sets;
+        uint64_t evictions;
+    };
+
+    explicit ItemStore(size_t memoryLimit);
+    ~ItemStore();
+
+    // 64位FNV-1a，高32位选分片，低位选桶，两者互不相关
+    static uint64_t hashKey(const StringPiece &key);
+
+    // 找不到或已过期时返回nullptr，返回的条目在下一次修改本分片之前有效
+    const Item *get(const StringPiece &key, uint64_t hash, time_t now);
+    Result store(Mode mode, const StringPiece &key, uint64_t hash, uint32_t flags, time_t exptime,
+                 const char *data, size_t len, time_t now);
+    bool remove(const StringPiece &key, uint64_t hash);
+    void flushAll();
+
+    Stats stats() const;
+
+private:
+    Item *find(const StringPiece &key, uint64_t hash, Item ***slot);
+    void unlink(Item *item, Item **slot);
+    void linkLru(Item *item);
+    void unlinkLru(Item *item);
+    Item *allocate(int cls);
+    void grow();
+
+    SlabAllocator slabs_;
+    std::vector<Item*> buckets_;    // 大小为2的幂
+    std::vector<Item*> lruHeads_;   // 每个slab级别一条
+    std::vector<Item*> lruTails_;
+    size_t items_;
+    uint64_t gets_;
+    uint64_t hits_;
+    uint64_t sets_;
+    uint64_t evictions_;
+};
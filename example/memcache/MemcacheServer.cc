@@ -0,0 +1,524 @@
+#include "MemcacheServer.h"
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <deque>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+const size_t kMaxLineBytes = 2048;
+const size_t kMaxKeyBytes = 250;
+const size_t kMaxValueBytes = SlabAllocator::kPageSize - sizeof(ItemStore::Item) - kMaxKeyBytes;
+// memcached的约定：不超过30天的exptime是相对时间，否则是unix时间戳
+const long kRelativeExpireLimit = 60 * 60 * 24 * 30;
+const int kMaxTokens = 24;
+
+struct Reply
+{
+    bool ready;
+    std::string data;
+};
+
+bool parseNumber(const StringPiece &token, uint64_t *value)
+{
+    if (token.empty() || token.size() > 19)
+    {
+        return false;
+    }
+    uint64_t v = 0;
+    for (size_t i = 0; i < token.size(); ++i)
+    {
+        if (token[i] < '0' || token[i] > '9')
+        {
+            return false;
+        }
+        v = v * 10 + (token[i] - '0');
+    }
+    *value = v;
+    return true;
+}
+
+bool parseSigned(const StringPiece &token, long *value)
+{
+    uint64_t v;
+    if (!token.empty() && token[0] == '-')
+    {
+        if (!parseNumber(StringPiece(token.data() + 1, token.size() - 1), &v))
+        {
+            return false;
+        }
+        *value = -static_cast<long>(v);
+        return true;
+    }
+    if (!parseNumber(token, &v))
+    {
+        return false;
+    }
+    *value = static_cast<long>(v);
+    return true;
+}
+
+time_t absoluteExptime(long exptime, time_t now)
+{
+    if (exptime == 0)
+    {
+        return 0;
+    }
+    if (exptime < 0)
+    {
+        return 1; // 已经过期
+    }
+    return exptime > kRelativeExpireLimit ? static_cast<time_t>(exptime) : now + exptime;
+}
+
+// 最多切分出maxTokens个以空格分隔的token
+int splitTokens(const char *begin, const char *end, StringPiece *tokens, int maxTokens = 1)
+{
+    int n = 0;
+    const char *p = begin;
+    while (p < end && n < maxTokens)
+    {
+        while (p < end && *p == ' ')
+        {
+            ++p;
+        }
+        const char *start = p;
+        while (p < end && *p != ' ')
+        {
+            ++p;
+        }
+        if (p > start)
+        {
+            tokens[n++] = StringPiece(start, p - start);
+        }
+    }
+    return n;
+}
+
+// 执行一条命令，应答追加到out中；Out是Buffer(本地直接写输出缓冲区)或std::string(转发或排队)
+template <typename Out>
+void execute(ItemStore *store, size_t shardIndex, MemcacheServer::Command command, const StringPiece &key,
+             uint64_t hash, uint32_t flags, time_t exptime, const StringPiece &data, bool noreply,
+             time_t now, Out *out)
+{
+    char line[kMaxKeyBytes + 64];
+    switch (command)
+    {
+    case MemcacheServer::kGet:
+    {
+        const ItemStore::Item *item = store->get(key, hash, now);
+        if (item != nullptr)
+        {
+            int len = snprintf(line, sizeof line, "VALUE %.*s %u %u\r\n",
+                               static_cast<int>(item->nkey), item->key(), item->flags, item->nbytes);
+            out->append(line, len);
+            out->append(item->value(), item->nbytes);
+            out->append("\r\n", 2);
+        }
+        break;
+    }
+    case MemcacheServer::kSet:
+    case MemcacheServer::kAdd:
+    case MemcacheServer::kReplace:
+    {
+        ItemStore::Mode mode = command == MemcacheServer::kSet ? ItemStore::kSet
+                             : (command == MemcacheServer::kAdd ? ItemStore::kAdd : ItemStore::kReplace);
+        ItemStore::Result result = store->store(mode, key, hash, flags, exptime, data.data(), data.size(), now);
+        if (noreply)
+        {
+            break;
+        }
+        if (result == ItemStore::kStored)
+        {
+            out->append("STORED\r\n", 8);
+        }
+        else if (result == ItemStore::kNotStored)
+        {
+            out->append("NOT_STORED\r\n", 12);
+        }
+        else
+        {
+            const char error[] = "SERVER_ERROR out of memory storing object\r\n";
+            out->append(error, sizeof error - 1);
+        }
+        break;
+    }
+    case MemcacheServer::kDelete:
+    {
+        bool deleted = store->remove(key, hash);
+        if (!noreply)
+        {
+            out->append(deleted ? "DELETED\r\n" : "NOT_FOUND\r\n", deleted ? 9 : 11);
+        }
+        break;
+    }
+    case MemcacheServer::kFlushAll:
+        store->flushAll();
+        break;
+    case MemcacheServer::kStats:
+    {
+        ItemStore::Stats s = store->stats();
+        int len = snprintf(line, sizeof line,
+                           "STAT shard%zu_items %zu\r\nSTAT shard%zu_bytes %zu\r\n"
+                           "STAT shard%zu_get_hits %llu\r\nSTAT shard%zu_get_misses %llu\r\n"
+                           "STAT shard%zu_sets %llu\r\nSTAT shard%zu_evictions %llu\r\n",
+                           shardIndex, s.items, shardIndex, s.bytes,
+                           shardIndex, static_cast<unsigned long long>(s.hits),
+                           shardIndex, static_cast<unsigned long long>(s.gets - s.hits),
+                           shardIndex, static_cast<unsigned long long>(s.sets),
+                           shardIndex, static_cast<unsigned long long>(s.evictions));
+        out->append(line, len);
+        break;
+    }
+    }
+}
+} // namespace
+
+/*
+ * 每个连接的状态，挂在TcpConnection的context上，只在连接所在的loop中访问
+ * replies中是还不能发出的应答，第i个的编号为firstSeq + i；没有未完成的转发请求时应答直接写进output
+ */
+struct MemcacheServer::Session
+{
+    explicit Session(size_t numShards)
+        : firstSeq(0)
+        , forward(numShards)
+        , closing(false)
+    {}
+
+    Buffer output;
+    std::deque<Reply> replies;
+    uint64_t firstSeq;
+    std::vector<std::vector<Request>> forward; // 本次onMessage中要转发到各分片的请求
+    bool closing;
+
+    void append(const char *data, size_t len)
+    {
+        if (replies.empty())
+        {
+            output.append(data, len);
+        }
+        else
+        {
+            replies.push_back(Reply());
+            replies.back().ready = true;
+            replies.back().data.assign(data, len);
+        }
+    }
+
+    // 把排在最前面、已经完成的应答移到output
+    void drain()
+    {
+        while (!replies.empty() && replies.front().ready)
+        {
+            output.append(replies.front().data.data(), replies.front().data.size());
+            replies.pop_front();
+            ++firstSeq;
+        }
+    }
+};
+
+MemcacheServer::MemcacheServer(EventLoop *loop,
+                               const InetAddress &listenAddr,
+                               int numThreads,
+                               size_t memoryPerShard)
+    : server_(loop, listenAddr, "memcache")
+    , memoryPerShard_(memoryPerShard)
+{
+    server_.setThreadNum(numThreads);
+    server_.setThreadInitCallback(std::bind(&MemcacheServer::onThreadInit, this, std::placeholders::_1));
+    server_.setConnectionCallback(std::bind(&MemcacheServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&MemcacheServer::onMessage, this, std::placeholders::_1,
+                                         std::placeholders::_2, std::placeholders::_3));
+}
+
+MemcacheServer::~MemcacheServer()
+{
+}
+
+void MemcacheServer::start()
+{
+    server_.start();
+    LOG_INFO("MemcacheServer listening on %s, %zu shards", server_.ipPort().c_str(), shards_.size());
+}
+
+// 各loop线程并行初始化，分片在自己的线程中创建
+void MemcacheServer::onThreadInit(EventLoop *loop)
+{
+    std::unique_ptr<Shard> shard(new Shard);
+    shard->loop = loop;
+    shard->store.reset(new ItemStore(memoryPerShard_));
+    std::unique_lock<std::mutex> lock(mutex_);
+    shard->index = shards_.size();
+    loopShards_[loop] = shard.get();
+    shards_.push_back(std::move(shard));
+}
+
+void MemcacheServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        // 转发到其他分片的请求的应答是后补发的，不能让Nagle算法把它们压到下一次ACK之后
+        conn->setTcpNoDelay(true);
+        conn->setContext(std::make_shared<Session>(shards_.size()));
+    }
+}
+
+/*
+ * 依次处理buf中完整的命令：本分片的命令立即执行，其他分片的命令按分片攒起来
+ * 处理完后每个分片一次queueInLoop，本地的应答一次send
+ */
+void MemcacheServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    Session *session = static_cast<Session*>(conn->getContext().get());
+    Shard *local = loopShards_[conn->getLoop()];
+    time_t now = ::time(nullptr);
+    while (!session->closing && buf->readableBytes() > 0
+           && processCommand(conn, session, local, buf, now))
+    {
+    }
+    if (session->closing)
+    {
+        buf->retrieveAll();
+    }
+
+    for (size_t i = 0; i < session->forward.size(); ++i)
+    {
+        std::vector<Request> &requests = session->forward[i];
+        if (!requests.empty())
+        {
+            std::vector<Request> batch;
+            batch.swap(requests);
+            shards_[i]->loop->queueInLoop(std::bind(&MemcacheServer::executeBatch, shards_[i].get(),
+                                                    conn, std::move(batch)));
+        }
+    }
+    if (session->output.readableBytes() > 0)
+    {
+        conn->send(&session->output);
+    }
+    if (session->closing && session->replies.empty())
+    {
+        conn->shutdown();
+    }
+}
+
+bool MemcacheServer::processCommand(const TcpConnectionPtr &conn, Session *session, Shard *local,
+                                    Buffer *buf, time_t now)
+{
+    const char *begin = buf->peek();
+    const char *eol = static_cast<const char*>(memchr(begin, '\n', buf->readableBytes()));
+    if (eol == nullptr)
+    {
+        if (buf->readableBytes() > kMaxLineBytes)
+        {
+            session->append("CLIENT_ERROR line too long\r\n", 28);
+            session->closing = true;
+        }
+        return false;
+    }
+    size_t lineBytes = eol + 1 - begin;
+    const char *end = eol > begin && eol[-1] == '\r' ? eol - 1 : eol;
+
+    StringPiece tokens[kMaxTokens];
+    int n = splitTokens(begin, end, tokens, kMaxTokens);
+    if (n == 0)
+    {
+        session->append("ERROR\r\n", 7);
+        buf->retrieve(lineBytes);
+        return true;
+    }
+    const StringPiece &cmd = tokens[0];
+
+    if (cmd == "get" || cmd == "gets")
+    {
+        // key的个数不受kMaxTokens限制，从命令之后逐个切分
+        const char *p = cmd.data() + cmd.size();
+        StringPiece key;
+        while (splitTokens(p, end, &key) > 0)
+        {
+            p = key.data() + key.size();
+            if (key.size() <= kMaxKeyBytes)
+            {
+                dispatch(session, local, kGet, key, ItemStore::hashKey(key), 0, 0, StringPiece(), false, now);
+            }
+        }
+        session->append("END\r\n", 5);
+        buf->retrieve(lineBytes);
+        return true;
+    }
+
+    if (cmd == "set" || cmd == "add" || cmd == "replace")
+    {
+        uint64_t flags, bytes;
+        long exptime;
+        if (n < 5 || tokens[1].size() > kMaxKeyBytes || !parseNumber(tokens[2], &flags)
+            || !parseSigned(tokens[3], &exptime) || !parseNumber(tokens[4], &bytes))
+        {
+            session->append("CLIENT_ERROR bad command line format\r\n", 38);
+            session->closing = true;
+            return false;
+        }
+        if (bytes > kMaxValueBytes)
+        {
+            const char error[] = "SERVER_ERROR object too large for cache\r\n";
+            session->append(error, sizeof error - 1);
+            session->closing = true;
+            return false;
+        }
+        if (buf->readableBytes() < lineBytes + bytes + 2)
+        {
+            // 数据块还没收齐，提前留出空间
+            buf->ensureWritableBytes(lineBytes + bytes + 2 - buf->readableBytes());
+            return false;
+        }
+        const char *data = begin + lineBytes;
+        if (data[bytes] != '\r' || data[bytes + 1] != '\n')
+        {
+            session->append("CLIENT_ERROR bad data chunk\r\n", 29);
+            session->closing = true;
+            return false;
+        }
+        Command command = cmd == "set" ? kSet : (cmd == "add" ? kAdd : kReplace);
+        bool noreply = n > 5 && tokens[5] == "noreply";
+        dispatch(session, local, command, tokens[1], ItemStore::hashKey(tokens[1]),
+                 static_cast<uint32_t>(flags), absoluteExptime(exptime, now),
+                 StringPiece(data, bytes), noreply, now);
+        buf->retrieve(lineBytes + bytes + 2);
+        return true;
+    }
+
+    if (cmd == "delete" && n >= 2)
+    {
+        bool noreply = n > 2 && tokens[n - 1] == "noreply";
+        dispatch(session, local, kDelete, tokens[1], ItemStore::hashKey(tokens[1]), 0, 0,
+                 StringPiece(), noreply, now);
+    }
+    else if (cmd == "flush_all")
+    {
+        // 清空所有分片，不等它们完成就应答，和memcached一样不保证之后的读一定看不到旧值
+        for (const std::unique_ptr<Shard> &shard : shards_)
+        {
+            Request request = Request();
+            request.command = kFlushAll;
+            request.noreply = true;
+            if (shard.get() == local)
+            {
+                local->store->flushAll();
+            }
+            else
+            {
+                shard->loop->queueInLoop(std::bind(&MemcacheServer::executeBatch, shard.get(), conn,
+                                                   std::vector<Request>(1, request)));
+            }
+        }
+        if (!(n > 1 && tokens[n - 1] == "noreply"))
+        {
+            session->append("OK\r\n", 4);
+        }
+    }
+    else if (cmd == "stats")
+    {
+        for (const std::unique_ptr<Shard> &shard : shards_)
+        {
+            // 每个分片的统计都在它自己的loop中读取，hash取分片对应的高位
+            uint64_t hash = static_cast<uint64_t>(shard->index) << 32;
+            dispatch(session, local, kStats, StringPiece(), hash, 0, 0, StringPiece(), false, now);
+        }
+        session->append("END\r\n", 5);
+    }
+    else if (cmd == "version")
+    {
+        session->append("VERSION mymuduo-memcache 1.0\r\n", 30);
+    }
+    else if (cmd == "quit")
+    {
+        session->closing = true;
+    }
+    else
+    {
+        session->append("ERROR\r\n", 7);
+    }
+    buf->retrieve(lineBytes);
+    return true;
+}
+
+// 本分片的命令立即执行，否则占一个应答编号并加入转发的批次
+void MemcacheServer::dispatch(Session *session, Shard *local, Command command, const StringPiece &key,
+                              uint64_t hash, uint32_t flags, time_t exptime, const StringPiece &data,
+                              bool noreply, time_t now)
+{
+    Shard *shard = shardOf(hash);
+    if (shard == local)
+    {
+        if (session->replies.empty())
+        {
+            execute(local->store.get(), local->index, command, key, hash, flags, exptime, data, noreply,
+                    now, &session->output);
+        }
+        else
+        {
+            session->replies.push_back(Reply());
+            Reply &reply = session->replies.back();
+            reply.ready = true;
+            execute(local->store.get(), local->index, command, key, hash, flags, exptime, data, noreply,
+                    now, &reply.data);
+        }
+        return;
+    }
+
+    Request request;
+    request.command = command;
+    request.seq = session->firstSeq + session->replies.size();
+    request.hash = hash;
+    request.key.assign(key.data(), key.size());
+    request.flags = flags;
+    request.exptime = exptime;
+    request.data.assign(data.data(), data.size());
+    request.noreply = noreply;
+    session->replies.push_back(Reply());
+    session->replies.back().ready = false;
+    session->forward[shard->index].push_back(std::move(request));
+}
+
+void MemcacheServer::executeBatch(Shard *shard, const TcpConnectionPtr &conn, const std::vector<Request> &requests)
+{
+    time_t now = ::time(nullptr);
+    std::vector<std::pair<uint64_t, std::string>> results(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        const Request &r = requests[i];
+        results[i].first = r.seq;
+        execute(shard->store.get(), shard->index, r.command, StringPiece(r.key), r.hash, r.flags, r.exptime,
+                StringPiece(r.data), r.noreply, now, &results[i].second);
+    }
+    if (requests.size() == 1 && requests[0].command == kFlushAll)
+    {
+        return; // flush_all不占应答编号
+    }
+    conn->getLoop()->queueInLoop(std::bind(&MemcacheServer::completeBatch, conn, std::move(results)));
+}
+
+void MemcacheServer::completeBatch(const TcpConnectionPtr &conn,
+                                   std::vector<std::pair<uint64_t, std::string>> &results)
+{
+    Session *session = static_cast<Session*>(conn->getContext().get());
+    for (std::pair<uint64_t, std::string> &result : results)
+    {
+        Reply &reply = session->replies[result.first - session->firstSeq];
+        reply.ready = true;
+        reply.data.swap(result.second);
+    }
+    session->drain();
+    if (session->output.readableBytes() > 0)
+    {
+        conn->send(&session->output);
+    }
+    if (session->closing && session->replies.empty())
+    {
+        conn->shutdown();
+    }
+}
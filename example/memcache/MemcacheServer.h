@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ItemStore.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/StringPiece.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * memcached文本协议的缓存服务器，用来在接近真实的负载下评估Buffer、EventLoop和TcpConnection的改动
+ * 支持get/set/add/replace/delete/flush_all/stats/version/quit
+ *
+ * 每个subLoop拥有一个ItemStore分片，分片只在自己的loop线程中访问，不加锁
+ * key按哈希值分配到分片，属于其他分片的请求攒成一批，通过queueInLoop交给那个loop执行，
+ * 结果再通过queueInLoop送回连接所在的loop；每个连接按请求顺序给应答编号，乱序回来的结果排好序再发出
+ * 分片和loop一一对应，不能开启TcpServer的负载均衡或者在运行时调整loop数
+ */
+class MemcacheServer : noncopyable
+{
+public:
+    MemcacheServer(EventLoop *loop,
+                   const InetAddress &listenAddr,
+                   int numThreads,
+                   size_t memoryPerShard);
+    ~MemcacheServer();
+
+    void start();
+
+    enum Command { kGet, kSet, kAdd, kReplace, kDelete, kFlushAll, kStats };
+
+    // 转发到其他分片的请求，key和data拷贝一份
+    struct Request
+    {
+        Command command;
+        uint64_t seq;   // 连接上的应答编号
+        uint64_t hash;
+        std::string key;
+        uint32_t flags;
+        time_t exptime;
+        std::string data;
+        bool noreply;
+    };
+
+private:
+    struct Shard
+    {
+        EventLoop *loop;
+        size_t index;
+        std::unique_ptr<ItemStore> store;
+    };
+    struct Session;
+
+    void onThreadInit(EventLoop *loop);
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // 处理buf开头的一条命令，命令不完整时返回false
+    bool processCommand(const TcpConnectionPtr &conn, Session *session, Shard *local, Buffer *buf, time_t now);
+    void dispatch(Session *session, Shard *local, Command command, const StringPiece &key, uint64_t hash,
+                  uint32_t flags, time_t exptime, const StringPiece &data, bool noreply, time_t now);
+    Shard *shardOf(uint64_t hash) { return shards_[(hash >> 32) % shards_.size()].get(); }
+
+    // 在分片的loop中执行一批转发来的请求
+    static void executeBatch(Shard *shard, const TcpConnectionPtr &conn, const std::vector<Request> &requests);
+    // 在连接的loop中接收转发请求的结果
+    static void completeBatch(const TcpConnectionPtr &conn,
+                              std::vector<std::pair<uint64_t, std::string>> &results);
+
+    TcpServer server_;
+    size_t memoryPerShard_;
+    std::mutex mutex_; // 只在start期间保护shards_
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::unordered_map<EventLoop*, Shard*> loopShards_; // start之后只读
+};
@@ -0,0 +1,95 @@
+#include "SlabAllocator.h"
+
+#include <stdlib.h>
+
+SlabAllocator::SlabAllocator(size_t memoryLimit, double factor)
+    : memoryLimit_(memoryLimit)
+{
+    size_t size = kMinChunkSize;
+    while (size < kPageSize)
+    {
+        SlabClass slab = { size, nullptr, nullptr, 0 };
+        classes_.push_back(slab);
+        // 按8字节对齐，保证chunk中的条目头部对齐
+        size = (static_cast<size_t>(size * factor) + 7) & ~static_cast<size_t>(7);
+    }
+    SlabClass largest = { kPageSize, nullptr, nullptr, 0 };
+    classes_.push_back(largest);
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    for (char *page : pages_)
+    {
+        ::free(page);
+    }
+}
+
+int SlabAllocator::classFor(size_t size) const
+{
+    if (size > kPageSize)
+    {
+        return -1;
+    }
+    // 级别数不多(factor为1.25时约40级)，二分查找
+    int lo = 0;
+    int hi = static_cast<int>(classes_.size()) - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (classes_[mid].chunkSize >= size)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+bool SlabAllocator::newPage(SlabClass &slab)
+{
+    // 至少允许每一级有一页，否则内存上限很小时某些级别永远分配不到
+    if (allocatedBytes() + kPageSize > memoryLimit_ && slab.current != nullptr)
+    {
+        return false;
+    }
+    char *page = static_cast<char*>(::malloc(kPageSize));
+    if (page == nullptr)
+    {
+        return false;
+    }
+    pages_.push_back(page);
+    slab.current = page;
+    slab.remaining = kPageSize / slab.chunkSize;
+    return true;
+}
+
+void *SlabAllocator::allocate(int cls)
+{
+    SlabClass &slab = classes_[cls];
+    if (slab.freeList != nullptr)
+    {
+        FreeChunk *chunk = slab.freeList;
+        slab.freeList = chunk->next;
+        return chunk;
+    }
+    if (slab.remaining == 0 && !newPage(slab))
+    {
+        return nullptr;
+    }
+    void *chunk = slab.current;
+    slab.current += slab.chunkSize;
+    --slab.remaining;
+    return chunk;
+}
+
+void SlabAllocator::deallocate(void *chunk, int cls)
+{
+    SlabClass &slab = classes_[cls];
+    FreeChunk *free = static_cast<FreeChunk*>(chunk);
+    free->next = slab.freeList;
+    slab.freeList = free;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <mymuduo/noncopyable.h>
+
+#include <stddef.h>
+#include <vector>
+
+/*
+ * 按大小分级的内存分配器，和memcached的slab相同的思路
+ * 每一级的chunk大小是上一级的factor倍，内存以1MB的页为单位申请，页属于哪一级就切成该级大小的chunk
+ * 释放的chunk挂回本级的空闲链表，不会还给系统，长期运行也没有外部碎片
+ * 只在一个线程中使用，不加锁
+ */
+class SlabAllocator : noncopyable
+{
+public:
+    static const size_t kPageSize = 1024 * 1024;
+    static const size_t kMinChunkSize = 64;
+
+    SlabAllocator(size_t memoryLimit, double factor = 1.25);
+    ~SlabAllocator();
+
+    // 能容纳size字节的最小的级别，超过最大chunk时返回-1
+    int classFor(size_t size) const;
+    // 从该级分配一个chunk，没有空闲chunk且内存达到上限时返回nullptr，由调用者淘汰旧数据后重试
+    void *allocate(int cls);
+    void deallocate(void *chunk, int cls);
+
+    int numClasses() const { return static_cast<int>(classes_.size()); }
+    size_t chunkSize(int cls) const { return classes_[cls].chunkSize; }
+    size_t allocatedBytes() const { return pages_.size() * kPageSize; }
+    size_t memoryLimit() const { return memoryLimit_; }
+
+private:
+    struct FreeChunk
+    {
+        FreeChunk *next;
+    };
+
+    struct SlabClass
+    {
+        size_t chunkSize;
+        FreeChunk *freeList;
+        char *current;      // 最新的页中还没有切出去的部分
+        size_t remaining;   // current之后剩余的chunk数
+    };
+
+    bool newPage(SlabClass &slab);
+
+    size_t memoryLimit_;
+    std::vector<SlabClass> classes_;
+    std::vector<char*> pages_;
+};
@@ -0,0 +1,21 @@
+#include "MemcacheServer.h"
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <stdlib.h>
+
+// ./memcache_server [port] [threads] [memoryMBPerShard]
+int main(int argc, char *argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 11211);
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    size_t memoryMB = argc > 3 ? atoi(argv[3]) : 256;
+    Logger::setLogLevel(INFO);
+
+    EventLoop loop;
+    MemcacheServer server(&loop, InetAddress(port, "0.0.0.0"), threads, memoryMB * 1024 * 1024);
+    server.start();
+    loop.loop();
+    return 0;
+}
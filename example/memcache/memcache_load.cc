@@ -0,0 +1,274 @@
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * memcache_server的压测工具，也可以压测真正的memcached
+ * ./memcache_load [host] [port] [connections] [pipeline] [getRatio] [keys] [valueSize] [seconds]
+ * 先用set写入全部key，然后每个连接一个线程，一次发出pipeline个请求(按getRatio随机选get或set)，收齐应答再发下一批
+ */
+
+static std::atomic_bool g_running(true);
+
+struct Options
+{
+    std::string host;
+    uint16_t port;
+    int connections;
+    int pipeline;
+    double getRatio;
+    int keys;
+    int valueSize;
+    int seconds;
+};
+
+static int connectTo(const Options &opt)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    ::inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+    {
+        perror("connect");
+        ::close(fd);
+        return -1;
+    }
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    return fd;
+}
+
+// 流式解析应答，统计收齐了多少个；get的应答以END结束，VALUE之后的数据块整体跳过
+class ResponseReader
+{
+public:
+    explicit ResponseReader(int fd)
+        : fd_(fd)
+        , buf_(1 << 20)
+        , begin_(0)
+        , end_(0)
+        , hits_(0)
+        , errors_(0)
+    {}
+
+    bool read(int responses)
+    {
+        while (responses > 0)
+        {
+            const char *line = buf_.data() + begin_;
+            const char *eol = static_cast<const char*>(memchr(line, '\n', end_ - begin_));
+            if (eol == nullptr)
+            {
+                if (!fill())
+                {
+                    return false;
+                }
+                continue;
+            }
+            size_t lineBytes = eol + 1 - line;
+            if (strncmp(line, "VALUE ", 6) == 0)
+            {
+                const char *lastSpace = static_cast<const char*>(memrchr(line, ' ', lineBytes));
+                size_t bytes = strtoul(lastSpace + 1, nullptr, 10);
+                if (end_ - begin_ < lineBytes + bytes + 2)
+                {
+                    if (!fill())
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                begin_ += lineBytes + bytes + 2;
+                ++hits_;
+                continue;
+            }
+            if (strncmp(line, "END", 3) != 0 && strncmp(line, "STORED", 6) != 0)
+            {
+                ++errors_;
+            }
+            begin_ += lineBytes;
+            --responses;
+        }
+        return true;
+    }
+
+    uint64_t hits() const { return hits_; }
+    uint64_t errors() const { return errors_; }
+
+private:
+    bool fill()
+    {
+        if (begin_ > 0)
+        {
+            memmove(buf_.data(), buf_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        if (end_ == buf_.size())
+        {
+            buf_.resize(buf_.size() * 2);
+        }
+        ssize_t n = ::read(fd_, buf_.data() + end_, buf_.size() - end_);
+        if (n <= 0)
+        {
+            return false;
+        }
+        end_ += n;
+        return true;
+    }
+
+    int fd_;
+    std::vector<char> buf_;
+    size_t begin_;
+    size_t end_;
+    uint64_t hits_;
+    uint64_t errors_;
+};
+
+static void appendSet(std::string &out, int key, const std::string &value)
+{
+    char line[64];
+    int len = snprintf(line, sizeof line, "set key:%d 0 0 %zu\r\n", key, value.size());
+    out.append(line, len);
+    out.append(value);
+    out.append("\r\n", 2);
+}
+
+static void appendGet(std::string &out, int key)
+{
+    char line[64];
+    int len = snprintf(line, sizeof line, "get key:%d\r\n", key);
+    out.append(line, len);
+}
+
+static bool preload(const Options &opt)
+{
+    int fd = connectTo(opt);
+    if (fd < 0)
+    {
+        return false;
+    }
+    std::string value(opt.valueSize, 'v');
+    ResponseReader reader(fd);
+    const int kBatch = 256;
+    for (int begin = 0; begin < opt.keys; begin += kBatch)
+    {
+        std::string batch;
+        int n = std::min(kBatch, opt.keys - begin);
+        for (int i = 0; i < n; ++i)
+        {
+            appendSet(batch, begin + i, value);
+        }
+        if (::write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size()) || !reader.read(n))
+        {
+            ::close(fd);
+            return false;
+        }
+    }
+    ::close(fd);
+    return true;
+}
+
+static void clientThread(const Options &opt, int index, std::atomic<uint64_t> *ops,
+                         std::atomic<uint64_t> *hits, std::atomic<uint64_t> *errors)
+{
+    int fd = connectTo(opt);
+    if (fd < 0)
+    {
+        return;
+    }
+    std::mt19937 rng(index * 7919 + 1);
+    std::uniform_int_distribution<int> keyDist(0, opt.keys - 1);
+    std::uniform_real_distribution<double> opDist(0.0, 1.0);
+    std::string value(opt.valueSize, 'v');
+    ResponseReader reader(fd);
+    std::string batch;
+    while (g_running)
+    {
+        batch.clear();
+        for (int i = 0; i < opt.pipeline; ++i)
+        {
+            int key = keyDist(rng);
+            if (opDist(rng) < opt.getRatio)
+            {
+                appendGet(batch, key);
+            }
+            else
+            {
+                appendSet(batch, key, value);
+            }
+        }
+        if (::write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size())
+            || !reader.read(opt.pipeline))
+        {
+            break;
+        }
+        *ops += opt.pipeline;
+    }
+    *hits += reader.hits();
+    *errors += reader.errors();
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    opt.host = argc > 1 ? argv[1] : "127.0.0.1";
+    opt.port = static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : 11211);
+    opt.connections = argc > 3 ? atoi(argv[3]) : 8;
+    opt.pipeline = argc > 4 ? atoi(argv[4]) : 16;
+    opt.getRatio = argc > 5 ? atof(argv[5]) : 0.9;
+    opt.keys = argc > 6 ? atoi(argv[6]) : 100000;
+    opt.valueSize = argc > 7 ? atoi(argv[7]) : 100;
+    opt.seconds = argc > 8 ? atoi(argv[8]) : 5;
+
+    if (!preload(opt))
+    {
+        fprintf(stderr, "preload failed\n");
+        return 1;
+    }
+
+    std::atomic<uint64_t> ops(0);
+    std::atomic<uint64_t> hits(0);
+    std::atomic<uint64_t> errors(0);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < opt.connections; ++i)
+    {
+        clients.emplace_back(clientThread, std::cref(opt), i, &ops, &hits, &errors);
+    }
+
+    uint64_t last = 0;
+    for (int i = 0; i < opt.seconds; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t now = ops.load();
+        printf("%llu ops/s\n", static_cast<unsigned long long>(now - last));
+        fflush(stdout);
+        last = now;
+    }
+    uint64_t total = ops.load();
+    g_running = false;
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+
+    printf("connections=%d pipeline=%d get=%.0f%% keys=%d value=%dB: %.0f ops/s, hits %llu, errors %llu\n",
+           opt.connections, opt.pipeline, opt.getRatio * 100, opt.keys, opt.valueSize,
+           total / static_cast<double>(opt.seconds),
+           static_cast<unsigned long long>(hits.load()), static_cast<unsigned long long>(errors.load()));
+    return 0;
+}
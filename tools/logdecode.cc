@@ -0,0 +1,15 @@
+#include <mymuduo/BinaryLog.h>
+
+#include <stdio.h>
+
+// 把BinaryLog写出的二进制日志文件还原成文本
+// ./logdecode /tmp/server.blog > server.log
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <binary log file>\n", argv[0]);
+        return 1;
+    }
+    return BinaryLog::decode(argv[1], stdout) ? 0 : 1;
+}